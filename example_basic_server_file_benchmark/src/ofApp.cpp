@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+#include "Poco/NullStream.h"
+#include "Poco/StreamCopier.h"
+
+
+const std::string ofApp::DOCUMENT_ROOT = "BenchmarkRoot/";
+const std::string ofApp::FILE_NAME = "large.bin";
+
+
+void ofApp::setup()
+{
+    createFile();
+
+    ofxHTTP::SimpleFileServerSettings settings;
+    settings.fileSystemRouteSettings.setDocumentRoot(DOCUMENT_ROOT);
+
+    // Keep the file out of the cache and off the other zero-copy paths, so
+    // the only difference between the servers is sendfile(2).
+    settings.fileSystemRouteSettings.setMaximumCachedFileSize(0);
+    settings.fileSystemRouteSettings.setUseMemoryMappedFiles(false);
+    settings.fileSystemRouteSettings.setUseIOUring(false);
+    settings.fileSystemRouteSettings.setUseCompression(false);
+
+    settings.setPort(SEND_FILE_PORT);
+    settings.fileSystemRouteSettings.setUseSendFile(true);
+    sendFileServer.setup(settings);
+    sendFileServer.start();
+
+    settings.setPort(STREAM_PORT);
+    settings.fileSystemRouteSettings.setUseSendFile(false);
+    streamServer.setup(settings);
+    streamServer.start();
+
+    benchmark("sendfile", SEND_FILE_PORT);
+    benchmark("stream", STREAM_PORT);
+
+    ofExit();
+}
+
+
+void ofApp::createFile()
+{
+    std::string path = ofToDataPath(DOCUMENT_ROOT + FILE_NAME, true);
+
+    if (ofFile(path).getSize() == FILE_SIZE)
+    {
+        return;
+    }
+
+    ofDirectory::createDirectory(DOCUMENT_ROOT, true, true);
+
+    ofLogNotice("ofApp::createFile") << "Writing " << FILE_SIZE << " bytes to " << path;
+
+    std::ofstream file(path, std::ios::binary);
+
+    std::vector<char> chunk(1024 * 1024);
+
+    for (std::size_t i = 0; i < chunk.size(); ++i)
+    {
+        chunk[i] = static_cast<char>(ofRandom(256));
+    }
+
+    for (std::size_t written = 0; written < FILE_SIZE; written += chunk.size())
+    {
+        file.write(chunk.data(), chunk.size());
+    }
+}
+
+
+uint64_t ofApp::download(uint16_t port)
+{
+    std::string url = "http://127.0.0.1:" + ofToString(port) + "/" + FILE_NAME;
+
+    ofxHTTP::Client client;
+    ofxHTTP::Context context;
+    ofxHTTP::GetRequest request(url);
+
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    auto response = client.execute(context, request);
+
+    if (response->getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
+    {
+        ofLogError("ofApp::download") << url << ": " << response->getStatus() << " " << response->getReason();
+        return 0;
+    }
+
+    Poco::NullOutputStream null;
+    Poco::StreamCopier::copyStream64(response->stream(), null);
+
+    return ofGetElapsedTimeMicros() - start;
+}
+
+
+void ofApp::benchmark(const std::string& name, uint16_t port)
+{
+    for (int i = 0; i < NUM_WARMUP_DOWNLOADS; ++i)
+    {
+        download(port);
+    }
+
+    uint64_t best = std::numeric_limits<uint64_t>::max();
+    uint64_t total = 0;
+
+    for (int i = 0; i < NUM_DOWNLOADS; ++i)
+    {
+        uint64_t elapsed = download(port);
+
+        if (elapsed == 0)
+        {
+            return;
+        }
+
+        best = std::min(best, elapsed);
+        total += elapsed;
+    }
+
+    double megabytes = FILE_SIZE / (1024.0 * 1024.0);
+
+    ofLogNotice("ofApp::benchmark") << name
+                                    << ": mean " << total / NUM_DOWNLOADS / 1000 << " ms"
+                                    << ", best " << best / 1000 << " ms"
+                                    << ", " << megabytes / (best / 1000000.0) << " MB/s";
+}
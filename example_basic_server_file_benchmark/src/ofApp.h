@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxHTTP.h"
+
+
+/// \brief Times downloads of a large file with and without sendfile(2).
+///
+/// Two servers share a document root. One sends uncached files with
+/// sendfile(2), the other copies them through the response stream. The
+/// results are logged and the app exits.
+class ofApp: public ofBaseApp
+{
+public:
+    void setup();
+
+    /// \brief Create the benchmark file if it does not exist.
+    void createFile();
+
+    /// \brief Download the benchmark file and discard it.
+    /// \param port The port of the server to download from.
+    /// \returns the download time in microseconds.
+    uint64_t download(uint16_t port);
+
+    /// \brief Download the benchmark file several times and log the result.
+    /// \param name The name of the send path being measured.
+    /// \param port The port of the server to download from.
+    void benchmark(const std::string& name, uint16_t port);
+
+    // We do not have an draw() method since this is a headless display.
+
+    ofxHTTP::SimpleFileServer sendFileServer;
+    ofxHTTP::SimpleFileServer streamServer;
+
+    enum
+    {
+        SEND_FILE_PORT = 7890,
+        STREAM_PORT = 7891,
+        FILE_SIZE = 256 * 1024 * 1024,
+        NUM_WARMUP_DOWNLOADS = 1,
+        NUM_DOWNLOADS = 5
+    };
+
+    static const std::string DOCUMENT_ROOT;
+    static const std::string FILE_NAME;
+
+};
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::runChecks()
+{
+    testParseByteRanges();
+    testMatchesEntityTag();
+    testAcceptsEncoding();
+}
+
+
+void ofApp::testParseByteRanges()
+{
+    // Single ranges.
+    check(describeByteRanges("bytes=0-499", 10000) == "0-499", "first bytes");
+    check(describeByteRanges("bytes=500-999", 10000) == "500-999", "middle bytes");
+    check(describeByteRanges("bytes=9500-", 10000) == "9500-9999", "open range");
+    check(describeByteRanges("bytes=-500", 10000) == "9500-9999", "suffix range");
+    check(describeByteRanges(" Bytes = 0-0 ", 10000) == "0-0", "unit case and whitespace");
+
+    // Clamping to the representation.
+    check(describeByteRanges("bytes=9000-20000", 10000) == "9000-9999", "last byte clamped");
+    check(describeByteRanges("bytes=-20000", 10000) == "0-9999", "suffix clamped");
+
+    // Multiple ranges are sorted and coalesced.
+    check(describeByteRanges("bytes=0-99,200-299", 10000) == "0-99,200-299", "disjoint ranges");
+    check(describeByteRanges("bytes=200-299,0-99", 10000) == "0-99,200-299", "ranges sorted");
+    check(describeByteRanges("bytes=0-99,50-149", 10000) == "0-149", "overlapping ranges coalesced");
+    check(describeByteRanges("bytes=0-99,100-199", 10000) == "0-199", "adjacent ranges coalesced");
+    check(describeByteRanges("bytes=0-,-1", 10000) == "0-9999", "contained range coalesced");
+    check(describeByteRanges("bytes=0-99,,200-299", 10000) == "0-99,200-299", "empty specifier ignored");
+
+    // Unsatisfiable ranges.
+    check(describeByteRanges("bytes=10000-", 10000) == "", "range past the end");
+    check(describeByteRanges("bytes=-0", 10000) == "", "empty suffix");
+    check(describeByteRanges("bytes=0-99", 0) == "", "empty representation");
+    check(describeByteRanges("bytes=20000-,0-99", 10000) == "0-99", "unsatisfiable range omitted");
+
+    // Headers that must be ignored.
+    check(describeByteRanges("", 10000) == "invalid", "empty header");
+    check(describeByteRanges("items=0-99", 10000) == "invalid", "unknown unit");
+    check(describeByteRanges("bytes=", 10000) == "invalid", "no specifiers");
+    check(describeByteRanges("bytes=100", 10000) == "invalid", "missing dash");
+    check(describeByteRanges("bytes=500-499", 10000) == "invalid", "last before first");
+    check(describeByteRanges("bytes=a-b", 10000) == "invalid", "not a number");
+    check(describeByteRanges("bytes=-", 10000) == "invalid", "no positions");
+
+    // Too many specifiers.
+    std::string manyRanges = "bytes=";
+
+    for (std::size_t i = 0; i <= ofxHTTP::HTTPUtils::DEFAULT_MAXIMUM_BYTE_RANGES; ++i)
+    {
+        manyRanges += (i > 0 ? "," : "") + ofToString(i * 10) + "-" + ofToString(i * 10 + 1);
+    }
+
+    check(describeByteRanges(manyRanges, 10000) == "invalid", "too many specifiers");
+}
+
+
+void ofApp::testMatchesEntityTag()
+{
+    using ofxHTTP::HTTPUtils;
+
+    // The wildcard matches any current representation.
+    check(HTTPUtils::matchesEntityTag("*", "\"a\"", false), "wildcard, strong");
+    check(HTTPUtils::matchesEntityTag(" * ", "W/\"a\"", true), "wildcard, weak");
+    check(!HTTPUtils::matchesEntityTag("*", "", true), "wildcard without a tag");
+
+    // Lists.
+    check(HTTPUtils::matchesEntityTag("\"a\"", "\"a\"", false), "single tag");
+    check(HTTPUtils::matchesEntityTag("\"x\", \"a\",\"y\"", "\"a\"", false), "tag in a list");
+    check(!HTTPUtils::matchesEntityTag("\"x\", \"y\"", "\"a\"", true), "tag not in a list");
+    check(!HTTPUtils::matchesEntityTag("\"A\"", "\"a\"", true), "tags are case sensitive");
+    check(!HTTPUtils::matchesEntityTag("", "\"a\"", true), "empty condition");
+
+    // The weak comparison function ignores the weakness indicator.
+    check(HTTPUtils::matchesEntityTag("W/\"a\"", "\"a\"", true), "weak condition, weak comparison");
+    check(HTTPUtils::matchesEntityTag("\"a\"", "W/\"a\"", true), "weak tag, weak comparison");
+    check(HTTPUtils::matchesEntityTag("W/\"a\"", "W/\"a\"", true), "both weak, weak comparison");
+
+    // The strong comparison function only matches strong, identical tags.
+    check(!HTTPUtils::matchesEntityTag("W/\"a\"", "\"a\"", false), "weak condition, strong comparison");
+    check(!HTTPUtils::matchesEntityTag("\"a\"", "W/\"a\"", false), "weak tag, strong comparison");
+    check(!HTTPUtils::matchesEntityTag("W/\"a\"", "W/\"a\"", false), "both weak, strong comparison");
+    check(HTTPUtils::matchesEntityTag("W/\"a\", \"a\"", "\"a\"", false), "strong tag after a weak one");
+}
+
+
+void ofApp::testAcceptsEncoding()
+{
+    using ofxHTTP::HTTPUtils;
+
+    // Listed codings.
+    check(HTTPUtils::acceptsEncoding("gzip", "gzip"), "single coding");
+    check(HTTPUtils::acceptsEncoding("deflate, gzip, br", "br"), "coding in a list");
+    check(HTTPUtils::acceptsEncoding("GZip", "gzip"), "codings are case insensitive");
+    check(!HTTPUtils::acceptsEncoding("deflate, br", "gzip"), "coding not in a list");
+    check(!HTTPUtils::acceptsEncoding("", "gzip"), "empty header");
+
+    // Quality values.
+    check(HTTPUtils::acceptsEncoding("gzip;q=0.5", "gzip"), "non-zero quality");
+    check(HTTPUtils::acceptsEncoding("gzip ; Q=1.0", "gzip"), "quality case and whitespace");
+    check(!HTTPUtils::acceptsEncoding("gzip;q=0", "gzip"), "zero quality");
+    check(!HTTPUtils::acceptsEncoding("gzip;q=0.000, br", "gzip"), "zero quality with decimals");
+    check(!HTTPUtils::acceptsEncoding("gzip;q=abc", "gzip"), "malformed quality");
+
+    // The wildcard applies only to codings that are not listed.
+    check(HTTPUtils::acceptsEncoding("*", "br"), "wildcard");
+    check(HTTPUtils::acceptsEncoding("deflate, *;q=0.1", "gzip"), "wildcard with quality");
+    check(!HTTPUtils::acceptsEncoding("*;q=0", "gzip"), "refused wildcard");
+    check(!HTTPUtils::acceptsEncoding("*, gzip;q=0", "gzip"), "refused coding before the wildcard");
+    check(!HTTPUtils::acceptsEncoding("gzip;q=0, *", "gzip"), "refused coding after the wildcard");
+    check(HTTPUtils::acceptsEncoding("*;q=0, gzip", "gzip"), "accepted coding with a refused wildcard");
+}
+
+
+std::string ofApp::describeByteRanges(const std::string& range, uint64_t size)
+{
+    std::vector<ofxHTTP::HTTPUtils::ByteRange> ranges;
+
+    if (!ofxHTTP::HTTPUtils::parseByteRanges(range, size, ranges))
+    {
+        return "invalid";
+    }
+
+    std::string description;
+
+    for (const auto& byteRange: ranges)
+    {
+        if (!description.empty())
+        {
+            description += ",";
+        }
+
+        description += ofToString(byteRange.first) + "-" + ofToString(byteRange.last);
+    }
+
+    return description;
+}
@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxHTTP.h"
+#include "../../tests/CheckApp.h"
+
+
+/// \brief Checks the HTTPUtils header parsers against known cases.
+class ofApp: public CheckApp
+{
+public:
+    void runChecks() override;
+
+    /// \brief Check HTTPUtils::parseByteRanges().
+    void testParseByteRanges();
+
+    /// \brief Check HTTPUtils::matchesEntityTag().
+    void testMatchesEntityTag();
+
+    /// \brief Check HTTPUtils::acceptsEncoding().
+    void testAcceptsEncoding();
+
+    /// \brief Parse a Range header and describe the result.
+    /// \param range The Range header value.
+    /// \param size The size of the representation in bytes.
+    /// \returns "invalid" if the header must be ignored, otherwise the
+    ///          satisfiable ranges, e.g. "0-499,9500-9999", or "" if none.
+    static std::string describeByteRanges(const std::string& range,
+                                          uint64_t size);
+
+};
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::runChecks()
+{
+    testEviction();
+    testIdleExpiry();
+    testLifetimeExpiry();
+}
+
+
+void ofApp::testEviction()
+{
+    expiredSessionIds.clear();
+    evictedSessionIds.clear();
+
+    TestSessionStore store;
+    ofAddListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofAddListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+
+    store.setMaximumSessions(3);
+
+    std::string a = store.createSharedSession()->getId();
+    std::shared_ptr<ofxHTTP::AbstractSession> b = store.createSharedSession();
+    std::string c = store.createSharedSession()->getId();
+
+    check(store.getNumSessions() == 3, "sessions up to the maximum are kept");
+    check(store.getNumEvictedSessions() == 0, "no session is evicted below the maximum");
+
+    // Using a makes b the least recently used session.
+    check(store.findSession(a) != nullptr, "a session is found by its id");
+
+    std::string d = store.createSharedSession()->getId();
+
+    check(store.getNumSessions() == 3, "the maximum is not exceeded");
+    check(store.getNumEvictedSessions() == 1, "one session is evicted");
+    check(evictedSessionIds.size() == 1 && evictedSessionIds[0] == b->getId(), "the eviction is reported");
+    check(!store.hasSession(b->getId()), "the least recently used session is evicted");
+    check(store.hasSession(a) && store.hasSession(c) && store.hasSession(d), "recently used sessions are kept");
+    check(store.findSession(b->getId()) == nullptr, "an evicted session is not found");
+
+    // An evicted session stays valid while it is held.
+    b->put("key", "value");
+    check(b->get("key") == "value", "a held session outlives its eviction");
+
+    // Using c makes a the least recently used session.
+    store.findSession(c);
+    store.createSharedSession();
+
+    check(!store.hasSession(a) && store.hasSession(c), "the order of use is updated");
+
+    store.setMaximumSessions(1);
+    store.createSharedSession();
+
+    check(store.getNumSessions() == 1, "lowering the maximum evicts sessions");
+    check(expiredSessionIds.empty(), "evicted sessions are not reported as expired");
+
+    ofRemoveListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofRemoveListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+}
+
+
+void ofApp::testIdleExpiry()
+{
+    expiredSessionIds.clear();
+    evictedSessionIds.clear();
+
+    TestSessionStore store;
+    ofAddListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofAddListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+
+    store.setMaximumIdleTime(Poco::Timespan(0, EXPIRY_TIME_MILLIS * 1000));
+    store.setMaximumLifetime(Poco::Timespan(0, 0));
+
+    std::string a = store.createSharedSession()->getId();
+    std::string b = store.createSharedSession()->getId();
+
+    store.advance(STEP_TIME_MILLIS);
+
+    check(store.findSession(a) != nullptr, "a session is kept before its idle time");
+
+    store.advance(STEP_TIME_MILLIS);
+
+    check(!store.hasSession(b), "an unused session expires after its idle time");
+    check(store.hasSession(a), "using a session extends its idle time");
+
+    store.expireSessions();
+
+    check(store.getNumSessions() == 1, "expired sessions are removed");
+    check(store.getNumExpiredSessions() == 1, "one session is expired");
+    check(expiredSessionIds.size() == 1 && expiredSessionIds[0] == b, "the expiry is reported");
+    check(evictedSessionIds.empty(), "expired sessions are not reported as evicted");
+
+    ofRemoveListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofRemoveListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+}
+
+
+void ofApp::testLifetimeExpiry()
+{
+    expiredSessionIds.clear();
+    evictedSessionIds.clear();
+
+    TestSessionStore store;
+    ofAddListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofAddListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+
+    store.setMaximumIdleTime(Poco::Timespan(0, 0));
+    store.setMaximumLifetime(Poco::Timespan(0, EXPIRY_TIME_MILLIS * 1000));
+
+    std::string a = store.createSharedSession()->getId();
+
+    store.advance(STEP_TIME_MILLIS);
+
+    check(store.findSession(a) != nullptr, "a session is kept before its lifetime");
+
+    store.advance(STEP_TIME_MILLIS);
+
+    check(store.findSession(a) == nullptr, "a used session expires after its lifetime");
+    check(store.getNumSessions() == 0, "a session found to be expired is removed");
+    check(expiredSessionIds.size() == 1 && expiredSessionIds[0] == a, "the expiry is reported");
+
+    ofRemoveListener(store.events.onSessionExpired, this, &ofApp::onSessionExpired);
+    ofRemoveListener(store.events.onSessionEvicted, this, &ofApp::onSessionEvicted);
+}
+
+
+void ofApp::onSessionExpired(ofxHTTP::SessionEventArgs& args)
+{
+    expiredSessionIds.push_back(args.session().getId());
+}
+
+
+void ofApp::onSessionEvicted(ofxHTTP::SessionEventArgs& args)
+{
+    evictedSessionIds.push_back(args.session().getId());
+}
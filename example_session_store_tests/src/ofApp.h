@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxHTTP.h"
+#include "../../tests/CheckApp.h"
+
+
+/// \brief A SimpleSessionStore that exposes its session lookups and whose
+///        clock only moves when it is advanced.
+class TestSessionStore: public ofxHTTP::SimpleSessionStore
+{
+public:
+    using ofxHTTP::SimpleSessionStore::hasSession;
+    using ofxHTTP::SimpleSessionStore::findSession;
+    using ofxHTTP::SimpleSessionStore::createSharedSession;
+
+    /// \brief Advance the store's clock.
+    /// \param milliseconds The time to advance by.
+    void advance(uint64_t milliseconds)
+    {
+        _time += Poco::Timespan(0, milliseconds * 1000);
+    }
+
+protected:
+    Poco::Timestamp currentTime() const override
+    {
+        return _time;
+    }
+
+private:
+    /// \brief The store's clock.
+    Poco::Timestamp _time;
+
+};
+
+
+/// \brief Checks the expiry and eviction of SimpleSessionStore sessions.
+class ofApp: public CheckApp
+{
+public:
+    void runChecks() override;
+
+    /// \brief Check that the least recently used session is evicted.
+    void testEviction();
+
+    /// \brief Check that sessions expire after the maximum idle time.
+    void testIdleExpiry();
+
+    /// \brief Check that sessions expire after the maximum lifetime.
+    void testLifetimeExpiry();
+
+    void onSessionExpired(ofxHTTP::SessionEventArgs& args);
+    void onSessionEvicted(ofxHTTP::SessionEventArgs& args);
+
+    /// \brief The ids of the sessions reported as expired.
+    std::vector<std::string> expiredSessionIds;
+
+    /// \brief The ids of the sessions reported as evicted.
+    std::vector<std::string> evictedSessionIds;
+
+    enum
+    {
+        /// \brief The expiry time used by the expiry checks.
+        EXPIRY_TIME_MILLIS = 400,
+        /// \brief The time between steps of the expiry checks.
+        STEP_TIME_MILLIS = 250
+    };
+
+};
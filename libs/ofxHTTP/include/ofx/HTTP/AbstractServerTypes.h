@@ -8,6 +8,7 @@
 #pragma once
 
 
+#include <memory>
 #include <string>
 #include "Poco/UUID.h"
 #include "Poco/Any.h"
@@ -88,6 +89,9 @@ public:
     /// \returns a reference to the session store.
     virtual AbstractSessionStore& sessionStore() = 0;
 
+    /// \returns true iff routes should provide sessions to their handlers.
+    virtual bool useSessions() const = 0;
+
 };
 
 
@@ -144,12 +148,26 @@ public:
     /// This method will also ensure that only one session id is availble at a
     /// given time
     ///
+    /// The returned session is valid at least until endRequest() is called
+    /// for the request.
+    ///
     /// \param request The HTTP request.
     /// \param response The HTTP response.
     /// \returns A reference to an AbstractSession.
     virtual AbstractSession& getSession(Poco::Net::HTTPServerRequest& request,
                                         Poco::Net::HTTPServerResponse& response) = 0;
 
+    /// \brief Get a valid session for the given request, sharing ownership.
+    ///
+    /// Unlike getSession(), the returned session remains valid for as long as
+    /// the caller holds it, even if the store expires or evicts it meanwhile.
+    ///
+    /// \param request The HTTP request.
+    /// \param response The HTTP response.
+    /// \returns A shared pointer to the session.
+    virtual std::shared_ptr<AbstractSession> getSharedSession(Poco::Net::HTTPServerRequest& request,
+                                                              Poco::Net::HTTPServerResponse& response) = 0;
+
     /// \brief Destroy the session(s) associated with the given exchange.
     ///
     /// This method will invalidate any session cookies in the response header.
@@ -157,6 +175,18 @@ public:
     virtual void destroySession(Poco::Net::HTTPServerRequest& request,
                                 Poco::Net::HTTPServerResponse& response) = 0;
 
+    /// \brief Release anything the store bound to a completed request.
+    ///
+    /// Routes call this once the request's handler has returned, after which
+    /// the response must no longer be used. The default does nothing.
+    ///
+    /// \param request The HTTP request.
+    /// \param response The HTTP response.
+    virtual void endRequest(Poco::Net::HTTPServerRequest& request,
+                            Poco::Net::HTTPServerResponse& response)
+    {
+    }
+
 protected:
     /// \brief Query if the store has the the given session
     /// \param sessionId The id of the session to query.
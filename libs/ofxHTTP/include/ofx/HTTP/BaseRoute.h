@@ -24,6 +24,7 @@
 #include "ofLog.h"
 
 #include "ofx/HTTP/AbstractServerTypes.h"
+#include "ofx/HTTP/HTTPUtils.h"
 #include "ofx/HTTP/RequestHandlerAdapter.h"
 #include "ofx/HTTP/ServerEvents.h"
 
@@ -316,9 +317,13 @@ void BaseRoute_<SettingsType>::handleRequest(Poco::Net::HTTPServerRequest& reque
     // All requests pass through the server's handleRequest method first.
     // The server broadcasts the request / response to any listeners.
     // Generally these listeners should only modify headers, not send a response.
-    AbstractSession& session = _server->sessionStore().getSession(request, response);
+    // The session is only created if a handler asks for it.
+    AbstractSessionStore* sessionStore = _server->useSessions() ? &_server->sessionStore() : nullptr;
 
-    ServerEventArgs evt(request, response, session);
+    // Sessions bound to the response are released when the request ends.
+    ServerRequestScope scope(sessionStore, request, response);
+
+    ServerEventArgs evt(request, response, sessionStore);
 
     _server->onHTTPServerEvent(this, evt);
 
@@ -365,19 +370,15 @@ void BaseRoute_<SettingsType>::handleRequest(ServerEventArgs& evt)
                                               "No handlers for route.");
         }
 
-        evt.response().setChunkedTransferEncoding(true);
-        evt.response().setContentType("text/html");
-
-        std::stringstream ss;
-        ss << evt.response().getStatus() << " - " << evt.response().getReason();
+        std::shared_ptr<const std::string> page = HTTPUtils::getErrorPage(evt.response().getStatus(),
+                                                                          evt.response().getReason());
 
-        std::ostream& ostr = evt.response().send(); // get output stream
-        ostr << "<!DOCTYPE html><html><head><meta charset=\"utf-8\"/><title>";
-        ostr << ss.str();
-        ostr << "</title></head><body><h1>";
-        ostr << ss.str();
-        ostr << "</h1></body></html>";
-        ostr.flush();
+        // sendBuffer() sets the Content-Length and writes the headers and
+        // the page through the session's output buffer, so a page that fits
+        // in the buffer together with its headers leaves in one write.
+        evt.response().setChunkedTransferEncoding(false);
+        evt.response().setContentType("text/html");
+        evt.response().sendBuffer(page->data(), page->size());
     }
     catch (const Poco::Exception& exc)
     {
@@ -477,11 +478,17 @@ void BaseRouteHandler_<RouteType>::handleRequest(Poco::Net::HTTPServerRequest& r
     // All requests pass through the server's handleRequest method first.
     // The server broadcasts the request / response to any listeners.
     // Generally these listeners should only modify headers, not send a response.
-    AbstractSession& session = route().getServer()->sessionStore().getSession(request, response);
+    AbstractServer* server = route().getServer();
+
+    // The session is only created if a handler asks for it.
+    AbstractSessionStore* sessionStore = server->useSessions() ? &server->sessionStore() : nullptr;
+
+    // Sessions bound to the response are released when the request ends.
+    ServerRequestScope scope(sessionStore, request, response);
 
-    ServerEventArgs evt(request, response, session);
+    ServerEventArgs evt(request, response, sessionStore);
 
-    route().getServer()->onHTTPServerEvent(this, evt);
+    server->onHTTPServerEvent(this, evt);
 
     // If the response was sent from the server or its delegates, we finish.
     if (response.sent())
@@ -370,6 +370,11 @@ public:
         return _sessionStore;
     }
 
+    bool useSessions() const
+    {
+        return _settings.useSessions();
+    }
+
     /// \brief A collection of server events.
     ServerEvents events;
 
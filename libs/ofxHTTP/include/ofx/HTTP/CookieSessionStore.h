@@ -0,0 +1,311 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include "Poco/Timespan.h"
+#include "Poco/Net/HTTPCookie.h"
+#include "ofx/HTTP/AbstractServerTypes.h"
+#include "ofx/HTTP/Session.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+class CookieSessionStore;
+
+
+/// \brief A session whose data is stored in a cookie.
+///
+/// Each change to the session data rewrites the session cookie in the
+/// response. The store detaches the session from the response when the
+/// request ends; changes made after that, or after the response has been
+/// sent, are logged and not saved.
+class CookieSession: public SimpleSession
+{
+public:
+    /// \brief Create a CookieSession.
+    /// \param store The store that writes the session cookie.
+    /// \param response The response that carries the session cookie.
+    /// \param sessionId The session id.
+    /// \param data The session data.
+    CookieSession(CookieSessionStore& store,
+                  Poco::Net::HTTPServerResponse& response,
+                  const std::string& sessionId,
+                  const std::map<std::string, std::string>& data);
+
+    virtual ~CookieSession();
+
+    /// \throws Poco::RangeException if the session cookie would exceed the
+    ///         store's maximum cookie size. The session is left unchanged.
+    void put(const std::string& key, const std::string& value) override;
+
+    void remove(const std::string& key) override;
+
+    void clear() override;
+
+    /// \returns a copy of the session data.
+    std::map<std::string, std::string> data() const;
+
+    /// \brief Stop writing to the response.
+    ///
+    /// Waits for a save in progress, so the response may be destroyed as
+    /// soon as this returns.
+    void detach();
+
+private:
+    /// \brief Write the session cookie or restore the previous data.
+    void _save(const std::map<std::string, std::string>& previousData);
+
+    /// \brief The store that writes the session cookie.
+    CookieSessionStore& _store;
+
+    /// \brief The response that carries the session cookie, or nullptr once
+    ///        detached.
+    Poco::Net::HTTPServerResponse* _response = nullptr;
+
+    /// \brief The mutex for the response.
+    std::mutex _responseMutex;
+
+};
+
+
+/// \brief A session store that keeps no per-session state on the server.
+///
+/// The session id and data are serialized into the session cookie and
+/// signed with HMAC-SHA256, so any server that shares the secret can serve
+/// any request. If encryption is enabled, the data is also encrypted with
+/// AES-256-CBC before it is signed.
+///
+/// The signing and encryption keys are derived from the secret once, when
+/// it is set. Signatures are compared in constant time and oversized cookies
+/// are rejected before any cryptographic work is done.
+///
+/// Cookies are limited to a few kilobytes, so sessions should hold small
+/// values such as ids and flags. A stateless session can not be revoked
+/// before it expires; destroySession() only asks the client to drop it.
+class CookieSessionStore: public AbstractSessionStore
+{
+public:
+    /// \brief Create a CookieSessionStore with a random secret.
+    ///
+    /// Sessions signed with a random secret can not be read after a restart
+    /// or by another server. Call setSecret() to share sessions.
+    CookieSessionStore();
+
+    /// \brief Create a CookieSessionStore.
+    /// \param secret The secret from which the keys are derived.
+    /// \param sessionKeyName The name of the session cookie.
+    CookieSessionStore(const std::string& secret,
+                       const std::string& sessionKeyName = DEFAULT_SESSION_KEY_NAME);
+
+    virtual ~CookieSessionStore();
+
+    /// \brief Get the session of a request.
+    ///
+    /// The store holds the session until the request ends, so the reference
+    /// is valid for the rest of the request.
+    AbstractSession& getSession(Poco::Net::HTTPServerRequest& request,
+                                Poco::Net::HTTPServerResponse& response) override;
+
+    /// \brief Get the session of a request, sharing ownership.
+    ///
+    /// Every call for the same request returns the same session. The session
+    /// writes its cookie to the response until the request ends.
+    std::shared_ptr<AbstractSession> getSharedSession(Poco::Net::HTTPServerRequest& request,
+                                                      Poco::Net::HTTPServerResponse& response) override;
+
+    /// \brief Invalidate the session cookie.
+    ///
+    /// The request's session is detached, so later changes to it are not
+    /// saved.
+    void destroySession(Poco::Net::HTTPServerRequest& request,
+                        Poco::Net::HTTPServerResponse& response) override;
+
+    /// \brief Detach and release the session of a completed request.
+    void endRequest(Poco::Net::HTTPServerRequest& request,
+                    Poco::Net::HTTPServerResponse& response) override;
+
+    /// \brief Set the secret from which the keys are derived.
+    ///
+    /// Changing the secret invalidates all existing sessions.
+    ///
+    /// \param secret The secret, which should be long and random.
+    void setSecret(const std::string& secret);
+
+    /// \brief Enable or disable encryption of the session data.
+    /// \param useEncryption True to encrypt new session cookies.
+    void setUseEncryption(bool useEncryption);
+
+    /// \returns true iff new session cookies are encrypted.
+    bool useEncryption() const;
+
+    /// \brief Set the time after it was last written that a session expires.
+    /// \param maximumLifetime The lifetime, or 0 for no limit.
+    void setMaximumLifetime(const Poco::Timespan& maximumLifetime);
+
+    /// \returns the time after it was last written that a session expires.
+    Poco::Timespan getMaximumLifetime() const;
+
+    /// \brief Set the maximum size of the session cookie in bytes.
+    /// \param maximumCookieSize The maximum size of the cookie's name and
+    ///        value.
+    void setMaximumCookieSize(std::size_t maximumCookieSize);
+
+    /// \returns the maximum size of the session cookie in bytes.
+    std::size_t getMaximumCookieSize() const;
+
+    /// \brief Write a session to its cookie.
+    /// \param session The session to write.
+    /// \param response The response that carries the session cookie.
+    /// \throws Poco::RangeException if the cookie would exceed the maximum
+    ///         cookie size.
+    void saveSession(const CookieSession& session,
+                     Poco::Net::HTTPServerResponse& response);
+
+    static const std::string DEFAULT_SESSION_KEY_NAME;
+
+    /// \brief The default maximum lifetime of 24 hours.
+    static const Poco::Timespan DEFAULT_MAXIMUM_LIFETIME;
+
+    /// \brief The default maximum cookie size, which all browsers accept.
+    static const std::size_t DEFAULT_MAXIMUM_COOKIE_SIZE;
+
+protected:
+    /// \returns false, as the store keeps no sessions.
+    bool hasSession(const std::string& sessionId) const override;
+
+    /// \throws Poco::InvalidAccessException, as the store keeps no sessions.
+    AbstractSession& getSession(const std::string& sessionId) override;
+
+    /// \throws Poco::NotImplementedException, as a session can not be
+    ///         created without a response.
+    AbstractSession& createSession() override;
+
+    /// \brief Does nothing, as the store keeps no sessions.
+    void destroySession(const std::string& sessionId) override;
+
+    /// \brief The keys derived from the secret.
+    ///
+    /// The contexts are only ever copied, so one schedule can be shared by
+    /// every request thread without rehashing the pads or expanding the AES
+    /// key per cookie.
+    struct KeySchedule
+    {
+        /// \brief The SHA-256 state after hashing the signing key's inner
+        ///        pad.
+        std::shared_ptr<EVP_MD_CTX> innerDigest;
+
+        /// \brief The SHA-256 state after hashing the signing key's outer
+        ///        pad.
+        std::shared_ptr<EVP_MD_CTX> outerDigest;
+
+        /// \brief An AES-256-CBC context keyed for encryption, without an IV.
+        std::shared_ptr<EVP_CIPHER_CTX> encryptCipher;
+
+        /// \brief An AES-256-CBC context keyed for decryption, without an IV.
+        std::shared_ptr<EVP_CIPHER_CTX> decryptCipher;
+    };
+
+    /// \returns the current keys.
+    std::shared_ptr<const KeySchedule> keys() const;
+
+    /// \brief Read the session from a request's cookies, or create a new
+    ///        session and add its cookie to the response.
+    std::shared_ptr<CookieSession> readOrCreateSession(Poco::Net::HTTPServerRequest& request,
+                                                       Poco::Net::HTTPServerResponse& response);
+
+    /// \brief Read a session from a cookie value.
+    /// \param value The cookie value.
+    /// \param response The response that carries the session cookie.
+    /// \returns the session, or nullptr if the value is invalid or expired.
+    std::shared_ptr<CookieSession> readSession(const std::string& value,
+                                               Poco::Net::HTTPServerResponse& response);
+
+    /// \brief Replace the session cookie in a response.
+    void setCookie(Poco::Net::HTTPServerResponse& response,
+                   const Poco::Net::HTTPCookie& cookie) const;
+
+    /// \returns the HMAC-SHA256 of a message as a base64url string.
+    static std::string sign(const KeySchedule& keys, const std::string& message);
+
+    /// \brief Compare two strings in time independent of their contents.
+    /// \returns true iff the strings are equal.
+    static bool constantTimeEquals(const std::string& lhs, const std::string& rhs);
+
+    /// \brief Compute the HMAC pads for a key.
+    static void makePads(const std::string& key,
+                         std::string& innerPad,
+                         std::string& outerPad);
+
+    /// \brief Hash the HMAC pads of a signing key into a key schedule.
+    /// \throws Poco::Crypto::OpenSSLException on failure.
+    static void makeDigests(const std::string& key, KeySchedule& keys);
+
+    /// \brief Create an AES-256-CBC context keyed with a 32 byte key.
+    /// \throws Poco::Crypto::OpenSSLException on failure.
+    static std::shared_ptr<EVP_CIPHER_CTX> makeCipher(const std::string& key,
+                                                      bool encrypt);
+
+    /// \returns the HMAC-SHA256 of a message.
+    /// \throws Poco::Crypto::OpenSSLException on failure.
+    static std::string hmac(const KeySchedule& keys, const std::string& message);
+
+    /// \brief Encrypt or decrypt with a copy of a keyed cipher context.
+    /// \param keyedCipher The context from the key schedule.
+    /// \param iv The 16 byte initialization vector.
+    /// \param input The plaintext or ciphertext.
+    /// \returns the ciphertext or plaintext.
+    /// \throws Poco::Crypto::OpenSSLException on failure.
+    static std::string crypt(const EVP_CIPHER_CTX& keyedCipher,
+                             const unsigned char* iv,
+                             const std::string& input);
+
+    /// \returns a new, empty digest context.
+    static std::shared_ptr<EVP_MD_CTX> newDigestContext();
+
+    /// \returns a new, empty cipher context.
+    static std::shared_ptr<EVP_CIPHER_CTX> newCipherContext();
+
+    /// \brief The version tag of a signed cookie.
+    static const std::string SIGNED_TAG;
+
+    /// \brief The version tag of an encrypted cookie.
+    static const std::string ENCRYPTED_TAG;
+
+    /// \brief The name of the session cookie.
+    const std::string _sessionKeyName;
+
+private:
+    CookieSessionStore(const CookieSessionStore&);
+    CookieSessionStore& operator = (const CookieSessionStore&);
+
+    std::shared_ptr<const KeySchedule> _keys;
+
+    bool _useEncryption = false;
+
+    Poco::Timespan _maximumLifetime;
+
+    std::size_t _maximumCookieSize;
+
+    /// \brief The sessions of the requests in progress, by response.
+    std::map<const Poco::Net::HTTPServerResponse*, std::shared_ptr<CookieSession>> _requestSessions;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <string>
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A file compiled into the program.
+///
+/// Assets are generated by scripts/embed_assets.py.
+struct EmbeddedAsset
+{
+    /// \brief The request path, e.g. "/css/style.css".
+    const char* path;
+
+    /// \brief The Content-Type header value.
+    const char* mediaType;
+
+    /// \brief The strong ETag header value of the raw bytes.
+    const char* entityTag;
+
+    /// \brief The raw bytes.
+    const unsigned char* data;
+
+    /// \brief The number of raw bytes.
+    std::size_t size;
+
+    /// \brief The strong ETag header value of the gzipped bytes.
+    const char* gzipEntityTag;
+
+    /// \brief The gzipped bytes, or nullptr if gzip does not reduce the
+    ///        size.
+    const unsigned char* gzipData;
+
+    /// \brief The number of gzipped bytes.
+    std::size_t gzipSize;
+
+};
+
+
+/// \brief A table of files compiled into the program.
+///
+/// A bundle is generated from a directory with scripts/embed_assets.py, e.g.
+///
+///     python3 scripts/embed_assets.py bin/data/DocumentRoot src/WebAssets webAssets
+///
+/// writes src/WebAssets.h and src/WebAssets.cpp, which declare and define
+///
+///     const ofx::HTTP::EmbeddedAssetBundle& webAssets();
+///
+/// The table is constant-initialized, so it needs no startup work.
+class EmbeddedAssetBundle
+{
+public:
+    /// \brief Create an EmbeddedAssetBundle.
+    /// \param assets The assets, sorted by path.
+    /// \param numAssets The number of assets.
+    constexpr EmbeddedAssetBundle(const EmbeddedAsset* assets, std::size_t numAssets):
+        _assets(assets),
+        _numAssets(numAssets)
+    {
+    }
+
+    /// \brief Find an asset by request path.
+    /// \param path The decoded request path, e.g. "/css/style.css".
+    /// \returns the asset, or nullptr if there is no such asset.
+    const EmbeddedAsset* find(const std::string& path) const;
+
+    /// \returns the first asset.
+    const EmbeddedAsset* begin() const;
+
+    /// \returns one past the last asset.
+    const EmbeddedAsset* end() const;
+
+    /// \returns the number of assets.
+    std::size_t size() const;
+
+private:
+    /// \brief The assets, sorted by path.
+    const EmbeddedAsset* _assets;
+
+    /// \brief The number of assets.
+    std::size_t _numAssets;
+
+};
+
+
+} } // namespace ofx::HTTP
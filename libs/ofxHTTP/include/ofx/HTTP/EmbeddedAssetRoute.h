@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofx/HTTP/BaseRoute.h"
+#include "ofx/HTTP/EmbeddedAssetBundle.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Settings for an EmbeddedAssetRoute.
+class EmbeddedAssetRouteSettings: public BaseRouteSettings
+{
+public:
+    EmbeddedAssetRouteSettings(const std::string& routePathPattern = DEFAULT_ROUTE_PATH_PATTERN,
+                               bool requireSecurePort = false,
+                               bool requireAuthentication = false);
+
+    virtual ~EmbeddedAssetRouteSettings();
+
+    /// \brief Set the file name served for a request path ending in "/".
+    /// \param defaultIndex The default index, e.g. "index.html".
+    void setDefaultIndex(const std::string& defaultIndex);
+
+    /// \returns the file name served for a request path ending in "/".
+    const std::string& getDefaultIndex() const;
+
+    /// \brief Set the Cache-Control header value sent with every asset.
+    /// \param cacheControl The header value, or empty to send none.
+    void setCacheControl(const std::string& cacheControl);
+
+    /// \returns the Cache-Control header value sent with every asset.
+    const std::string& getCacheControl() const;
+
+    static const std::string DEFAULT_INDEX;
+
+    /// \brief An unfortunate compromise until C++11.
+    static const std::string DEFAULT_GET_HTTP_METHODS_ARRAY[];
+
+    /// \brief The default HTTP methods for this route.
+    static const HTTPMethodSet DEFAULT_GET_HTTP_METHODS;
+
+private:
+    std::string _defaultIndex;
+    std::string _cacheControl;
+
+};
+
+
+/// \brief A route for serving files compiled into the program.
+///
+/// Assets are served from an EmbeddedAssetBundle without touching the file
+/// system. A gzipped copy is sent to clients that accept it, and
+/// If-None-Match requests are answered with 304 Not Modified. A missing
+/// asset is answered with the bundle's "/404.html", if it has one.
+class EmbeddedAssetRoute: public BaseRoute_<EmbeddedAssetRouteSettings>
+{
+public:
+    typedef EmbeddedAssetRouteSettings Settings;
+
+    /// \brief Create an EmbeddedAssetRoute.
+    /// \param bundle The assets, which must outlive the route.
+    /// \param settings The route settings.
+    EmbeddedAssetRoute(const EmbeddedAssetBundle& bundle,
+                       const Settings& settings = Settings());
+
+    virtual ~EmbeddedAssetRoute();
+
+    virtual void handleRequest(ServerEventArgs& evt) override;
+
+    Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest& request) override;
+
+    /// \returns the assets.
+    const EmbeddedAssetBundle& bundle() const;
+
+protected:
+    /// \brief Send an asset.
+    /// \param evt The server event arguments.
+    /// \param asset The asset.
+    /// \param isConditional True to send validators and honor
+    ///        If-None-Match, false for error pages.
+    void sendAsset(ServerEventArgs& evt,
+                   const EmbeddedAsset& asset,
+                   bool isConditional);
+
+    /// \brief The assets.
+    const EmbeddedAssetBundle& _bundle;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,291 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Poco/Timestamp.h"
+#include "ofFileUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief The identity of a file's contents on disk.
+///
+/// If any of these values change, the file's contents must be assumed to
+/// have changed.
+class FileSystemFileInfo
+{
+public:
+    /// \brief True iff the file exists and is a regular file.
+    bool exists = false;
+
+    /// \brief The file size in bytes.
+    uint64_t size = 0;
+
+    /// \brief The last modification time.
+    Poco::Timestamp modified{0};
+
+    /// \brief The inode number, or 0 if not supported by the platform.
+    uint64_t inode = 0;
+
+    /// \returns true iff both describe the same file contents.
+    bool operator == (const FileSystemFileInfo& other) const;
+
+    /// \returns true iff the files' contents may differ.
+    bool operator != (const FileSystemFileInfo& other) const;
+
+    /// \brief Query the file system for a file's identity.
+    /// \param path The absolute path of the file.
+    /// \returns the file's identity. The identity's exists flag is false if
+    ///          the file does not exist or is not a regular file.
+    static FileSystemFileInfo stat(const std::string& path);
+
+    /// \brief Query the file system for an open file's identity.
+    /// \param fd The file descriptor of the open file.
+    /// \returns the file's identity. The identity's exists flag is false if
+    ///          the file is not a regular file or the platform has no file
+    ///          descriptors.
+    static FileSystemFileInfo stat(int fd);
+
+};
+
+
+/// \brief A file's metadata, response headers and, if small enough, its
+///        contents held in a FileSystemCache.
+class FileSystemCacheEntry
+{
+public:
+    /// \brief The absolute path of the file.
+    std::string path;
+
+    /// \brief The file's identity when it was read.
+    FileSystemFileInfo info;
+
+    /// \brief The formatted Content-Type header value.
+    std::string mediaType;
+
+    /// \brief The formatted Last-Modified header value.
+    std::string lastModified;
+
+    /// \brief The strong ETag header value.
+    std::string entityTag;
+
+    /// \brief The Cache-Control header value, empty if none is sent.
+    std::string cacheControl;
+
+    /// \brief The Content-Encoding header value, empty for the identity
+    ///        encoding.
+    std::string contentEncoding;
+
+    /// \brief True iff the file may be compressed on the fly.
+    bool isCompressible = false;
+
+    /// \brief The encodings, e.g. "br" or "gzip", of precompressed sibling
+    ///        files, e.g. "app.js.br" or "app.js.gz".
+    std::vector<std::string> precompressedEncodings;
+
+    /// \brief True iff the buffer holds the file's contents.
+    bool hasContents = false;
+
+    /// \brief The file's contents, if hasContents is true.
+    ofBuffer buffer;
+
+};
+
+
+/// \brief A bounded, least recently used cache of file metadata and
+///        contents.
+///
+/// Entries are keyed by request path, so a cache hit avoids resolving the
+/// request path on the file system. Entries are revalidated against the
+/// file's identity when they have not been validated within the
+/// revalidation interval, and are discarded if the file has changed.
+///
+/// Every file's metadata is cached, which allows conditional requests to be
+/// answered without opening the file. The contents are cached only for
+/// files that are small enough.
+///
+/// Entries are shared, so an entry that is evicted while it is being sent
+/// remains valid until the send completes.
+class FileSystemCache
+{
+public:
+    /// \brief Create a FileSystemCache.
+    /// \param maximumSize The maximum total size of cached file contents in
+    ///        bytes. 0 disables caching of contents.
+    /// \param maximumFileSize The maximum size of a file whose contents are
+    ///        cached in bytes.
+    /// \param maximumEntries The maximum number of cached files. 0 disables
+    ///        the cache.
+    /// \param revalidationInterval The interval in milliseconds after which
+    ///        an entry is checked against the file system.
+    /// \param useContentHash True to derive entity tags from a hash of the
+    ///        contents rather than from the file's identity.
+    FileSystemCache(uint64_t maximumSize = DEFAULT_MAXIMUM_SIZE,
+                    uint64_t maximumFileSize = DEFAULT_MAXIMUM_FILE_SIZE,
+                    std::size_t maximumEntries = DEFAULT_MAXIMUM_ENTRIES,
+                    uint64_t revalidationInterval = DEFAULT_REVALIDATION_INTERVAL,
+                    bool useContentHash = false);
+
+    /// \brief Destroy the FileSystemCache.
+    virtual ~FileSystemCache();
+
+    /// \brief Reconfigure the cache, discarding all entries.
+    /// \param maximumSize The maximum total size of cached contents in bytes.
+    /// \param maximumFileSize The maximum size of a file whose contents are
+    ///        cached in bytes.
+    /// \param maximumEntries The maximum number of cached files.
+    /// \param revalidationInterval The revalidation interval in milliseconds.
+    /// \param useContentHash True to derive entity tags from the contents.
+    void setup(uint64_t maximumSize,
+               uint64_t maximumFileSize,
+               std::size_t maximumEntries,
+               uint64_t revalidationInterval,
+               bool useContentHash);
+
+    /// \brief Get a valid entry.
+    ///
+    /// The entry is revalidated if its revalidation interval has elapsed.
+    ///
+    /// \param key The request path.
+    /// \returns the entry, or nullptr if it is not cached or has changed.
+    std::shared_ptr<const FileSystemCacheEntry> get(const std::string& key);
+
+    /// \brief Create an entry for a file and cache it if possible.
+    ///
+    /// The file's identity, Last-Modified, entity tag and, if small enough,
+    /// contents are filled in. The entity tag of an encoded file is suffixed
+    /// with its encoding. All other values are copied from the prototype.
+    ///
+    /// \param key The cache key, e.g. the request path.
+    /// \param prototype The entry's path and response headers.
+    /// \returns the entry, or nullptr if the file does not exist.
+    std::shared_ptr<const FileSystemCacheEntry> load(const std::string& key,
+                                                     const FileSystemCacheEntry& prototype);
+
+    /// \brief Cache an entry that was not read from its path, e.g. a
+    ///        compressed copy of a file.
+    ///
+    /// The entry is revalidated against its path and identity like any
+    /// other entry.
+    ///
+    /// \param key The cache key.
+    /// \param entry The entry.
+    void insert(const std::string& key,
+                std::shared_ptr<const FileSystemCacheEntry> entry);
+
+    /// \brief Remove an entry.
+    /// \param key The request path.
+    void remove(const std::string& key);
+
+    /// \brief Remove all entries.
+    void clear();
+
+    /// \returns the total size of the cached file contents in bytes.
+    uint64_t size() const;
+
+    /// \returns the number of cached files.
+    std::size_t numEntries() const;
+
+    /// \returns the number of requests served from the cache.
+    uint64_t hits() const;
+
+    /// \returns the number of requests that were not served from the cache.
+    uint64_t misses() const;
+
+    /// \brief Make a strong entity tag from a file's identity.
+    /// \param info The file's identity.
+    /// \returns the quoted entity tag.
+    static std::string makeEntityTag(const FileSystemFileInfo& info);
+
+    /// \brief Make a strong entity tag from a hash of a file's contents.
+    /// \param path The absolute path of the file.
+    /// \returns the quoted entity tag.
+    /// \throws Poco::FileException if the file can not be read.
+    static std::string makeContentEntityTag(const std::string& path);
+
+    /// \brief Make a strong entity tag from a hash of a file's contents.
+    /// \param buffer The file's contents.
+    /// \returns the quoted entity tag.
+    static std::string makeContentEntityTag(const ofBuffer& buffer);
+
+    /// \brief Make the entity tag of an encoded representation.
+    /// \param entityTag The quoted entity tag of the unencoded file.
+    /// \param contentEncoding The content encoding, e.g. "gzip".
+    /// \returns the quoted entity tag suffixed with the encoding.
+    static std::string makeEncodedEntityTag(const std::string& entityTag,
+                                            const std::string& contentEncoding);
+
+    /// \brief Default values.
+    enum Defaults
+    {
+        /// \brief The default maximum cache size (32 MB).
+        DEFAULT_MAXIMUM_SIZE = 33554432,
+        /// \brief The default maximum cached file size (1 MB).
+        DEFAULT_MAXIMUM_FILE_SIZE = 1048576,
+        /// \brief The default maximum number of cached files.
+        DEFAULT_MAXIMUM_ENTRIES = 4096,
+        /// \brief The default revalidation interval in milliseconds.
+        DEFAULT_REVALIDATION_INTERVAL = 1000
+    };
+
+private:
+    /// \brief A typedef for the recency list, most recently used first.
+    typedef std::list<std::string> RecencyList;
+
+    /// \brief A cached entry and its bookkeeping.
+    struct Node
+    {
+        /// \brief The entry.
+        std::shared_ptr<const FileSystemCacheEntry> entry;
+
+        /// \brief The time the entry was last validated in milliseconds.
+        uint64_t lastValidated = 0;
+
+        /// \brief The entry's position in the recency list.
+        RecencyList::iterator recency;
+    };
+
+    /// \brief Remove an entry. The caller must hold the lock.
+    void _remove(std::unordered_map<std::string, Node>::iterator iter);
+
+    /// \brief Evict entries until the cache fits. The caller must hold the lock.
+    void _evict();
+
+    uint64_t _maximumSize = DEFAULT_MAXIMUM_SIZE;
+    uint64_t _maximumFileSize = DEFAULT_MAXIMUM_FILE_SIZE;
+    std::size_t _maximumEntries = DEFAULT_MAXIMUM_ENTRIES;
+    uint64_t _revalidationInterval = DEFAULT_REVALIDATION_INTERVAL;
+    bool _useContentHash = false;
+
+    /// \brief The cached entries by request path.
+    std::unordered_map<std::string, Node> _entries;
+
+    /// \brief The request paths, most recently used first.
+    RecencyList _recency;
+
+    /// \brief The total size of the cached file contents in bytes.
+    uint64_t _size = 0;
+
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Poco/Timespan.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Sends file ranges to sockets through an io_uring.
+///
+/// A dedicated I/O thread owns the ring. Each range is sent in blocks: a
+/// read into one of a set of registered, fixed buffers is linked to a send
+/// of that buffer, so a block needs no further work from the I/O thread
+/// unless the read or send is short. Many transfers are in flight at once
+/// and their completions are reaped in batches, so a slow disk delays only
+/// the transfers that wait for it.
+///
+/// The calling thread waits for its transfer to complete, because a Poco
+/// request handler must finish its response before it returns. Each send
+/// is linked to a timeout, so a peer that stops reading fails its transfer
+/// and gives its buffer back instead of holding it, and stop(), forever.
+///
+/// The ring requires Linux 5.6 or newer. start() fails on other platforms,
+/// on older kernels and where io_uring is disabled, e.g. by a seccomp
+/// policy.
+class FileSystemIOUring
+{
+public:
+    /// \brief Create a stopped FileSystemIOUring.
+    /// \param numBuffers The number of fixed buffers, which bounds the
+    ///        number of transfers in flight.
+    /// \param bufferSize The size of each fixed buffer in bytes.
+    /// \param queueDepth The number of submission queue entries.
+    FileSystemIOUring(std::size_t numBuffers = DEFAULT_NUM_BUFFERS,
+                      std::size_t bufferSize = DEFAULT_BUFFER_SIZE,
+                      unsigned queueDepth = DEFAULT_QUEUE_DEPTH);
+
+    /// \brief Stop and destroy the FileSystemIOUring.
+    virtual ~FileSystemIOUring();
+
+    /// \brief Create the ring and start the I/O thread.
+    /// \returns true iff the ring is running.
+    bool start();
+
+    /// \brief Finish the transfers in flight and stop the I/O thread.
+    ///
+    /// A stalled transfer delays this by at most its send timeout.
+    void stop();
+
+    /// \returns true iff the ring is running.
+    bool isRunning() const;
+
+    /// \brief Send part of a file to a socket and wait for completion.
+    /// \param fd The file descriptor of the file.
+    /// \param socket The file descriptor of the unencrypted socket.
+    /// \param offset The offset of the first byte to send.
+    /// \param length The number of bytes to send.
+    /// \param timeout The longest time a single send may wait for the
+    ///        peer. A zero timeout uses DEFAULT_SEND_TIMEOUT.
+    /// \throws Poco::IllegalStateException if the ring is not running.
+    /// \throws Poco::IOException if the range can not be sent, e.g. because
+    ///         a send timed out.
+    void send(int fd,
+              int socket,
+              uint64_t offset,
+              uint64_t length,
+              const Poco::Timespan& timeout = DEFAULT_SEND_TIMEOUT);
+
+    /// \brief The default send timeout, which matches the server's default
+    ///        timeout.
+    static const Poco::Timespan DEFAULT_SEND_TIMEOUT;
+
+    /// \brief Default values.
+    enum Defaults
+    {
+        /// \brief The default number of fixed buffers.
+        DEFAULT_NUM_BUFFERS = 64,
+        /// \brief The default size of a fixed buffer in bytes.
+        DEFAULT_BUFFER_SIZE = 65536,
+        /// \brief The default number of submission queue entries.
+        DEFAULT_QUEUE_DEPTH = 256
+    };
+
+private:
+    FileSystemIOUring(const FileSystemIOUring&) = delete;
+    FileSystemIOUring& operator = (const FileSystemIOUring&) = delete;
+
+    struct Ring;
+    struct Transfer;
+
+    /// \brief Submit and reap until stopped.
+    void _run();
+
+    /// \brief Handle a completion.
+    void _complete(uint64_t userData, int result);
+
+    /// \brief Move queued transfers to the waiting list and re-arm the
+    ///        wake-up poll.
+    void _wake();
+
+    /// \brief Give free buffers to waiting transfers and start them.
+    void _assignBuffers();
+
+    /// \brief Submit a linked read and send of the next block.
+    void _submitBlock(Transfer& transfer);
+
+    /// \brief Submit a send of the unsent part of the buffer.
+    void _submitSend(Transfer& transfer);
+
+    /// \brief Prepare the timeout linked to the send just prepared.
+    void _prepareTimeout(Transfer& transfer);
+
+    /// \brief Continue or finish a transfer after a completion.
+    void _update(Transfer& transfer);
+
+    /// \brief Release a transfer's buffer and report its result.
+    void _finish(Transfer& transfer);
+
+    std::size_t _numBuffers = DEFAULT_NUM_BUFFERS;
+    std::size_t _bufferSize = DEFAULT_BUFFER_SIZE;
+    unsigned _queueDepth = DEFAULT_QUEUE_DEPTH;
+
+    /// \brief The ring, owned by the I/O thread while it runs.
+    std::unique_ptr<Ring> _ring;
+
+    /// \brief The fixed buffers, registered with the ring.
+    std::vector<char> _buffers;
+
+    /// \brief The indices of the free buffers.
+    std::vector<int> _freeBuffers;
+
+    /// \brief Transfers waiting for a buffer. Owned by the I/O thread.
+    std::deque<Transfer*> _waiting;
+
+    /// \brief The number of transfers holding a buffer.
+    std::size_t _numActive = 0;
+
+    /// \brief Transfers submitted by callers and not yet seen by the I/O
+    ///        thread.
+    std::deque<Transfer*> _queue;
+
+    /// \brief The eventfd that wakes the I/O thread.
+    int _eventFd = -1;
+
+    /// \brief True while callers may submit transfers.
+    bool _isRunning = false;
+
+    /// \brief The I/O thread.
+    std::thread _thread;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
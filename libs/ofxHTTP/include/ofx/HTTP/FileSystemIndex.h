@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "ofx/HTTP/FileSystemCache.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A file in a FileSystemIndex.
+class FileSystemIndexRecord
+{
+public:
+    /// \brief The file's own request path, e.g. "/css/style.css".
+    ///
+    /// A default index is also found by its directory's request path, but
+    /// its request path is always the full path, e.g. "/index.html".
+    std::string requestPath;
+
+    /// \brief The absolute path of the file.
+    std::string path;
+
+    /// \brief The file's identity when it was indexed.
+    FileSystemFileInfo info;
+
+    /// \brief The formatted Content-Type header value.
+    std::string mediaType;
+
+    /// \brief The formatted Last-Modified header value.
+    std::string lastModified;
+
+    /// \brief The strong ETag header value derived from the file's identity.
+    std::string entityTag;
+
+};
+
+
+/// \brief An index of every regular file below a document root.
+///
+/// The document root is scanned once when the index is opened. Afterwards
+/// the index is kept current by watching every directory with inotify, so a
+/// request path can be resolved with a single hash lookup and a request for
+/// a file that does not exist never touches the disk.
+///
+/// Request paths are matched exactly. Paths containing "." or ".."
+/// segments or repeated slashes are not found.
+///
+/// Directory symbolic links are not followed. Watching requires inotify, so
+/// the index can only be opened on Linux.
+class FileSystemIndex
+{
+public:
+    /// \brief Create a closed FileSystemIndex.
+    FileSystemIndex();
+
+    /// \brief Destroy the FileSystemIndex.
+    virtual ~FileSystemIndex();
+
+    /// \brief Scan a document root and watch it for changes.
+    ///
+    /// A previously open index is closed first.
+    ///
+    /// \param documentRoot The absolute path of the document root.
+    /// \param defaultIndex The file name served for a directory, e.g.
+    ///        "index.html".
+    /// \returns true iff the index is open and watching.
+    bool open(const std::string& documentRoot, const std::string& defaultIndex);
+
+    /// \brief Stop watching and discard all records.
+    void close();
+
+    /// \returns true iff the index is open and watching.
+    bool isOpen() const;
+
+    /// \brief Find the file for a request path.
+    /// \param requestPath The decoded request path, e.g. "/css/style.css".
+    /// \returns the record, or nullptr if there is no such file.
+    std::shared_ptr<const FileSystemIndexRecord> find(const std::string& requestPath) const;
+
+    /// \returns the number of indexed request paths.
+    std::size_t size() const;
+
+private:
+    /// \brief Scan a directory recursively, adding records and watches.
+    /// \param directory The absolute path of the directory.
+    void _scan(const std::string& directory);
+
+    /// \brief Add, update or remove the record of a file.
+    /// \param path The absolute path of the file.
+    void _update(const std::string& path);
+
+    /// \brief Remove the records and watches of a directory and its
+    ///        subdirectories.
+    /// \param directory The absolute path of the directory.
+    void _removeDirectory(const std::string& directory);
+
+    /// \brief Discard all records and watches and scan the document root
+    ///        again, e.g. after the kernel's event queue overflowed.
+    void _rescan();
+
+    /// \returns the request path of a file below the document root.
+    std::string _toRequestPath(const std::string& path) const;
+
+    /// \brief Read inotify events until closed.
+    void _watch();
+
+    /// \brief The absolute path of the document root without a trailing
+    ///        separator.
+    std::string _documentRoot;
+
+    /// \brief The file name served for a directory.
+    std::string _defaultIndex;
+
+    /// \brief The records by request path.
+    std::unordered_map<std::string, std::shared_ptr<const FileSystemIndexRecord>> _records;
+
+    /// \brief The watched directories by watch descriptor.
+    std::unordered_map<int, std::string> _watches;
+
+    /// \brief The inotify file descriptor, or -1.
+    int _inotify = -1;
+
+    /// \brief A pipe used to wake the watching thread when closing.
+    int _wakeup[2] = { -1, -1 };
+
+    /// \brief The thread reading inotify events.
+    std::thread _thread;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
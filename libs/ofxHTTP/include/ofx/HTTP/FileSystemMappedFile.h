@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "ofx/HTTP/FileSystemCache.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A read-only memory mapping of a whole file.
+///
+/// The kernel is advised that the mapping is read sequentially, so it reads
+/// ahead aggressively.
+///
+/// \warning Reading a page past the end of a file that was truncated after
+///          it was mapped raises SIGBUS. Readers must check the file's
+///          current size before touching each part of the mapping, as
+///          FileSystemRoute does per slice. Served files are best replaced,
+///          e.g. by renaming a new file over them, not truncated in place.
+class FileSystemMappedFile
+{
+public:
+    /// \brief Map an open file.
+    ///
+    /// The file descriptor may be closed once the file is mapped.
+    ///
+    /// \param fd The file descriptor of the file, open for reading.
+    /// \param info The file's identity, as returned by
+    ///        FileSystemFileInfo::stat(fd).
+    /// \throws Poco::IOException if the file can not be mapped.
+    /// \throws Poco::NotImplementedException if the platform has no mmap.
+    FileSystemMappedFile(int fd, const FileSystemFileInfo& info);
+
+    /// \brief Unmap the file.
+    virtual ~FileSystemMappedFile();
+
+    /// \returns the mapped bytes, or nullptr if the file is empty.
+    const char* data() const;
+
+    /// \returns the number of mapped bytes.
+    uint64_t size() const;
+
+    /// \returns the identity of the file when it was mapped.
+    const FileSystemFileInfo& info() const;
+
+private:
+    FileSystemMappedFile(const FileSystemMappedFile&) = delete;
+    FileSystemMappedFile& operator = (const FileSystemMappedFile&) = delete;
+
+    /// \brief The identity of the file when it was mapped.
+    FileSystemFileInfo _info;
+
+    /// \brief The mapping, or nullptr if the file is empty.
+    char* _data = nullptr;
+
+};
+
+
+/// \brief Shares memory mappings between concurrent readers of a file.
+///
+/// A mapping stays alive while any reader holds it. Readers of the same
+/// unchanged file share a mapping, and therefore the same page cache pages,
+/// instead of mapping the file again.
+class FileSystemMappedFileCache
+{
+public:
+    /// \brief Create a FileSystemMappedFileCache.
+    FileSystemMappedFileCache();
+
+    /// \brief Destroy the FileSystemMappedFileCache.
+    ///
+    /// Mappings still held by readers remain valid.
+    virtual ~FileSystemMappedFileCache();
+
+    /// \brief Get a mapping of an open file.
+    ///
+    /// An existing mapping is returned if the file's identity is unchanged.
+    ///
+    /// \param path The absolute path of the file.
+    /// \param fd The file descriptor of the file, open for reading.
+    /// \param info The file's identity, as returned by
+    ///        FileSystemFileInfo::stat(fd).
+    /// \returns the shared mapping.
+    /// \throws Poco::IOException if the file can not be mapped.
+    std::shared_ptr<const FileSystemMappedFile> map(const std::string& path,
+                                                    int fd,
+                                                    const FileSystemFileInfo& info);
+
+    /// \returns the number of files mapped by readers.
+    std::size_t numMappedFiles() const;
+
+private:
+    /// \brief The mappings by path. Unused mappings expire.
+    std::unordered_map<std::string, std::weak_ptr<const FileSystemMappedFile>> _files;
+
+    /// \brief The number of paths at which expired mappings are removed.
+    std::size_t _sweepSize = 64;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
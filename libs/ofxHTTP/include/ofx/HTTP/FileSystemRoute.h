@@ -8,7 +8,15 @@
 #pragma once
 
 
+#include <functional>
+#include <map>
+#include <mutex>
+#include "Poco/Net/StreamSocket.h"
 #include "ofx/HTTP/BaseRoute.h"
+#include "ofx/HTTP/FileSystemCache.h"
+#include "ofx/HTTP/FileSystemIndex.h"
+#include "ofx/HTTP/FileSystemIOUring.h"
+#include "ofx/HTTP/FileSystemMappedFile.h"
 
 
 namespace ofx {
@@ -24,17 +32,6 @@ public:
 
     virtual ~FileSystemRouteSettings();
 
-    // TODO:
-    // e.g. http://httpd.apache.org/docs/2.2/mod/mod_deflate.html
-    // or the reverse? compression type as key?
-    //    ofxHTTPCompressorEntry html(MediaType("text/html"));
-    //    html.addCompressionType(GZIP);
-    //    html.addCompressionType(DEFLATE);
-    //
-    //    ofxHTTPCompressorEntry plain(MediaType("text/plain"));
-    //    html.addCompressionType(GZIP);
-    //    html.addCompressionType(DEFLATE);
-
     void setDefaultIndex(const std::string& defaultIndex);
     const std::string& getDefaultIndex() const;
 
@@ -47,6 +44,194 @@ public:
     void setRequireDocumentRootInDataFolder(bool requireDocumentRootInDataFolder);
     bool getRequireDocumentRootInDataFolder() const;
 
+    /// \brief Set the maximum total size of the in-memory file cache.
+    /// \param maximumCacheSize The maximum cache size in bytes. 0 disables
+    ///        caching of file contents.
+    void setMaximumCacheSize(uint64_t maximumCacheSize);
+
+    /// \returns the maximum cache size in bytes.
+    uint64_t getMaximumCacheSize() const;
+
+    /// \brief Set the size of the largest file that will be cached.
+    ///
+    /// Larger files are always served from disk.
+    ///
+    /// \param maximumCachedFileSize The maximum cached file size in bytes.
+    void setMaximumCachedFileSize(uint64_t maximumCachedFileSize);
+
+    /// \returns the maximum cached file size in bytes.
+    uint64_t getMaximumCachedFileSize() const;
+
+    /// \brief Set the maximum number of files whose metadata is cached.
+    /// \param maximumCacheEntries The maximum number of cached files. 0
+    ///        disables the cache.
+    void setMaximumCacheEntries(std::size_t maximumCacheEntries);
+
+    /// \returns the maximum number of cached files.
+    std::size_t getMaximumCacheEntries() const;
+
+    /// \brief Set how often cached files are checked for changes on disk.
+    /// \param cacheRevalidationInterval The interval in milliseconds. 0
+    ///        checks on every request.
+    void setCacheRevalidationInterval(uint64_t cacheRevalidationInterval);
+
+    /// \returns the cache revalidation interval in milliseconds.
+    uint64_t getCacheRevalidationInterval() const;
+
+    /// \brief Enable zero-copy sending of uncached files.
+    ///
+    /// When enabled, files that are not served from the cache are sent from
+    /// the file descriptor to the socket with sendfile(2), bypassing
+    /// user-space buffers. This is only possible on unencrypted connections
+    /// on Linux and macOS; other connections read the file through a stream.
+    ///
+    /// \param useSendFile True to enable zero-copy sending.
+    void setUseSendFile(bool useSendFile);
+
+    /// \returns true iff zero-copy sending is enabled.
+    bool getUseSendFile() const;
+
+    /// \brief Send large uncached files from shared memory mappings.
+    ///
+    /// When enabled, large files that can not be sent with sendfile(2),
+    /// e.g. over TLS, are mapped into memory and written to the socket in
+    /// large slices. Concurrent downloads of the same file share one
+    /// mapping. This is only possible on Linux and macOS.
+    ///
+    /// \warning A mapped file that is truncated in place while it is being
+    ///          sent raises SIGBUS. Only enable this if served files are
+    ///          replaced atomically, e.g. by renaming.
+    ///
+    /// \param useMemoryMappedFiles True to send large files from mappings.
+    void setUseMemoryMappedFiles(bool useMemoryMappedFiles);
+
+    /// \returns true iff large files are sent from memory mappings.
+    bool getUseMemoryMappedFiles() const;
+
+    /// \brief Set the size of the smallest file sent from a mapping.
+    /// \param minimumMemoryMappedFileSize The minimum size in bytes.
+    void setMinimumMemoryMappedFileSize(uint64_t minimumMemoryMappedFileSize);
+
+    /// \returns the minimum size in bytes of files sent from a mapping.
+    uint64_t getMinimumMemoryMappedFileSize() const;
+
+    /// \brief Send uncached files through an io_uring.
+    ///
+    /// When enabled, files that are not served from the cache are read and
+    /// sent on unencrypted connections by a FileSystemIOUring, which keeps
+    /// many disk reads in flight at once. This takes precedence over
+    /// sendfile(2). It requires Linux 5.6 or newer and is ignored elsewhere.
+    ///
+    /// \param useIOUring True to send files through an io_uring.
+    void setUseIOUring(bool useIOUring);
+
+    /// \returns true iff files are sent through an io_uring.
+    bool getUseIOUring() const;
+
+    /// \brief Derive entity tags from the file contents.
+    ///
+    /// By default entity tags are derived from a file's inode, size and
+    /// modification time, which is free but changes when an identical file
+    /// is replaced. A content hash survives redeployment of identical files
+    /// at the cost of reading each file once when it is first requested.
+    ///
+    /// \param useContentHashEntityTags True to hash the file contents.
+    void setUseContentHashEntityTags(bool useContentHashEntityTags);
+
+    /// \returns true iff entity tags are derived from the file contents.
+    bool getUseContentHashEntityTags() const;
+
+    /// \brief Resolve request paths with an index of the document root.
+    ///
+    /// The document root is scanned when the route is set up and watched
+    /// for changes, so request paths are resolved without touching the disk.
+    /// Requests for missing files are answered from the index alone.
+    /// Request paths must match a file exactly, e.g. paths with ".."
+    /// segments are not found. The index requires inotify and is ignored on
+    /// platforms without it.
+    ///
+    /// \param useFileSystemIndex True to resolve request paths with an index.
+    void setUseFileSystemIndex(bool useFileSystemIndex);
+
+    /// \returns true iff request paths are resolved with an index.
+    bool getUseFileSystemIndex() const;
+
+    /// \brief Send a Cache-Control header for matching media types.
+    ///
+    /// Patterns are matched in the order they were added and the first
+    /// match is used. Files matching no pattern are sent without a
+    /// Cache-Control header.
+    ///
+    /// \param mediaTypeRange A media type range, e.g. "image/*" or "*/*".
+    /// \param cacheControl The Cache-Control header value, e.g.
+    ///        "public, max-age=86400".
+    void addCacheControl(const std::string& mediaTypeRange,
+                         const std::string& cacheControl);
+
+    /// \brief Remove all Cache-Control patterns.
+    void clearCacheControl();
+
+    /// \brief Get the Cache-Control header value for a media type.
+    /// \param mediaType The media type of a file.
+    /// \returns the value of the first matching pattern, or an empty string.
+    std::string getCacheControl(const std::string& mediaType) const;
+
+    /// \brief Serve precompressed sibling files.
+    ///
+    /// If a client accepts an encoding and a sibling file with the matching
+    /// extension, e.g. "app.js.br" or "app.js.gz", exists and is at least as
+    /// new as the file, the sibling is sent with a Content-Encoding header.
+    /// Siblings are looked for when a file is first cached.
+    ///
+    /// \param usePrecompressedFiles True to serve precompressed siblings.
+    void setUsePrecompressedFiles(bool usePrecompressedFiles);
+
+    /// \returns true iff precompressed siblings are served.
+    bool getUsePrecompressedFiles() const;
+
+    /// \brief Compress files with gzip on the fly.
+    ///
+    /// Files with a compressible media type and a size within the
+    /// compressed file size limits are compressed when first requested by
+    /// a client that accepts gzip. The compressed copies are cached.
+    ///
+    /// \param useCompression True to compress files on the fly.
+    void setUseCompression(bool useCompression);
+
+    /// \returns true iff files are compressed on the fly.
+    bool getUseCompression() const;
+
+    /// \brief Set the media type ranges that are compressed on the fly.
+    /// \param compressibleMediaTypes The compressible media type ranges.
+    void setCompressibleMediaTypes(const MediaTypeSet& compressibleMediaTypes);
+
+    /// \returns the media type ranges that are compressed on the fly.
+    const MediaTypeSet& getCompressibleMediaTypes() const;
+
+    /// \returns true iff the media type matches a compressible range.
+    bool isCompressible(const std::string& mediaType) const;
+
+    /// \brief Set the size of the smallest file compressed on the fly.
+    /// \param minimumCompressedFileSize The minimum size in bytes.
+    void setMinimumCompressedFileSize(uint64_t minimumCompressedFileSize);
+
+    /// \returns the minimum size in bytes of files compressed on the fly.
+    uint64_t getMinimumCompressedFileSize() const;
+
+    /// \brief Set the size of the largest file compressed on the fly.
+    /// \param maximumCompressedFileSize The maximum size in bytes.
+    void setMaximumCompressedFileSize(uint64_t maximumCompressedFileSize);
+
+    /// \returns the maximum size in bytes of files compressed on the fly.
+    uint64_t getMaximumCompressedFileSize() const;
+
+    /// \brief Set the maximum total size of cached compressed files.
+    /// \param maximumCompressedCacheSize The maximum size in bytes.
+    void setMaximumCompressedCacheSize(uint64_t maximumCompressedCacheSize);
+
+    /// \returns the maximum total size in bytes of cached compressed files.
+    uint64_t getMaximumCompressedCacheSize() const;
+
     static const std::string DEFAULT_DOCUMENT_ROOT;
     static const std::string DEFAULT_INDEX;
 
@@ -58,12 +243,53 @@ public:
     /// \brief The default HTTP methods for this route.
     static const HTTPMethodSet DEFAULT_GET_HTTP_METHODS;
 
+    /// \brief An unfortunate compromise until C++11.
+    static const std::string DEFAULT_COMPRESSIBLE_MEDIA_TYPES_ARRAY[];
+
+    /// \brief The default media type ranges compressed on the fly.
+    static const MediaTypeSet DEFAULT_COMPRESSIBLE_MEDIA_TYPES;
+
+    /// \brief Default values.
+    enum Defaults
+    {
+        /// \brief The default minimum size of files compressed on the fly.
+        DEFAULT_MINIMUM_COMPRESSED_FILE_SIZE = 1024,
+        /// \brief The default maximum size of files compressed on the fly (8 MB).
+        DEFAULT_MAXIMUM_COMPRESSED_FILE_SIZE = 8388608,
+        /// \brief The default maximum size of cached compressed files (16 MB).
+        DEFAULT_MAXIMUM_COMPRESSED_CACHE_SIZE = 16777216
+    };
+
 private:
     std::string _defaultIndex;
     std::string _documentRoot;
     
     bool _autoCreateDocumentRoot;
     bool _requireDocumentRootInDataFolder;
+
+    uint64_t _maximumCacheSize = FileSystemCache::DEFAULT_MAXIMUM_SIZE;
+    uint64_t _maximumCachedFileSize = FileSystemCache::DEFAULT_MAXIMUM_FILE_SIZE;
+    std::size_t _maximumCacheEntries = FileSystemCache::DEFAULT_MAXIMUM_ENTRIES;
+    uint64_t _cacheRevalidationInterval = FileSystemCache::DEFAULT_REVALIDATION_INTERVAL;
+
+    bool _useSendFile = true;
+    bool _useMemoryMappedFiles = false;
+    bool _useIOUring = false;
+    uint64_t _minimumMemoryMappedFileSize = FileSystemCache::DEFAULT_MAXIMUM_FILE_SIZE;
+    bool _useContentHashEntityTags = false;
+    bool _useFileSystemIndex = false;
+
+    /// \brief Media type ranges and their Cache-Control values, in order.
+    std::vector<std::pair<std::string, std::string>> _cacheControl;
+
+    bool _usePrecompressedFiles = true;
+    bool _useCompression = true;
+
+    MediaTypeSet _compressibleMediaTypes;
+
+    uint64_t _minimumCompressedFileSize = DEFAULT_MINIMUM_COMPRESSED_FILE_SIZE;
+    uint64_t _maximumCompressedFileSize = DEFAULT_MAXIMUM_COMPRESSED_FILE_SIZE;
+    uint64_t _maximumCompressedCacheSize = DEFAULT_MAXIMUM_COMPRESSED_CACHE_SIZE;
     
 };
 
@@ -78,12 +304,264 @@ public:
 
     virtual ~FileSystemRoute();
 
+    virtual void setup(const Settings& settings) override;
+
     virtual void handleRequest(ServerEventArgs& evt) override;
 
+    /// \brief Send the document root's page for the response status.
+    ///
+    /// The page for a status, e.g. "404.html", is read once and kept in
+    /// memory until the route is set up again. If there is no such page,
+    /// BaseRoute_::handleRequest() sends a default page.
+    ///
+    /// \param evt The server event arguments.
     virtual void handleErrorResponse(ServerEventArgs& evt);
 
     Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest& request) override;
 
+    /// \returns the in-memory file cache.
+    FileSystemCache& cache();
+
+    /// \brief Get the document root index.
+    ///
+    /// setup() replaces the index, so the returned index stays valid but may
+    /// no longer be the one used for new requests.
+    ///
+    /// \returns the document root index, which is open only if enabled.
+    std::shared_ptr<FileSystemIndex> index() const;
+
+    enum
+    {
+        /// \brief The size of the blocks in which files are read and sent.
+        COPY_BUFFER_SIZE = 65536,
+        /// \brief The size of the slices in which mapped files are sent.
+        MAPPED_SLICE_SIZE = 1048576
+    };
+
+protected:
+    /// \brief Get the document root's page for a status.
+    /// \param status The response status, e.g. 404.
+    /// \returns the page, or nullptr if the document root has none.
+    std::shared_ptr<const std::string> getErrorPage(int status);
+
+    /// \brief Open the document root index if it is enabled.
+    ///
+    /// The new index replaces the current one. Requests in progress keep the
+    /// index they started with.
+    void openIndex();
+
+    /// \brief Open an index of the document root if it is enabled.
+    /// \param index The closed index to open.
+    void _openIndex(FileSystemIndex& index);
+
+    /// \brief Start the io_uring if it is enabled.
+    ///
+    /// The new ring replaces the current one. Files being sent keep the ring
+    /// they started with until they are sent.
+    void startIOUring();
+
+    /// \returns the io_uring, or nullptr if it is disabled or unsupported.
+    std::shared_ptr<FileSystemIOUring> ioUring() const;
+
+    /// \brief Resolve a request path to a file in the document root.
+    ///
+    /// An error response is sent if the path can not be resolved.
+    ///
+    /// \param evt The server event arguments.
+    /// \param path The request path.
+    /// \param absolutePath The absolute path of the file.
+    /// \returns true iff the path was resolved.
+    bool resolvePath(ServerEventArgs& evt,
+                     const std::string& path,
+                     std::string& absolutePath);
+
+    /// \brief Select the content encoding of a file.
+    ///
+    /// A precompressed sibling is preferred over on-the-fly compression, and
+    /// Brotli over gzip. Compressed copies are cached in _encodedCache. A
+    /// file is only compressed if the response will have a body, so a
+    /// conditional request that matches the compressed copy's validators
+    /// gets a bodiless entry to answer with 304 Not Modified.
+    ///
+    /// \param evt The server event arguments.
+    /// \param key The request path.
+    /// \param entry The unencoded file.
+    /// \returns the file to send, which may be the unencoded file.
+    std::shared_ptr<const FileSystemCacheEntry> selectEncoding(ServerEventArgs& evt,
+                                                               const std::string& key,
+                                                               std::shared_ptr<const FileSystemCacheEntry> entry);
+
+    /// \brief Compress a file with gzip.
+    /// \param entry The unencoded file.
+    /// \returns the compressed file, or nullptr if compression does not
+    ///          reduce its size.
+    std::shared_ptr<const FileSystemCacheEntry> compress(const FileSystemCacheEntry& entry) const;
+
+    /// \brief Send a file, or 304 Not Modified if the client's copy is
+    ///        current.
+    /// \param evt The server event arguments.
+    /// \param key The request path.
+    /// \param entry The file.
+    /// \throws Poco::FileNotFoundException if the file does not exist.
+    /// \throws Poco::OpenFileException if the file can not be opened.
+    void sendEntry(ServerEventArgs& evt,
+                   const std::string& key,
+                   const FileSystemCacheEntry& entry);
+
+    /// \brief Evaluate the request's If-None-Match and If-Modified-Since
+    ///        preconditions, RFC 7232 section 6.
+    /// \param evt The server event arguments.
+    /// \param entry The file.
+    /// \returns true iff the client's copy is current.
+    bool isNotModified(ServerEventArgs& evt,
+                       const FileSystemCacheEntry& entry) const;
+
+    /// \brief Send a file from its cached contents.
+    /// \param evt The server event arguments.
+    /// \param entry The file.
+    void sendCachedFile(ServerEventArgs& evt, const FileSystemCacheEntry& entry);
+
+    /// \brief Send a file from disk.
+    ///
+    /// The file is sent with sendfile(2) if enabled and the connection
+    /// allows it, or read through a stream otherwise.
+    ///
+    /// \param evt The server event arguments.
+    /// \param key The request path.
+    /// \param entry The file.
+    /// \throws Poco::FileNotFoundException if the file does not exist.
+    /// \throws Poco::OpenFileException if the file can not be opened.
+    void sendDiskFile(ServerEventArgs& evt,
+                      const std::string& key,
+                      const FileSystemCacheEntry& entry);
+
+    /// \brief A function that sends part of a file's contents.
+    ///
+    /// The function is called with the response stream, the offset of the
+    /// first byte and the number of bytes to send.
+    typedef std::function<void(std::ostream&, uint64_t, uint64_t)> BodyWriter;
+
+    /// \brief Send a file, or the byte ranges of it that were requested.
+    ///
+    /// A satisfiable Range header, whose If-Range validator matches if
+    /// present, results in a 206 Partial Content response with a single
+    /// range or a multipart/byteranges body. An unsatisfiable Range results
+    /// in a 416 response. Otherwise the whole file is sent.
+    ///
+    /// \param evt The server event arguments.
+    /// \param entry The file.
+    /// \param writeBody The function that sends the file's contents.
+    void sendRanges(ServerEventArgs& evt,
+                    const FileSystemCacheEntry& entry,
+                    const BodyWriter& writeBody);
+
+    /// \brief Evaluate the request's If-Range precondition.
+    /// \param evt The server event arguments.
+    /// \param entry The file.
+    /// \returns true iff there is no If-Range header or it matches.
+    bool isIfRangeSatisfied(ServerEventArgs& evt,
+                            const FileSystemCacheEntry& entry) const;
+
+    /// \brief Open a file and check that it is unchanged.
+    ///
+    /// If the file changed since the entry was validated, its cache entry is
+    /// removed and the entry and the Last-Modified and ETag headers are
+    /// updated to describe the open file.
+    ///
+    /// \param evt The server event arguments.
+    /// \param key The request path.
+    /// \param entry The file, updated if it changed.
+    /// \returns the open file descriptor, which the caller must close.
+    /// \throws Poco::FileNotFoundException if the file does not exist.
+    /// \throws Poco::OpenFileException if the file can not be opened.
+    int openFile(ServerEventArgs& evt,
+                 const std::string& key,
+                 FileSystemCacheEntry& entry);
+
+    /// \returns true iff sendfile(2) can be used for the response.
+    static bool canSendFile(ServerEventArgs& evt);
+
+    /// \brief Send bytes after the response headers.
+    ///
+    /// Large writes bypass the small buffer of the response stream and go
+    /// to the socket, or the SSL layer of a secure socket, directly.
+    ///
+    /// \param evt The server event arguments.
+    /// \param stream The response stream.
+    /// \param data The bytes to send.
+    /// \param size The number of bytes to send.
+    /// \param sliceSize The maximum number of bytes per write.
+    /// \throws Poco::IOException if the bytes can not be sent.
+    static void sendBytes(ServerEventArgs& evt,
+                          std::ostream& stream,
+                          const char* data,
+                          std::size_t size,
+                          std::size_t sliceSize = COPY_BUFFER_SIZE);
+
+    /// \brief Send part of a memory mapped file after the response headers.
+    ///
+    /// The file is sent in slices of MAPPED_SLICE_SIZE bytes. Before each
+    /// slice is read, fstat(2) confirms that the file still holds it, so a
+    /// file truncated in place fails the response instead of raising SIGBUS.
+    /// A truncation that lands while a slice is being copied can still fault.
+    ///
+    /// \param evt The server event arguments.
+    /// \param stream The response stream.
+    /// \param file The mapping of the file.
+    /// \param fd The file descriptor the file was mapped from.
+    /// \param offset The offset of the first byte to send.
+    /// \param length The number of bytes to send.
+    /// \throws Poco::IOException if the file was truncated or the bytes can
+    ///         not be sent.
+    static void sendMappedRange(ServerEventArgs& evt,
+                                std::ostream& stream,
+                                const FileSystemMappedFile& file,
+                                int fd,
+                                uint64_t offset,
+                                uint64_t length);
+
+    /// \brief Copy part of a file to a socket in the kernel.
+    ///
+    /// Partial writes and interrupted calls are retried until the range has
+    /// been sent. On Linux, SIGPIPE is blocked on the calling thread during
+    /// the transfer, so a closed connection fails with EPIPE instead of
+    /// killing the process. Other platforms rely on SO_NOSIGPIPE.
+    ///
+    /// \param socket The unencrypted destination socket.
+    /// \param fd The source file descriptor.
+    /// \param offset The offset of the first byte to send.
+    /// \param length The number of bytes to send.
+    /// \throws Poco::IOException if the range can not be sent.
+    static void sendFileRange(Poco::Net::StreamSocket& socket,
+                              int fd,
+                              uint64_t offset,
+                              uint64_t length);
+
+    /// \brief The in-memory file cache, keyed by request path.
+    FileSystemCache _cache;
+
+    /// \brief The cache of compressed files, keyed by request path and
+    ///        content encoding.
+    FileSystemCache _encodedCache;
+
+    /// \brief The index of the document root, closed if disabled.
+    std::shared_ptr<FileSystemIndex> _index;
+
+    /// \brief The memory mappings of files being sent.
+    FileSystemMappedFileCache _mappedFiles;
+
+    /// \brief The io_uring, if enabled and supported.
+    std::shared_ptr<FileSystemIOUring> _ioUring;
+
+    /// \brief The mutex for the index and the io_uring pointers.
+    mutable std::mutex _resourcesMutex;
+
+    /// \brief The error pages by status, nullptr if a status has none.
+    std::map<int, std::shared_ptr<const std::string>> _errorPages;
+
+    /// \brief The mutex for the error pages.
+    std::mutex _errorPagesMutex;
+
 };
 
     
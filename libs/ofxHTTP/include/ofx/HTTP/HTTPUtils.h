@@ -8,6 +8,7 @@
 #pragma once
 
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "Poco/NullStream.h"
@@ -28,6 +29,22 @@ namespace HTTP {
 class HTTPUtils
 {
 public:
+    /// \brief An inclusive range of byte positions.
+    struct ByteRange
+    {
+        /// \brief The position of the first byte.
+        uint64_t first = 0;
+
+        /// \brief The position of the last byte.
+        uint64_t last = 0;
+
+        /// \returns the number of bytes in the range.
+        uint64_t length() const
+        {
+            return last - first + 1;
+        }
+    };
+
     /// \brief Extract name-value pairs from text/plain encoded posts.
     /// \param textPlain The plain text post data.  This function assumes
     ///        that each form field is on its own line.  It then splits the
@@ -84,6 +101,64 @@ public:
     /// \returns the number of bytes consumed.
     static std::streamsize consume(std::istream& stream);
 
+    /// \brief Parse the value of a Range header.
+    ///
+    /// Ranges are clamped to the representation's size. Unsatisfiable
+    /// ranges are omitted, and overlapping or adjacent ranges are sorted and
+    /// coalesced so that no byte is sent twice.
+    ///
+    /// \param range The Range header value, e.g. "bytes=0-499,-500".
+    /// \param size The size of the representation in bytes.
+    /// \param ranges The satisfiable ranges.
+    /// \param maximumRanges The maximum number of range specifiers.
+    /// \returns false if the header is malformed, uses a unit other than
+    ///          bytes or has too many specifiers, in which case it must be
+    ///          ignored. If true and ranges is empty, the range is not
+    ///          satisfiable.
+    static bool parseByteRanges(const std::string& range,
+                                uint64_t size,
+                                std::vector<ByteRange>& ranges,
+                                std::size_t maximumRanges = DEFAULT_MAXIMUM_BYTE_RANGES);
+
+    /// \brief Match an entity tag against an If-Match or If-None-Match list.
+    /// \param condition The header value, e.g. "*" or "\"a\", W/\"b\"".
+    /// \param entityTag The quoted entity tag of the representation.
+    /// \param weak True to use the weak comparison function, which ignores
+    ///        the weakness indicator. The strong comparison function only
+    ///        matches strong, identical tags.
+    /// \returns true iff the entity tag matches the condition.
+    static bool matchesEntityTag(const std::string& condition,
+                                 const std::string& entityTag,
+                                 bool weak);
+
+    /// \brief Determine whether an Accept-Encoding header accepts a coding.
+    /// \param acceptEncoding The Accept-Encoding header value, e.g.
+    ///        "gzip, deflate;q=0.5, br".
+    /// \param contentCoding The content coding, e.g. "gzip".
+    /// \returns true iff the coding, or "*", is listed with a non-zero
+    ///          quality value.
+    static bool acceptsEncoding(const std::string& acceptEncoding,
+                                const std::string& contentCoding);
+
+    /// \brief Get the default HTML page for an error status.
+    ///
+    /// Pages are rendered once per status and reason and then shared.
+    ///
+    /// \param status The response status, e.g. 404.
+    /// \param reason The response reason, e.g. "Not Found".
+    /// \returns the rendered page.
+    static std::shared_ptr<const std::string> getErrorPage(int status,
+                                                           const std::string& reason);
+
+    /// \brief Default values.
+    enum Defaults
+    {
+        /// \brief The default maximum number of range specifiers.
+        DEFAULT_MAXIMUM_BYTE_RANGES = 32,
+        /// \brief The maximum number of distinct error pages kept rendered.
+        MAXIMUM_CACHED_ERROR_PAGES = 128
+    };
+
     /// \brief Join a list of values into a single delimited string.
     /// \param values The list of values to explode.
     /// \param delimiter The delimiter to use when exploding.
@@ -67,10 +67,24 @@ public:
 
     ofBuffer& buffer();
 
+    const ofBuffer& buffer() const;
+
+    /// \brief Set the pre-rendered multipart header for this frame.
+    ///
+    /// The header is rendered once per encoded frame and sent unchanged to
+    /// every client, immediately followed by the frame buffer.
+    ///
+    /// \param header The multipart header.
+    void setHeader(const std::string& header);
+
+    /// \returns the pre-rendered multipart header for this frame.
+    const std::string& header() const;
+
 private:
     IPVideoFrameSettings _settings;
     uint64_t _timestamp;
     ofBuffer _buffer;
+    std::string _header;
     
 };
 
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ofFileUtils.h"
+#include "ofImage.h"
+#include "ofx/HTTP/IPVideoWorkerPool.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A baseline JPEG encoder that encodes horizontal bands in parallel.
+///
+/// The image is split into bands of whole MCU rows. Every MCU row is a
+/// restart interval, so each band can be entropy coded independently on a
+/// worker thread. The bands are then stitched together, separated by restart
+/// markers, into a single valid baseline JPEG.
+///
+/// Grayscale images are encoded with a single component. Color images are
+/// encoded as YCbCr with 4:2:0 chroma subsampling.
+class IPVideoJPEGEncoder
+{
+public:
+    /// \brief Encode pixels as a JPEG.
+    /// \param pixels The pixels to encode. Must be GRAY, RGB or BGR.
+    /// \param buffer The buffer to append the JPEG to.
+    /// \param quality The image quality.
+    /// \param maxThreads The maximum number of threads. 0 will use the number
+    ///        of available hardware threads.
+    /// \param workerPool The pool that encodes the bands, or nullptr to use
+    ///        the default pool.
+    /// \returns false if the pixel format is not supported.
+    static bool encode(const ofPixels& pixels,
+                       ofBuffer& buffer,
+                       ofImageQualityType quality,
+                       std::size_t maxThreads = 0,
+                       IPVideoWorkerPool* workerPool = nullptr);
+
+    /// \brief Encode raw 8 bit pixels as a JPEG.
+    /// \param data A pointer to the first row of pixels.
+    /// \param width The width in pixels.
+    /// \param height The height in pixels.
+    /// \param numChannels The number of interleaved channels, 1 or 3.
+    /// \param rowStride The number of bytes between the start of each row.
+    /// \param isBGR True if three channel pixels are stored as BGR.
+    /// \param quality The JPEG quality in the range [1, 100].
+    /// \param maxThreads The maximum number of threads. 0 will use the number
+    ///        of available hardware threads.
+    /// \param segments The encoded JPEG, as segments to be concatenated.
+    /// \param workerPool The pool that encodes the bands, or nullptr to use
+    ///        the default pool.
+    /// \returns false if the parameters are not supported.
+    static bool encode(const unsigned char* data,
+                       std::size_t width,
+                       std::size_t height,
+                       std::size_t numChannels,
+                       std::size_t rowStride,
+                       bool isBGR,
+                       int quality,
+                       std::size_t maxThreads,
+                       std::vector<std::string>& segments,
+                       IPVideoWorkerPool* workerPool = nullptr);
+
+    /// \brief Convert an ofImageQualityType to a JPEG quality.
+    ///
+    /// The mapping matches the one used by ofSaveImage().
+    ///
+    /// \param quality The image quality.
+    /// \returns the JPEG quality in the range [1, 100].
+    static int toJPEGQuality(ofImageQualityType quality);
+
+    enum
+    {
+        /// \brief The minimum number of MCU rows in an encoding band.
+        MIN_BAND_MCU_ROWS = 4
+    };
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <istream>
+#include <string>
+#include "ofFileUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief An incremental multipart/x-mixed-replace parser.
+///
+/// Parts are read one at a time directly from the stream, so an endless
+/// MJPEG response never needs to be buffered. Parts with a Content-Length
+/// header are read with a single bulk read. Parts without one are scanned
+/// for the next boundary.
+///
+/// Both the standard "--" + boundary delimiter and the bare boundary, as
+/// written by IPVideoRoute's default settings, are accepted.
+class IPVideoMultipartParser
+{
+public:
+    /// \brief Create an IPVideoMultipartParser.
+    /// \param boundary The boundary parameter of the response Content-Type.
+    IPVideoMultipartParser(const std::string& boundary);
+
+    /// \brief Destroy the IPVideoMultipartParser.
+    virtual ~IPVideoMultipartParser();
+
+    /// \brief Read the next part's body.
+    /// \param stream The response stream.
+    /// \param part The buffer to read the body into. Its memory is reused.
+    /// \returns false at the end of the stream or after the final boundary.
+    /// \throws Poco::DataFormatException if the stream is malformed.
+    bool next(std::istream& stream, ofBuffer& part);
+
+    /// \brief Get the boundary from a multipart Content-Type.
+    /// \param contentType The Content-Type header value.
+    /// \returns the boundary or an empty string if there is none.
+    static std::string boundary(const std::string& contentType);
+
+    enum
+    {
+        /// \brief The maximum length of a boundary or header line.
+        MAX_LINE_LENGTH = 4096,
+        /// \brief The maximum size of a single part in bytes.
+        MAX_PART_SIZE = 64 * 1024 * 1024
+    };
+
+private:
+    /// \brief Read a line, without its line ending.
+    /// \returns false at the end of the stream.
+    static bool readLine(std::istream& stream, std::string& line);
+
+    /// \brief Determine if a line is a boundary line.
+    /// \param line The line to test.
+    /// \param isFinal True if the boundary is the final boundary.
+    /// \returns true iff the line is a boundary line.
+    bool isBoundary(const std::string& line, bool& isFinal) const;
+
+    /// \brief Read a body without a Content-Length up to the next boundary.
+    bool readUntilBoundary(std::istream& stream, ofBuffer& part);
+
+    /// \brief The boundary.
+    std::string _boundary;
+
+    /// \brief True if the next boundary was already consumed.
+    bool _hasPendingBoundary = false;
+
+    /// \brief True if the final boundary was reached.
+    bool _isFinal = false;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ofPixels.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A pool of reusable, reference counted pixel buffers.
+///
+/// Pixels acquired from the pool are returned to it automatically when the
+/// last reference is released, e.g. after an IPVideoRoute has finished
+/// encoding them. Released pixels keep their allocation, so a source with a
+/// fixed size and format allocates only a handful of buffers in total.
+///
+/// The pool may be destroyed while its pixels are still in use. Those pixels
+/// are then freed when they are released.
+class IPVideoPixelPool
+{
+public:
+    /// \brief Create an IPVideoPixelPool.
+    /// \param maxIdle The maximum number of idle buffers kept for reuse.
+    IPVideoPixelPool(std::size_t maxIdle = DEFAULT_MAX_IDLE);
+
+    /// \brief Destroy the IPVideoPixelPool.
+    virtual ~IPVideoPixelPool();
+
+    /// \brief Acquire pixels with the given size and format.
+    ///
+    /// An idle buffer with a matching allocation is preferred. The contents
+    /// of the pixels are undefined.
+    ///
+    /// \param width The width in pixels.
+    /// \param height The height in pixels.
+    /// \param format The pixel format.
+    /// \returns allocated pixels that return to the pool when released.
+    std::shared_ptr<ofPixels> acquire(std::size_t width,
+                                      std::size_t height,
+                                      ofPixelFormat format);
+
+    /// \returns the number of idle buffers.
+    std::size_t numIdle() const;
+
+    enum
+    {
+        /// \brief The default maximum number of idle buffers.
+        DEFAULT_MAX_IDLE = 4
+    };
+
+private:
+    /// \brief The state shared with the buffers' deleters.
+    struct State
+    {
+        /// \brief The idle buffers.
+        std::vector<std::unique_ptr<ofPixels>> idle;
+
+        /// \brief The maximum number of idle buffers.
+        std::size_t maxIdle = DEFAULT_MAX_IDLE;
+
+        std::mutex mutex;
+    };
+
+    /// \brief Return a released buffer to the pool or free it.
+    static void release(const std::weak_ptr<State>& state, ofPixels* pixels);
+
+    std::shared_ptr<State> _state;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ofx/HTTP/IPVideoRoute.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Records an IPVideoStream's encoded frames to disk.
+///
+/// The recorder subscribes to a stream and appends the already encoded JPEG
+/// buffers, unchanged, to a series of segment files in a recording
+/// directory. Each segment is a plain concatenation of JPEGs. A separate
+/// index file holds one fixed size IndexEntry per frame, so a time can be
+/// located with a binary search without reading the recording.
+///
+/// Frames are written on the recorder's own thread. If the disk falls behind
+/// by more than the maximum queue size, the oldest queued frames are dropped.
+class IPVideoRecorder: public AbstractIPVideoFrameListener
+{
+public:
+    /// \brief The location of a single recorded frame.
+    struct IndexEntry
+    {
+        /// \brief The frame time in milliseconds since the recording started.
+        uint64_t timestamp = 0;
+
+        /// \brief The segment number containing the frame.
+        uint32_t segment = 0;
+
+        /// \brief The frame's byte offset in the segment.
+        uint64_t offset = 0;
+
+        /// \brief The frame's size in bytes.
+        uint32_t size = 0;
+    };
+
+    /// \brief Create an IPVideoRecorder.
+    /// \param route The route that encodes the stream. The recorder must be
+    ///        destroyed before the route.
+    /// \param streamName The name of the stream to record.
+    IPVideoRecorder(IPVideoRoute& route,
+                    const std::string& streamName = IPVideoRoute::DEFAULT_STREAM_NAME);
+
+    /// \brief Destroy the IPVideoRecorder, finishing any recording.
+    virtual ~IPVideoRecorder();
+
+    /// \brief Start recording.
+    ///
+    /// Any existing recording in the directory is overwritten.
+    ///
+    /// \param directory The recording directory, relative to the data folder.
+    /// \param maxSegmentSize The size in bytes after which a new segment file
+    ///        is started.
+    /// \param maxQueueSize The maximum number of frames waiting to be written.
+    /// \returns true iff the recording was started.
+    bool start(const std::string& directory,
+               uint64_t maxSegmentSize = DEFAULT_MAX_SEGMENT_SIZE,
+               std::size_t maxQueueSize = DEFAULT_MAX_QUEUE_SIZE);
+
+    /// \brief Stop recording after writing all queued frames.
+    void stop();
+
+    /// \returns true iff the recorder is recording.
+    bool isRecording() const;
+
+    void frameEncoded(const IPVideoStream& stream,
+                      std::shared_ptr<IPVideoFrame> frame,
+                      uint64_t sequence) override;
+
+    bool isListening() const override;
+
+    /// \returns the number of frames written to the current recording.
+    uint64_t framesRecorded() const;
+
+    /// \returns the number of frames dropped because the disk fell behind.
+    uint64_t framesDropped() const;
+
+    /// \returns the number of JPEG bytes written to the current recording.
+    uint64_t bytesRecorded() const;
+
+    /// \param directory The recording directory.
+    /// \returns the absolute path of the recording's index file.
+    static std::string indexPath(const std::string& directory);
+
+    /// \param directory The recording directory.
+    /// \param segment The segment number.
+    /// \returns the absolute path of the segment file.
+    static std::string segmentPath(const std::string& directory,
+                                   uint32_t segment);
+
+    /// \brief Write an index entry as INDEX_ENTRY_SIZE big-endian bytes.
+    /// \param stream The stream to write to.
+    /// \param entry The entry to write.
+    static void writeIndexEntry(std::ostream& stream, const IndexEntry& entry);
+
+    /// \brief Read the index entry at a position.
+    /// \param stream The index stream.
+    /// \param position The entry number.
+    /// \param entry The entry that was read.
+    /// \returns true iff the entry was read.
+    static bool readIndexEntry(std::istream& stream,
+                               std::size_t position,
+                               IndexEntry& entry);
+
+    /// \param stream The index stream.
+    /// \returns the number of complete entries in the index.
+    static std::size_t numIndexEntries(std::istream& stream);
+
+    /// \brief Find the first frame at or after a time.
+    /// \param stream The index stream.
+    /// \param timestamp The time in milliseconds since the recording started.
+    /// \returns the entry number, or numIndexEntries() if there is none.
+    static std::size_t findIndexEntry(std::istream& stream, uint64_t timestamp);
+
+    enum
+    {
+        /// \brief The size of a serialized IndexEntry in bytes.
+        INDEX_ENTRY_SIZE = 24,
+        /// \brief The default segment size in bytes.
+        DEFAULT_MAX_SEGMENT_SIZE = 64 * 1024 * 1024,
+        /// \brief The default maximum number of frames waiting to be written.
+        DEFAULT_MAX_QUEUE_SIZE = 30
+    };
+
+    /// \brief The name of the index file in the recording directory.
+    static const std::string INDEX_FILE_NAME;
+
+    /// \brief The extension of the segment files.
+    static const std::string SEGMENT_FILE_EXTENSION;
+
+protected:
+    /// \brief Write queued frames until the recording is stopped.
+    void run();
+
+    /// \brief The stream being recorded.
+    std::shared_ptr<IPVideoStream> _stream;
+
+    /// \brief The absolute recording directory.
+    std::string _directory;
+
+    /// \brief The size in bytes after which a new segment is started.
+    uint64_t _maxSegmentSize = DEFAULT_MAX_SEGMENT_SIZE;
+
+    /// \brief The maximum number of frames waiting to be written.
+    std::size_t _maxQueueSize = DEFAULT_MAX_QUEUE_SIZE;
+
+    /// \brief The frames waiting to be written.
+    std::deque<std::shared_ptr<IPVideoFrame>> _queue;
+
+    /// \brief True while recording.
+    bool _isRecording = false;
+
+    /// \brief The number of frames written.
+    uint64_t _framesRecorded = 0;
+
+    /// \brief The number of frames dropped.
+    uint64_t _framesDropped = 0;
+
+    /// \brief The number of JPEG bytes written.
+    uint64_t _bytesRecorded = 0;
+
+    /// \brief The writer thread.
+    std::thread _thread;
+
+    /// \brief Signals the writer thread.
+    std::condition_variable _condition;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Poco/Net/MediaType.h"
+#include "ofx/HTTP/BaseRoute.h"
+#include "ofx/HTTP/IPVideoRecorder.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Settings for an IPVideoReplayRoute.
+class IPVideoReplayRouteSettings: public BaseRouteSettings
+{
+public:
+    /// \brief Create IPVideoReplayRouteSettings.
+    /// \param routePathPattern The regex pattern that this route will handle.
+    /// \param requireSecurePort True if this route requires communication
+    ///        on an SSL encrypted port.
+    IPVideoReplayRouteSettings(const std::string& routePathPattern = DEFAULT_REPLAY_ROUTE,
+                               bool requireSecurePort = false);
+
+    /// \brief Destroy the IPVideoReplayRouteSettings.
+    virtual ~IPVideoReplayRouteSettings();
+
+    /// \brief Set the recording directory written by an IPVideoRecorder.
+    /// \param recordingDirectory The directory, relative to the data folder.
+    void setRecordingDirectory(const std::string& recordingDirectory);
+    const std::string& getRecordingDirectory() const;
+
+    void setBoundaryMarker(const std::string& boundaryMarker);
+    const std::string& getBoundaryMarker() const;
+
+    void setMediaType(const Poco::Net::MediaType& mediaType);
+    const Poco::Net::MediaType& getMediaType() const;
+
+    /// \brief The default replay route path pattern.
+    ///
+    /// It lies outside IPVideoRouteSettings::DEFAULT_STREAM_PATH_PREFIX, so
+    /// an IPVideoRoute with default settings never claims replay requests.
+    static const std::string DEFAULT_REPLAY_ROUTE;
+
+    /// \brief The default recording directory.
+    static const std::string DEFAULT_RECORDING_DIRECTORY;
+
+private:
+    std::string _recordingDirectory;
+    std::string _boundaryMarker;
+    Poco::Net::MediaType _mediaType;
+
+};
+
+
+class IPVideoReplayConnection;
+
+
+/// \brief Replays a recording made by an IPVideoRecorder as an MJPEG stream.
+///
+/// The optional query parameter t selects the start time in milliseconds
+/// since the recording started, e.g. /ipvideo-replay?t=60000. Frames are
+/// read from disk one at a time and paced by their recorded timestamps.
+class IPVideoReplayRoute: public BaseRoute_<IPVideoReplayRouteSettings>
+{
+public:
+    typedef IPVideoReplayRouteSettings Settings;
+
+    /// \brief Create an IPVideoReplayRoute.
+    /// \param settings The route settings.
+    IPVideoReplayRoute(const Settings& settings);
+
+    /// \brief Destroy the IPVideoReplayRoute.
+    virtual ~IPVideoReplayRoute();
+
+    Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest& request) override;
+
+    void stop() override;
+
+    /// \returns the number of clients replaying the recording.
+    std::size_t numConnections() const;
+
+protected:
+    void addConnection(IPVideoReplayConnection* connection);
+
+    void removeConnection(IPVideoReplayConnection* connection);
+
+    /// \brief The replaying clients.
+    std::vector<IPVideoReplayConnection*> _connections;
+
+    mutable std::mutex _mutex;
+
+    friend class IPVideoReplayConnection;
+
+};
+
+
+/// \brief Replays a recording to a single client.
+class IPVideoReplayConnection: public BaseRouteHandler_<IPVideoReplayRoute>
+{
+public:
+    /// \brief Create an IPVideoReplayConnection.
+    /// \param route The parent route.
+    IPVideoReplayConnection(IPVideoReplayRoute& route);
+
+    /// \brief Destroy the IPVideoReplayConnection.
+    virtual ~IPVideoReplayConnection();
+
+    void handleRequest(ServerEventArgs& evt) override;
+
+    void stop() override;
+
+protected:
+    /// \brief True if the handler is running.
+    std::atomic<bool> _isRunning;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -18,10 +18,17 @@
 
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include "Poco/Net/StreamSocket.h"
 #include "ofImage.h"
 #include "ofx/HTTP/BaseRoute.h"
 #include "ofx/HTTP/HTTPUtils.h"
 #include "ofx/HTTP/IPVideoFrame.h"
+#include "ofx/HTTP/IPVideoJPEGEncoder.h"
+#include "ofx/HTTP/IPVideoWorkerPool.h"
 
 
 namespace ofx {
@@ -116,6 +123,109 @@ public:
     void setMaxStreamHeight(std::size_t maxStreamHeight);
     std::size_t getMaxStreamHeight() const;
 
+    /// \brief Reuse the previously encoded frame if the pixels are unchanged.
+    ///
+    /// Change detection uses a cheap content hash of the submitted pixels, so
+    /// there is a very small chance that a changed frame is not detected. If
+    /// the frame hash row stride is greater than 1, changes confined to the
+    /// skipped rows are never detected.
+    ///
+    /// \param skipUnchangedFrames True if unchanged frames should not be
+    ///        encoded again.
+    void setSkipUnchangedFrames(bool skipUnchangedFrames);
+    bool getSkipUnchangedFrames() const;
+
+    /// \brief Set the row sampling stride used to hash the submitted pixels.
+    ///
+    /// A stride of N hashes 1 / N of the rows, so a change that touches only
+    /// the skipped rows is missed and the previous frame is sent again. Only
+    /// use a stride greater than 1 if every change is known to span several
+    /// rows.
+    ///
+    /// \param frameHashRowStride Hash every Nth row. 1 hashes every row.
+    void setFrameHashRowStride(std::size_t frameHashRowStride);
+    std::size_t getFrameHashRowStride() const;
+
+    /// \brief Set the maximum number of threads used to resample frames.
+    /// \param maxResampleThreads The maximum number of threads. 0 will use
+    ///        the number of available hardware threads.
+    void setMaxResampleThreads(std::size_t maxResampleThreads);
+    std::size_t getMaxResampleThreads() const;
+
+    /// \brief Set the path that serves a snapshot of the latest frame.
+    ///
+    /// Snapshot requests are served from the most recently encoded frame and
+    /// do not count against the maximum number of client connections.
+    ///
+    /// \param snapshotPath The snapshot path. An empty path disables snapshots.
+    void setSnapshotPath(const std::string& snapshotPath);
+    const std::string& getSnapshotPath() const;
+
+    /// \brief Set how long frames are encoded after the last snapshot request.
+    ///
+    /// Frames are only encoded while there are streaming clients or while
+    /// snapshots have been requested within this timeout.
+    ///
+    /// \param snapshotIdleTimeout The timeout in milliseconds.
+    void setSnapshotIdleTimeout(uint64_t snapshotIdleTimeout);
+    uint64_t getSnapshotIdleTimeout() const;
+
+    /// \brief Set the path prefix that selects a named stream.
+    ///
+    /// A request for the prefix followed by a stream name (e.g.
+    /// /ipvideo/camera1) selects that stream. The stream name followed by
+    /// /snapshot.jpg selects the stream's snapshot. Requests matching the
+    /// route path pattern select the default stream.
+    ///
+    /// \param streamPathPrefix The prefix. An empty prefix disables named
+    ///        stream paths.
+    void setStreamPathPrefix(const std::string& streamPathPrefix);
+    const std::string& getStreamPathPrefix() const;
+
+    /// \brief Set the number of quality tiers clients can be moved between.
+    ///
+    /// Each tier halves the frame dimensions and lowers the JPEG quality one
+    /// step relative to the previous tier. Clients that can't keep up with
+    /// the live frame rate are moved to a lower tier and moved back up when
+    /// their throughput allows it.
+    ///
+    /// \param numQualityTiers The number of tiers. 1 disables adaptation.
+    void setNumQualityTiers(std::size_t numQualityTiers);
+    std::size_t getNumQualityTiers() const;
+
+    /// \brief Set the minimum time a client must stay under sustained
+    ///        pressure or headroom before its tier changes.
+    /// \param adaptiveHoldTime The hold time in milliseconds.
+    void setAdaptiveHoldTime(uint64_t adaptiveHoldTime);
+    uint64_t getAdaptiveHoldTime() const;
+
+    /// \brief Set the link utilization above which a client moves down a tier.
+    /// \param downgradeUtilization The utilization, where 1 means that a
+    ///        frame takes as long to send as the interval between frames.
+    void setDowngradeUtilization(float downgradeUtilization);
+    float getDowngradeUtilization() const;
+
+    /// \brief Set the predicted link utilization below which a client moves
+    ///        up a tier.
+    /// \param upgradeUtilization The predicted utilization of the next tier.
+    void setUpgradeUtilization(float upgradeUtilization);
+    float getUpgradeUtilization() const;
+
+    /// \brief Encode frames with the band-parallel IPVideoJPEGEncoder.
+    ///
+    /// Frames are split into horizontal bands that are encoded in parallel
+    /// and stitched into a single baseline JPEG.
+    ///
+    /// \param useParallelEncoder True if the parallel encoder should be used.
+    void setUseParallelEncoder(bool useParallelEncoder);
+    bool getUseParallelEncoder() const;
+
+    /// \brief Set the maximum number of threads used to encode a frame.
+    /// \param maxEncoderThreads The maximum number of threads. 0 will use
+    ///        the number of available hardware threads.
+    void setMaxEncoderThreads(std::size_t maxEncoderThreads);
+    std::size_t getMaxEncoderThreads() const;
+
     enum
     {
         DEFAULT_MAX_CLIENT_CONNECTIONS = 5,
@@ -130,8 +240,31 @@ public:
         DEFAULT_MAX_STREAM_HEIGHT = 1080,
     };
 
+    enum
+    {
+        DEFAULT_FRAME_HASH_ROW_STRIDE = 1,
+        DEFAULT_MAX_RESAMPLE_THREADS  = 0,
+        DEFAULT_MAX_ENCODER_THREADS   = 0
+    };
+
+    enum
+    {
+        DEFAULT_SNAPSHOT_IDLE_TIMEOUT = 5000
+    };
+
+    enum
+    {
+        DEFAULT_NUM_QUALITY_TIERS  = 1,
+        DEFAULT_ADAPTIVE_HOLD_TIME = 2000
+    };
+
+    static const float DEFAULT_DOWNGRADE_UTILIZATION;
+    static const float DEFAULT_UPGRADE_UTILIZATION;
+
     static const std::string DEFAULT_VIDEO_ROUTE;
     static const std::string DEFAULT_BOUNDARY_MARKER;
+    static const std::string DEFAULT_SNAPSHOT_PATH;
+    static const std::string DEFAULT_STREAM_PATH_PREFIX;
     static const Poco::Net::MediaType DEFAULT_MEDIA_TYPE;
 
 private:
@@ -143,14 +276,354 @@ private:
     std::size_t _maxClientQueueSize;
     std::size_t _maxStreamWidth;
     std::size_t _maxStreamHeight;
-    
+
+    bool _skipUnchangedFrames;
+    std::size_t _frameHashRowStride;
+    std::size_t _maxResampleThreads;
+
+    std::string _snapshotPath;
+    uint64_t _snapshotIdleTimeout;
+    std::string _streamPathPrefix;
+
+    std::size_t _numQualityTiers;
+    uint64_t _adaptiveHoldTime;
+    float _downgradeUtilization;
+    float _upgradeUtilization;
+
+    bool _useParallelEncoder;
+    std::size_t _maxEncoderThreads;
+
     std::string _boundaryMarker;
     Poco::Net::MediaType _mediaType;
     
 };
 
 
+/// \brief Chooses a quality tier for a client from its observed throughput.
+///
+/// The controller compares the time needed to send each frame with the
+/// interval between live frames. Sustained pressure moves the client down a
+/// tier, sustained headroom moves it back up. Moving down reacts faster than
+/// moving up to avoid oscillating between tiers.
+class IPVideoQualityController
+{
+public:
+    /// \brief Create an IPVideoQualityController.
+    /// \param numTiers The number of available tiers.
+    /// \param holdTime The time in milliseconds a condition must be sustained
+    ///        before moving up a tier.
+    /// \param downgradeUtilization The utilization that triggers a downgrade.
+    /// \param upgradeUtilization The predicted utilization that allows an
+    ///        upgrade.
+    IPVideoQualityController(std::size_t numTiers = 1,
+                             uint64_t holdTime = IPVideoRouteSettings::DEFAULT_ADAPTIVE_HOLD_TIME,
+                             float downgradeUtilization = IPVideoRouteSettings::DEFAULT_DOWNGRADE_UTILIZATION,
+                             float upgradeUtilization = IPVideoRouteSettings::DEFAULT_UPGRADE_UTILIZATION);
+
+    /// \brief Destroy the IPVideoQualityController.
+    virtual ~IPVideoQualityController();
+
+    /// \brief Update the controller with the cost of the last frame sent.
+    /// \param now The current time in milliseconds.
+    /// \param sendDuration The time in milliseconds needed to send the frame.
+    /// \param frameInterval The interval in milliseconds between live frames.
+    /// \param backlog The number of frames still waiting to be sent.
+    /// \returns true iff the tier changed.
+    bool update(uint64_t now,
+                uint64_t sendDuration,
+                uint64_t frameInterval,
+                std::size_t backlog);
+
+    /// \returns the current tier, where 0 is the highest quality.
+    std::size_t tier() const;
+
+    /// \returns the smoothed link utilization.
+    float utilization() const;
+
+    enum
+    {
+        /// \brief The approximate cost of a tier relative to the next lower tier.
+        TIER_COST_FACTOR = 4
+    };
+
+private:
+    std::size_t _numTiers;
+    uint64_t _holdTime;
+    float _downgradeUtilization;
+    float _upgradeUtilization;
+
+    std::size_t _tier = 0;
+    float _utilization = 0;
+    uint64_t _pressureSince = 0;
+    uint64_t _headroomSince = 0;
+
+};
+
+
 class IPVideoConnection;
+class IPVideoStream;
+
+
+/// \brief An interface for receiving a stream's newly encoded frames.
+///
+/// Listeners receive the first quality tier and are notified once per newly
+/// encoded frame. Unchanged frames that reuse the last encoded frame are not
+/// repeated.
+class AbstractIPVideoFrameListener
+{
+public:
+    /// \brief Destroy the AbstractIPVideoFrameListener.
+    virtual ~AbstractIPVideoFrameListener()
+    {
+    }
+
+    /// \brief Called on the sending thread when a new frame is encoded.
+    ///
+    /// The stream's clients have already received the frame, and the stream
+    /// is not locked. Frames are delivered in order, so a slow listener
+    /// delays the stream's next frame. Implementations must not add or
+    /// remove listeners.
+    ///
+    /// \param stream The stream that encoded the frame.
+    /// \param frame The encoded frame, shared with all other clients.
+    /// \param sequence The stream's sequence number for the frame.
+    virtual void frameEncoded(const IPVideoStream& stream,
+                              std::shared_ptr<IPVideoFrame> frame,
+                              uint64_t sequence) = 0;
+
+    /// \returns true iff the listener currently wants frames to be encoded.
+    virtual bool isListening() const = 0;
+
+};
+
+
+/// \brief A single named video stream served by an IPVideoRoute.
+///
+/// Each stream keeps its own encoder state, connections and statistics.
+class IPVideoStream
+{
+public:
+    /// \brief Create an IPVideoStream.
+    /// \param name The name of the stream.
+    /// \param instanceId A value that distinguishes the stream's entity tags
+    ///        across route instances and restarts.
+    /// \param workerPool The pool that resamples and encodes frames in
+    ///        parallel, or nullptr to use the default pool.
+    /// \param routeConnections The route's connection count, which the
+    ///        stream keeps up to date, or nullptr.
+    IPVideoStream(const std::string& name,
+                  uint64_t instanceId,
+                  std::shared_ptr<IPVideoWorkerPool> workerPool = nullptr,
+                  std::shared_ptr<std::atomic<std::size_t>> routeConnections = nullptr);
+
+    /// \brief Destroy the IPVideoStream.
+    virtual ~IPVideoStream();
+
+    /// \returns the name of the stream.
+    const std::string& name() const;
+
+    /// \brief Encode and queue the pixels for the stream's clients.
+    ///
+    /// If no clients are connected and no snapshots were recently requested,
+    /// the pixels are not encoded.
+    ///
+    /// \param pix The pixels to send.
+    /// \param settings The route settings used to encode the pixels.
+    void send(const ofPixels& pix, const IPVideoRouteSettings& settings);
+
+    /// \brief Queue shared pixels to be encoded on the stream's encoder thread.
+    ///
+    /// The pixels are not copied. The stream holds a reference until they are
+    /// encoded, or until newer pixels replace them before encoding starts.
+    /// The caller must not modify the pixels while they are referenced.
+    ///
+    /// \param pix The pixels to send.
+    /// \param settings An immutable snapshot of the route settings used to
+    ///        encode the pixels.
+    void send(std::shared_ptr<const ofPixels> pix,
+              std::shared_ptr<const IPVideoRouteSettings> settings);
+
+    /// \brief Stop the encoder thread, discarding any queued pixels.
+    void stopEncoder();
+
+    /// \returns the number of clients connected to this stream.
+    std::size_t numConnections() const;
+
+    /// \brief Determine if the stream can be removed.
+    /// \param timeout The time in milliseconds without frames, clients or
+    ///        listeners after which the stream is idle.
+    /// \returns true iff nobody has published to or watched the stream
+    ///          within the timeout.
+    bool isIdle(uint64_t timeout) const;
+
+    /// \returns the most recently encoded frame or nullptr if none exists.
+    std::shared_ptr<IPVideoFrame> snapshot() const;
+
+    /// \returns the smoothed interval between sent frames in milliseconds.
+    uint64_t frameInterval() const;
+
+    /// \returns the number of frames encoded for this stream.
+    uint64_t framesEncoded() const;
+
+    /// \returns the number of unchanged frames that reused an encoded frame.
+    uint64_t framesReused() const;
+
+    /// \returns the total number of encoded bytes for this stream.
+    uint64_t bytesEncoded() const;
+
+    /// \brief Discard the cached frame, e.g. when the settings change.
+    void reset();
+
+    /// \brief Stop all of the stream's connections.
+    void stop();
+
+    /// \brief Add a listener for newly encoded frames.
+    ///
+    /// A listening listener counts as an audience, so frames are encoded even
+    /// if no MJPEG clients are connected.
+    ///
+    /// \param listener The listener to add. The caller retains ownership and
+    ///        must remove the listener before it is destroyed.
+    void addListener(AbstractIPVideoFrameListener* listener);
+
+    /// \brief Remove a listener for newly encoded frames.
+    ///
+    /// Waits for a notification in progress, so the listener may be
+    /// destroyed once this returns.
+    ///
+    /// \param listener The listener to remove.
+    void removeListener(AbstractIPVideoFrameListener* listener);
+
+protected:
+    /// \brief Encode the pixels into a new frame.
+    /// \param pix The pixels to encode.
+    /// \param frameSettings The frame settings to use.
+    /// \param settings The route settings.
+    /// \returns the encoded frame.
+    std::shared_ptr<IPVideoFrame> encode(const ofPixels& pix,
+                                         const IPVideoFrameSettings& frameSettings,
+                                         const IPVideoRouteSettings& settings);
+
+    /// \brief Record a snapshot request and get the latest frame.
+    ///
+    /// The encoder stops when nobody is watching, so the latest frame may no
+    /// longer match the source. Such a frame is not returned, and the
+    /// recorded request restarts the encoder for the next request.
+    ///
+    /// \param etag The latest frame's entity tag.
+    /// \param maxAge The maximum time in milliseconds since the source pixels
+    ///        of the latest frame were sent.
+    /// \returns the latest frame or nullptr if none exists or it is too old.
+    std::shared_ptr<IPVideoFrame> requestSnapshot(std::string& etag,
+                                                  uint64_t maxAge);
+
+    void addConnection(IPVideoConnection* handler);
+
+    void removeConnection(IPVideoConnection* handler);
+
+    typedef std::vector<IPVideoConnection*> Connections;
+
+    typedef std::vector<AbstractIPVideoFrameListener*> Listeners;
+
+    /// \brief The name of the stream.
+    const std::string _name;
+
+    /// \brief Distinguishes entity tags across route instances and restarts.
+    const uint64_t _instanceId;
+
+    Connections _connections;
+
+    /// \brief The listeners for newly encoded frames.
+    Listeners _listeners;
+
+    /// \brief The mutex protecting the listeners.
+    ///
+    /// Held while listeners are notified. When both are held, it is locked
+    /// after the stream's mutex.
+    mutable std::mutex _listenerMutex;
+
+    /// \brief The last encoded frame, reused if the pixels are unchanged.
+    std::shared_ptr<IPVideoFrame> _lastFrame;
+
+    /// \brief The content hash of the pixels used for the last frame.
+    uint64_t _lastFrameHash = 0;
+
+    /// \brief The entity tag of the last encoded frame.
+    std::string _lastFrameETag;
+
+    /// \brief The time the last frame's pixels were sent in milliseconds.
+    ///
+    /// A reused frame is as fresh as the pixels it was reused for.
+    uint64_t _lastFrameTime = 0;
+
+    /// \brief The number of frames encoded for the first tier.
+    uint64_t _frameSequence = 0;
+
+    /// \brief The time of the last snapshot request in milliseconds.
+    uint64_t _lastSnapshotRequest = 0;
+
+    /// \brief The time of the last call to send() in milliseconds.
+    uint64_t _lastSendTime = 0;
+
+    /// \brief The time the stream was last created, sent to or watched.
+    uint64_t _lastActiveTime = 0;
+
+    /// \brief The route's connection count.
+    std::shared_ptr<std::atomic<std::size_t>> _routeConnections;
+
+    /// \brief The smoothed interval between calls to send() in milliseconds.
+    uint64_t _frameInterval = 0;
+
+    /// \brief The number of frames encoded.
+    uint64_t _framesEncoded = 0;
+
+    /// \brief The number of unchanged frames that reused an encoded frame.
+    uint64_t _framesReused = 0;
+
+    /// \brief The total number of encoded bytes.
+    uint64_t _bytesEncoded = 0;
+
+    /// \brief The reusable encoder input pixels.
+    ofPixels _encoderPixels;
+
+    /// \brief The mutex protecting the encoder input pixels.
+    std::mutex _encoderMutex;
+
+    /// \brief The pool that splits a frame's work across threads.
+    std::shared_ptr<IPVideoWorkerPool> _workerPool;
+
+    /// \brief Encode queued shared pixels until stopped.
+    /// \param generation The encoder generation the thread belongs to.
+    void encodePending(uint64_t generation);
+
+    /// \brief The shared pixels waiting to be encoded.
+    std::shared_ptr<const ofPixels> _pendingPixels;
+
+    /// \brief The settings for the pending pixels.
+    std::shared_ptr<const IPVideoRouteSettings> _pendingSettings;
+
+    /// \brief True while an encoder thread of the current generation runs.
+    bool _isEncoderRunning = false;
+
+    /// \brief Incremented by stopEncoder(), which stops older threads.
+    uint64_t _encoderGeneration = 0;
+
+    /// \brief The encoder thread for shared pixels, started on first use.
+    std::thread _encoderThread;
+
+    /// \brief Signals the encoder thread.
+    std::condition_variable _pendingCondition;
+
+    /// \brief The mutex protecting the pending pixels.
+    std::mutex _pendingMutex;
+
+    mutable std::mutex _mutex;
+
+    friend class IPVideoConnection;
+    friend class IPVideoSnapshotHandler;
+    friend class IPVideoRoute;
+
+};
 
 
 class IPVideoRoute: public BaseRoute_<IPVideoRouteSettings>
@@ -162,22 +635,183 @@ public:
     
     virtual ~IPVideoRoute();
 
+    bool canHandleRequest(const Poco::Net::HTTPServerRequest& request,
+                          bool isSecurePort) const override;
+
     Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest& request) override;
 
+    void setup(const Settings& settings) override;
+
+    /// \brief Encode and queue the pixels for the default stream.
+    /// \param pix The pixels to send.
     void send(const ofPixels& pix) const;
 
+    /// \brief Encode and queue the pixels for a named stream.
+    ///
+    /// The stream is created if it does not exist yet. Clients select the
+    /// stream by requesting the stream path prefix followed by its name.
+    ///
+    /// \param streamName The name of the stream.
+    /// \param pix The pixels to send.
+    void send(const std::string& streamName, const ofPixels& pix) const;
+
+    /// \brief Queue shared pixels for the default stream without copying.
+    ///
+    /// The pixels are encoded on the stream's encoder thread, and the
+    /// reference is released once they are encoded. If newer pixels arrive
+    /// first, the older pixels are released without being encoded. Pixels
+    /// from an IPVideoPixelPool return to the pool when released.
+    ///
+    /// \param pix The pixels to send. They must not be modified while
+    ///        referenced.
+    void send(std::shared_ptr<const ofPixels> pix) const;
+
+    /// \brief Queue shared pixels for a named stream without copying.
+    /// \param streamName The name of the stream.
+    /// \param pix The pixels to send. They must not be modified while
+    ///        referenced.
+    void send(const std::string& streamName,
+              std::shared_ptr<const ofPixels> pix) const;
+
+    /// \returns the number of clients connected to all streams.
     std::size_t numConnections() const;
 
+    /// \returns the number of clients connected to the named stream.
+    std::size_t numConnections(const std::string& streamName) const;
+
+    /// \returns the default stream's most recently encoded frame or nullptr.
+    std::shared_ptr<IPVideoFrame> snapshot() const;
+
+    /// \returns the named stream's most recently encoded frame or nullptr.
+    std::shared_ptr<IPVideoFrame> snapshot(const std::string& streamName) const;
+
+    /// \returns the named stream or nullptr if it does not exist.
+    std::shared_ptr<IPVideoStream> stream(const std::string& streamName) const;
+
+    /// \returns the names of all streams.
+    std::vector<std::string> streamNames() const;
+
+    /// \returns the named stream, creating it if needed.
+    std::shared_ptr<IPVideoStream> findOrCreateStream(const std::string& streamName) const;
+
     virtual void stop() override;
 
-protected:
-    void addConnection(IPVideoConnection* handler);
+    /// \brief Calculate a cheap content hash of the given pixels.
+    /// \param pix The pixels to hash.
+    /// \param rowStride Hash every Nth row. 1 hashes every row.
+    /// \returns a 64 bit hash of the sampled pixels and their dimensions.
+    static uint64_t hash(const ofPixels& pix, std::size_t rowStride = 1);
+
+    /// \brief Render the multipart header that precedes each JPEG part.
+    /// \param boundaryMarker The multipart boundary marker.
+    /// \param contentLength The size of the JPEG in bytes.
+    /// \returns the rendered header.
+    static std::string multipartHeader(const std::string& boundaryMarker,
+                                       std::size_t contentLength);
+
+    /// \brief Get the frame settings for a quality tier.
+    /// \param frameSettings The frame settings of the first tier.
+    /// \param tier The quality tier.
+    /// \param pix The source pixels.
+    /// \returns the frame settings for the tier.
+    static IPVideoFrameSettings tierFrameSettings(const IPVideoFrameSettings& frameSettings,
+                                                  std::size_t tier,
+                                                  const ofPixels& pix);
+
+    /// \brief Resample, flip and convert pixels in a single pass.
+    ///
+    /// Each source pixel is read at most once and written directly to the
+    /// destination using nearest neighbor sampling. RGBA and BGRA pixels are
+    /// converted to RGB and BGR respectively, as required by the JPEG
+    /// encoder. The work is split into horizontal bands of rows.
+    ///
+    /// \param src The source pixels.
+    /// \param dst The destination pixels, reallocated only if needed.
+    /// \param width The destination width.
+    /// \param height The destination height.
+    /// \param flipHorizontal True if the pixels should be mirrored horizontally.
+    /// \param flipVertical True if the pixels should be mirrored vertically.
+    /// \param maxThreads The maximum number of threads. 0 will use the number
+    ///        of available hardware threads.
+    /// \param workerPool The pool that resamples the bands, or nullptr to use
+    ///        the default pool.
+    /// \returns false if the source pixel format is not supported.
+    static bool resample(const ofPixels& src,
+                         ofPixels& dst,
+                         std::size_t width,
+                         std::size_t height,
+                         bool flipHorizontal,
+                         bool flipVertical,
+                         std::size_t maxThreads = 0,
+                         IPVideoWorkerPool* workerPool = nullptr);
 
-    void removeConnection(IPVideoConnection* handler);
-    
-    typedef std::vector<IPVideoConnection*> Connections;
+    enum
+    {
+        /// \brief The minimum number of rows in a resampling band.
+        MIN_RESAMPLE_BAND_ROWS = 64
+    };
 
-    Connections _connections;
+    /// \brief The name of the default stream.
+    static const std::string DEFAULT_STREAM_NAME;
+
+    /// \brief The file name that selects a named stream's snapshot.
+    static const std::string SNAPSHOT_FILE_NAME;
+
+protected:
+    /// \brief Find the stream and request type targeted by a request.
+    /// \param request The request to parse.
+    /// \param streamName The name of the requested stream.
+    /// \param isSnapshot True if a snapshot was requested.
+    /// \returns true iff the request targets a stream path or snapshot path.
+    bool parseRequest(const Poco::Net::HTTPServerRequest& request,
+                      std::string& streamName,
+                      bool& isSnapshot) const;
+
+    /// \brief Add a connection to a stream.
+    ///
+    /// If the stream was removed while idle, it is restored, or the stream
+    /// that replaced it is used instead.
+    ///
+    /// \param stream The requested stream.
+    /// \param connection The connection to add.
+    /// \returns the stream the connection was added to.
+    std::shared_ptr<IPVideoStream> addConnection(std::shared_ptr<IPVideoStream> stream,
+                                                 IPVideoConnection* connection);
+
+    /// \brief Remove a connection from a stream and remove idle streams.
+    /// \param stream The stream the connection was added to.
+    /// \param connection The connection to remove.
+    void removeConnection(std::shared_ptr<IPVideoStream> stream,
+                          IPVideoConnection* connection);
+
+    /// \brief Remove the streams that nobody publishes to or watches.
+    ///
+    /// The default stream is never removed. Must be called with the mutex
+    /// locked. The removed streams should be released after unlocking, as
+    /// releasing a stream joins its encoder thread.
+    ///
+    /// \param removed The removed streams.
+    void removeIdleStreams(std::vector<std::shared_ptr<IPVideoStream>>& removed) const;
+
+    typedef std::unordered_map<std::string, std::shared_ptr<IPVideoStream>> Streams;
+
+    /// \brief The streams, indexed by name.
+    mutable Streams _streams;
+
+    /// \brief The number of clients connected to all streams.
+    std::shared_ptr<std::atomic<std::size_t>> _numConnections;
+
+    /// \brief Distinguishes entity tags across route instances and restarts.
+    const uint64_t _instanceId;
+
+    /// \brief The worker threads shared by all streams.
+    std::shared_ptr<IPVideoWorkerPool> _workerPool;
+
+    /// \brief A copy of the settings for the encoder threads.
+    ///
+    /// setup() replaces the copy rather than modifying it, so an encoder
+    /// thread can keep using the settings it was given.
+    std::shared_ptr<const IPVideoRouteSettings> _sharedSettings;
 
     mutable std::mutex _mutex;
 
@@ -186,6 +820,30 @@ protected:
 };
 
 
+/// \brief Serves the most recently encoded frame as a single image.
+///
+/// Supports conditional requests using the If-None-Match header.
+class IPVideoSnapshotHandler: public BaseRouteHandler_<IPVideoRoute>
+{
+public:
+    /// \brief Create an IPVideoSnapshotHandler.
+    /// \param route The parent route.
+    /// \param stream The requested stream or nullptr if it does not exist.
+    IPVideoSnapshotHandler(IPVideoRoute& route,
+                           std::shared_ptr<IPVideoStream> stream);
+
+    /// \brief Destroy the IPVideoSnapshotHandler.
+    virtual ~IPVideoSnapshotHandler();
+
+    void handleRequest(ServerEventArgs& evt) override;
+
+protected:
+    /// \brief The requested stream.
+    std::shared_ptr<IPVideoStream> _stream;
+
+};
+
+
 /// \brief The IPVideo route handler.
 class IPVideoConnection:
     public BaseRouteHandler_<IPVideoRoute>,
@@ -194,7 +852,9 @@ class IPVideoConnection:
 public:
     /// \brief Create an IPVideoConnection.
     /// \param route The parent route.
-    IPVideoConnection(IPVideoRoute& route);
+    /// \param stream The requested stream or nullptr if it does not exist.
+    IPVideoConnection(IPVideoRoute& route,
+                      std::shared_ptr<IPVideoStream> stream);
 
     /// \brief Destroy the IPVideoConnection.
     virtual ~IPVideoConnection();
@@ -215,7 +875,35 @@ public:
     /// \returns the frame settings.
     IPVideoFrameSettings frameSettings() const;
 
+    /// \returns the quality tier currently assigned to this client.
+    std::size_t tier() const;
+
+    /// \brief Write a frame's header and buffer directly to the socket.
+    ///
+    /// On non-secure sockets the header and buffer are written with a single
+    /// vectored write.
+    ///
+    /// \param socket The client socket.
+    /// \param frame The frame to send.
+    /// \returns the number of bytes sent.
+    /// \throws Poco::IOException if the frame could not be written.
+    static std::size_t sendFrame(Poco::Net::StreamSocket& socket,
+                                 const IPVideoFrame& frame);
+
 protected:
+
+    /// \brief Write all bytes to the socket, retrying partial writes.
+    /// \param socket The client socket.
+    /// \param data The data to send.
+    /// \param size The number of bytes to send.
+    /// \throws Poco::IOException if the bytes could not be written.
+    static void sendBytes(Poco::Net::StreamSocket& socket,
+                          const char* data,
+                          std::size_t size);
+
+    /// \brief The stream this client is connected to.
+    std::shared_ptr<IPVideoStream> _stream;
+
     /// \brief The frame settings for this handler.
     IPVideoFrameSettings _frameSettings;
 
@@ -243,6 +931,12 @@ protected:
     /// \brief The time the next frame should be sent.
     uint64_t _nextScheduledFrame = 0;
 
+    /// \brief Chooses the quality tier from the observed throughput.
+    IPVideoQualityController _qualityController;
+
+    /// \brief The quality tier, readable without locking.
+    std::atomic<std::size_t> _tier;
+
     /// \brief The mutex for protecting data.
     mutable std::mutex _mutex;
 
@@ -0,0 +1,186 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofFileUtils.h"
+#include "Poco/Net/StreamSocket.h"
+#include "ofPixels.h"
+#include "ofx/HTTP/BaseResponse.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Consumes an MJPEG stream and exposes its latest decoded frame.
+///
+/// The multipart/x-mixed-replace response is parsed incrementally. Each JPEG
+/// part is handed to a pool of decoder threads that decode into recycled
+/// ofPixels. Decoding may finish out of order, so only frames newer than the
+/// latest frame are published. If the decoders fall behind, the oldest
+/// undecoded parts are dropped so that the latest frame stays current.
+///
+/// The reader can consume a response directly with read() or, with start(),
+/// connect to a URI on its own thread and reconnect when the stream ends.
+class IPVideoStreamReader
+{
+public:
+    /// \brief Create an IPVideoStreamReader.
+    /// \param numDecoderThreads The number of decoder threads. 0 will use the
+    ///        number of available hardware threads.
+    IPVideoStreamReader(std::size_t numDecoderThreads = DEFAULT_NUM_DECODER_THREADS);
+
+    /// \brief Destroy the IPVideoStreamReader.
+    virtual ~IPVideoStreamReader();
+
+    /// \brief Connect to an MJPEG stream on a background thread.
+    ///
+    /// The reader reconnects after the stream ends or fails until stop() is
+    /// called.
+    ///
+    /// \param uri The stream URI, e.g. http://127.0.0.1:7890/ipvideo.
+    void start(const std::string& uri);
+
+    /// \brief Stop reading.
+    ///
+    /// The connection opened by start() is shut down, so its thread stops
+    /// without waiting for the next part. A connection attempt in progress
+    /// is not interrupted and may delay stop() until it completes or times
+    /// out. Blocking reads started by read() return once the current part
+    /// has been read.
+    void stop();
+
+    /// \returns true iff the reader is reading.
+    bool isRunning() const;
+
+    /// \brief Read parts from a response on the calling thread.
+    /// \param response The multipart/x-mixed-replace response.
+    /// \returns the number of parts read before the stream ended.
+    /// \throws Poco::DataFormatException if the response is not multipart.
+    std::size_t read(BaseResponse& response);
+
+    /// \brief Read parts from a multipart stream on the calling thread.
+    /// \param stream The response stream.
+    /// \param boundary The multipart boundary.
+    /// \returns the number of parts read before the stream ended.
+    std::size_t read(std::istream& stream, const std::string& boundary);
+
+    /// \brief Get the latest decoded frame.
+    ///
+    /// The returned pixels are not modified while they are held. They are
+    /// recycled for decoding once they are released.
+    ///
+    /// \returns the latest frame or nullptr if none has been decoded.
+    std::shared_ptr<const ofPixels> latestFrame() const;
+
+    /// \returns the sequence number of the latest frame, 0 if none.
+    uint64_t latestSequence() const;
+
+    /// \returns the number of parts received.
+    uint64_t framesReceived() const;
+
+    /// \returns the number of frames decoded and published.
+    uint64_t framesDecoded() const;
+
+    /// \returns the number of frames dropped before or after decoding.
+    uint64_t framesDropped() const;
+
+    enum
+    {
+        /// \brief The default number of decoder threads.
+        DEFAULT_NUM_DECODER_THREADS = 2,
+        /// \brief The delay in milliseconds before reconnecting.
+        RECONNECT_DELAY = 1000
+    };
+
+protected:
+    /// \brief A received JPEG waiting to be decoded.
+    struct Part
+    {
+        /// \brief The order in which the part was received.
+        uint64_t sequence = 0;
+
+        /// \brief The encoded JPEG.
+        std::shared_ptr<ofBuffer> buffer;
+    };
+
+    /// \brief Connect and read until stopped.
+    /// \param uri The stream URI.
+    void receive(const std::string& uri);
+
+    /// \brief Decode parts until destroyed.
+    void decode();
+
+    /// \returns a buffer that is not in use, allocating one if needed.
+    std::shared_ptr<ofBuffer> acquireBuffer();
+
+    /// \returns pixels that are not in use, allocating them if needed.
+    std::shared_ptr<ofPixels> acquirePixels();
+
+    /// \brief The parts waiting to be decoded.
+    std::deque<Part> _parts;
+
+    /// \brief The socket of the connection opened by start(), if connected.
+    std::unique_ptr<Poco::Net::StreamSocket> _socket;
+
+    /// \brief The maximum number of parts waiting to be decoded.
+    std::size_t _maxPendingParts = 1;
+
+    /// \brief Every buffer ever allocated, recycled when no longer in use.
+    std::vector<std::shared_ptr<ofBuffer>> _bufferPool;
+
+    /// \brief Every pixels ever allocated, recycled when no longer in use.
+    std::vector<std::shared_ptr<ofPixels>> _pixelPool;
+
+    /// \brief The latest decoded frame.
+    std::shared_ptr<ofPixels> _latestFrame;
+
+    /// \brief The sequence number of the latest decoded frame.
+    uint64_t _latestSequence = 0;
+
+    /// \brief The number of parts received.
+    uint64_t _framesReceived = 0;
+
+    /// \brief The number of frames decoded and published.
+    uint64_t _framesDecoded = 0;
+
+    /// \brief The number of frames dropped.
+    uint64_t _framesDropped = 0;
+
+    /// \brief True while reading.
+    bool _isRunning = false;
+
+    /// \brief The number of calls to stop(), used to end blocking reads.
+    uint64_t _stopCount = 0;
+
+    /// \brief True while the decoder threads should run.
+    bool _isDecoding = true;
+
+    /// \brief The thread started by start().
+    std::thread _receiver;
+
+    /// \brief The decoder threads.
+    std::vector<std::thread> _decoders;
+
+    /// \brief Signals the decoder threads.
+    std::condition_variable _condition;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ofx/HTTP/IPVideoRoute.h"
+#include "ofx/HTTP/WebSocketEvents.h"
+#include "ofx/HTTP/WebSocketFrame.h"
+#include "ofx/HTTP/WebSocketRoute.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief Pushes an IPVideoStream's encoded frames to WebSocket clients.
+///
+/// Every client of the WebSocketRoute receives each new frame of the stream
+/// as a single binary WebSocket frame. The JPEG is the same buffer that is
+/// served to MJPEG clients and is never re-encoded. Each frame begins with a
+/// HEADER_SIZE byte header. All integers are big-endian.
+///
+///     Offset  Size  Field
+///     0       4     Magic, "IPVF".
+///     4       1     Version, currently 1.
+///     5       1     Header size in bytes.
+///     6       2     Reserved, 0.
+///     8       8     Frame sequence number.
+///     16      8     Encode time in milliseconds since the Unix epoch.
+///     24      4     Width in pixels.
+///     28      4     Height in pixels.
+///     32      ...   JPEG data.
+///
+/// Clients acknowledge each displayed frame by sending the text frame
+/// "ack <sequence>". An acknowledgement also acknowledges all earlier frames.
+/// Flow control is credit based: at most maxFramesInFlight unacknowledged
+/// frames are sent to a client, and newer frames are dropped for that client
+/// until it catches up. The time from encoding a frame to receiving its
+/// acknowledgement is reported as the end-to-end latency.
+///
+/// A frame that is not acknowledged within FRAME_TIMEOUT_LATENCY_FACTOR
+/// times the latency, and at least MINIMUM_FRAME_TIMEOUT milliseconds,
+/// expires and returns its credit. Frames that a slow connection discards
+/// before sending them are never acknowledged, so without the timeout they
+/// would stall the viewer for good.
+///
+/// The bridge treats every client of the WebSocketRoute as a viewer, so the
+/// route should be dedicated to the bridge.
+class IPVideoWebSocketBridge: public AbstractIPVideoFrameListener
+{
+public:
+    /// \brief Create an IPVideoWebSocketBridge.
+    /// \param videoRoute The route that encodes the stream.
+    /// \param webSocketRoute The route that the viewers connect to. The
+    ///        bridge must be destroyed before the routes.
+    /// \param streamName The name of the stream to forward.
+    /// \param maxFramesInFlight The maximum number of unacknowledged frames
+    ///        per client.
+    IPVideoWebSocketBridge(IPVideoRoute& videoRoute,
+                           WebSocketRoute& webSocketRoute,
+                           const std::string& streamName = IPVideoRoute::DEFAULT_STREAM_NAME,
+                           std::size_t maxFramesInFlight = DEFAULT_MAX_FRAMES_IN_FLIGHT);
+
+    /// \brief Destroy the IPVideoWebSocketBridge.
+    virtual ~IPVideoWebSocketBridge();
+
+    void frameEncoded(const IPVideoStream& stream,
+                      std::shared_ptr<IPVideoFrame> frame,
+                      uint64_t sequence) override;
+
+    bool isListening() const override;
+
+    void onWebSocketOpenEvent(WebSocketOpenEventArgs& evt);
+    void onWebSocketCloseEvent(WebSocketCloseEventArgs& evt);
+    void onWebSocketFrameReceivedEvent(WebSocketFrameEventArgs& evt);
+    void onWebSocketFrameSentEvent(WebSocketFrameEventArgs& evt);
+    void onWebSocketErrorEvent(WebSocketErrorEventArgs& evt);
+
+    /// \returns the number of connected viewers.
+    std::size_t numClients() const;
+
+    /// \returns the number of frames sent to all viewers.
+    uint64_t framesSent() const;
+
+    /// \returns the number of frames dropped because viewers had no credit.
+    uint64_t framesDropped() const;
+
+    /// \returns the number of frames that expired before they were
+    ///          acknowledged.
+    uint64_t framesExpired() const;
+
+    /// \returns the smoothed time in milliseconds from encoding a frame to
+    ///          receiving its acknowledgement.
+    uint64_t latency() const;
+
+    /// \brief Write a frame header.
+    /// \param sequence The frame sequence number.
+    /// \param timestamp The encode time in milliseconds since the Unix epoch.
+    /// \param width The frame width in pixels.
+    /// \param height The frame height in pixels.
+    /// \returns the HEADER_SIZE byte header.
+    static std::string makeHeader(uint64_t sequence,
+                                  uint64_t timestamp,
+                                  uint32_t width,
+                                  uint32_t height);
+
+    enum
+    {
+        /// \brief The size of the frame header in bytes.
+        HEADER_SIZE = 32,
+        /// \brief The frame header version.
+        HEADER_VERSION = 1,
+        /// \brief The default maximum number of unacknowledged frames.
+        DEFAULT_MAX_FRAMES_IN_FLIGHT = 2,
+        /// \brief The multiple of the latency after which a frame expires.
+        FRAME_TIMEOUT_LATENCY_FACTOR = 4,
+        /// \brief The minimum time in milliseconds before a frame expires.
+        MINIMUM_FRAME_TIMEOUT = 1000
+    };
+
+    /// \brief The magic bytes that begin each frame header.
+    static const std::string HEADER_MAGIC;
+
+    /// \brief The command that begins each acknowledgement.
+    static const std::string ACK_COMMAND;
+
+protected:
+    /// \brief Stop tracking a viewer.
+    /// \param connection The viewer's connection.
+    void removeClient(const WebSocketConnection* connection);
+
+    /// \brief The state of a single viewer.
+    struct Client
+    {
+        /// \brief The sequence numbers and encode times of unacknowledged frames.
+        std::deque<std::pair<uint64_t, uint64_t>> framesInFlight;
+    };
+
+    typedef std::map<const WebSocketConnection*, Client> Clients;
+
+    /// \returns the time in milliseconds after which an unacknowledged
+    ///          frame expires. The caller must hold the lock.
+    uint64_t frameTimeout() const;
+
+    /// \brief Return the credit of a viewer's expired frames.
+    ///
+    /// The caller must hold the lock.
+    ///
+    /// \param client The viewer.
+    /// \param now The current time in milliseconds.
+    void expireFramesInFlight(Client& client, uint64_t now);
+
+    /// \brief The route that the viewers connect to.
+    WebSocketRoute& _webSocketRoute;
+
+    /// \brief The stream being forwarded.
+    std::shared_ptr<IPVideoStream> _stream;
+
+    /// \brief The maximum number of unacknowledged frames per client.
+    const std::size_t _maxFramesInFlight;
+
+    /// \brief The connected viewers.
+    Clients _clients;
+
+    /// \brief The number of frames sent to all viewers.
+    uint64_t _framesSent = 0;
+
+    /// \brief The number of frames dropped for lack of credit.
+    uint64_t _framesDropped = 0;
+
+    /// \brief The number of frames that expired before they were
+    ///        acknowledged.
+    uint64_t _framesExpired = 0;
+
+    /// \brief The smoothed acknowledgement latency in milliseconds.
+    uint64_t _latency = 0;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief A fixed set of worker threads that run batches of indexed jobs.
+///
+/// The threads are started once and reused, so splitting each frame into
+/// bands costs a wake up rather than a thread creation per band. The calling
+/// thread also runs jobs from its own batch, so a batch always completes even
+/// if every worker is busy with batches from other streams.
+class IPVideoWorkerPool
+{
+public:
+    /// \brief Create an IPVideoWorkerPool.
+    /// \param numThreads The number of worker threads. 0 will use one less
+    ///        than the number of available hardware threads, as the calling
+    ///        thread also runs jobs.
+    IPVideoWorkerPool(std::size_t numThreads = 0);
+
+    /// \brief Stop and join the worker threads.
+    virtual ~IPVideoWorkerPool();
+
+    /// \brief Run \p job(i) for each i in [0, numJobs) and wait for all jobs.
+    ///
+    /// \param numJobs The number of jobs.
+    /// \param job The job to run. It is called concurrently.
+    /// \throws the first exception thrown by a job, after all jobs finished.
+    void run(std::size_t numJobs, const std::function<void(std::size_t)>& job);
+
+    /// \returns the number of worker threads.
+    std::size_t numThreads() const;
+
+    /// \returns the pool shared by callers that do not provide one.
+    static IPVideoWorkerPool& defaultPool();
+
+private:
+    IPVideoWorkerPool(const IPVideoWorkerPool&);
+    IPVideoWorkerPool& operator = (const IPVideoWorkerPool&);
+
+    /// \brief A batch of jobs submitted by a single call to run().
+    struct Batch
+    {
+        /// \brief The job to run.
+        const std::function<void(std::size_t)>* job = nullptr;
+
+        /// \brief The number of jobs.
+        std::size_t numJobs = 0;
+
+        /// \brief The index of the next job to start.
+        std::size_t nextJob = 0;
+
+        /// \brief The number of finished jobs.
+        std::size_t numFinished = 0;
+
+        /// \brief The first exception thrown by a job.
+        std::exception_ptr exception;
+    };
+
+    /// \brief Start and run the next job of a batch.
+    /// \param lock A lock on the pool's mutex, released while the job runs.
+    /// \returns false if all jobs of the batch have been started.
+    bool _runNext(Batch& batch, std::unique_lock<std::mutex>& lock);
+
+    /// \brief Run jobs until the pool is destroyed.
+    void _work();
+
+    /// \brief The batches with jobs that have not been started.
+    std::deque<std::shared_ptr<Batch>> _batches;
+
+    /// \brief True while the worker threads should run.
+    bool _isRunning = true;
+
+    /// \brief The worker threads.
+    std::vector<std::thread> _threads;
+
+    /// \brief Signals the workers that a batch was submitted.
+    std::condition_variable _batchCondition;
+
+    /// \brief Signals the callers of run() that a job finished.
+    std::condition_variable _finishedCondition;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -8,6 +8,9 @@
 #pragma once
 
 
+#include <memory>
+#include <mutex>
+#include "Poco/Exception.h"
 #include "Poco/UUID.h"
 #include "Poco/Net/MediaType.h"
 #include "Poco/Net/NameValueCollection.h"
@@ -34,7 +37,26 @@ public:
                     AbstractSession& session):
         _request(request),
         _response(response),
-        _session(session)
+        _sessionState(std::make_shared<SessionState>(nullptr, &session))
+    {
+    }
+
+    /// \brief Construct the ServerEventArgs with a lazily created session.
+    ///
+    /// The session is not looked up or created until session() is first
+    /// called, so requests that never use it do not allocate a session or
+    /// receive a session cookie.
+    ///
+    /// \param request the Poco::Net::HTTPServerRequest.
+    /// \param response the Poco::Net::HTTPServerResponse.
+    /// \param sessionStore The session store, or nullptr if sessions are
+    ///        disabled.
+    ServerEventArgs(Poco::Net::HTTPServerRequest& request,
+                    Poco::Net::HTTPServerResponse& response,
+                    AbstractSessionStore* sessionStore):
+        _request(request),
+        _response(response),
+        _sessionState(std::make_shared<SessionState>(sessionStore, nullptr))
     {
     }
 
@@ -58,13 +80,67 @@ public:
     }
 
     /// \brief Get the session associated with this event.
+    ///
+    /// The first call looks up the client's session, or creates one and adds
+    /// its cookie to the response. It must therefore be made before the
+    /// response is sent if a new client is to keep its session.
+    ///
+    /// Copies of the event share the session, so it is only created once per
+    /// request.
+    ///
     /// \returns the session associated with this event.
+    /// \throws Poco::IllegalStateException if sessions are disabled.
     AbstractSession& session()
     {
-        return _session;
+        std::unique_lock<std::mutex> lock(_sessionState->mutex);
+
+        if (_sessionState->session == nullptr)
+        {
+            if (_sessionState->sessionStore == nullptr)
+            {
+                throw Poco::IllegalStateException("Sessions are disabled.");
+            }
+
+            // Holding the session keeps it valid if the store expires it.
+            _sessionState->sharedSession = _sessionState->sessionStore->getSharedSession(_request, _response);
+            _sessionState->session = _sessionState->sharedSession.get();
+        }
+
+        return *_sessionState->session;
+    }
+
+    /// \returns true iff a session is available for this event.
+    bool hasSession() const
+    {
+        std::unique_lock<std::mutex> lock(_sessionState->mutex);
+        return _sessionState->session != nullptr
+            || _sessionState->sessionStore != nullptr;
     }
 
 protected:
+    /// \brief The session of a request, shared by copies of its event.
+    struct SessionState
+    {
+        SessionState(AbstractSessionStore* _sessionStore,
+                     AbstractSession* _session):
+            sessionStore(_sessionStore),
+            session(_session)
+        {
+        }
+
+        /// \brief The store that creates the session, or nullptr.
+        AbstractSessionStore* sessionStore;
+
+        /// \brief The session, or nullptr until it is first used.
+        AbstractSession* session;
+
+        /// \brief Shares ownership of a session created by the store.
+        std::shared_ptr<AbstractSession> sharedSession;
+
+        /// \brief The mutex for the session.
+        std::mutex mutex;
+    };
+
     /// \brief A reference to the server request.
     Poco::Net::HTTPServerRequest& _request;
 
@@ -75,8 +151,54 @@ protected:
     /// is still available available.
     Poco::Net::HTTPServerResponse& _response;
 
-    /// \brief The session associated with the event.
-    AbstractSession& _session;
+    /// \brief The session state shared with copies of this event.
+    std::shared_ptr<SessionState> _sessionState;
+
+};
+
+
+/// \brief Ends a request in its session store when it goes out of scope.
+///
+/// Routes hold one while they handle a request, so the store is told that
+/// the request has completed even if the handler throws.
+class ServerRequestScope
+{
+public:
+    /// \brief Create a ServerRequestScope.
+    /// \param sessionStore The session store, or nullptr if sessions are
+    ///        disabled.
+    /// \param request the Poco::Net::HTTPServerRequest.
+    /// \param response the Poco::Net::HTTPServerResponse.
+    ServerRequestScope(AbstractSessionStore* sessionStore,
+                       Poco::Net::HTTPServerRequest& request,
+                       Poco::Net::HTTPServerResponse& response):
+        _sessionStore(sessionStore),
+        _request(request),
+        _response(response)
+    {
+    }
+
+    /// \brief End the request in the session store.
+    ~ServerRequestScope()
+    {
+        if (_sessionStore != nullptr)
+        {
+            _sessionStore->endRequest(_request, _response);
+        }
+    }
+
+private:
+    ServerRequestScope(const ServerRequestScope&) = delete;
+    ServerRequestScope& operator = (const ServerRequestScope&) = delete;
+
+    /// \brief The session store, or nullptr.
+    AbstractSessionStore* _sessionStore = nullptr;
+
+    /// \brief A reference to the server request.
+    Poco::Net::HTTPServerRequest& _request;
+
+    /// \brief A reference to the server response.
+    Poco::Net::HTTPServerResponse& _response;
 
 };
 
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofEvents.h"
+#include "ofx/HTTP/AbstractServerTypes.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief An event describing a session removed from a session store.
+class SessionEventArgs: public ofEventArgs
+{
+public:
+    /// \brief Create a SessionEventArgs.
+    /// \param session The removed session.
+    SessionEventArgs(AbstractSession& session): _session(session)
+    {
+    }
+
+    /// \brief Destroy the SessionEventArgs.
+    virtual ~SessionEventArgs()
+    {
+    }
+
+    /// \returns the removed session.
+    AbstractSession& session()
+    {
+        return _session;
+    }
+
+protected:
+    /// \brief The removed session.
+    AbstractSession& _session;
+
+};
+
+
+/// \brief A class describing the events of a session store.
+///
+/// The events are notified after the session has been removed from the
+/// store, outside of the store's lock, so listeners may use the store.
+class SessionStoreEvents
+{
+public:
+    /// \brief Notified when a session times out.
+    ofEvent<SessionEventArgs> onSessionExpired;
+
+    /// \brief Notified when a session is removed to make room for another.
+    ofEvent<SessionEventArgs> onSessionEvicted;
+
+};
+
+
+} } // namespace ofx::HTTP
@@ -8,11 +8,17 @@
 #pragma once
 
 
-#include <string>
+#include <atomic>
+#include <list>
 #include <map>
+#include <string>
+#include <vector>
 #include "Poco/Mutex.h"
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
 #include "ofTypes.h"
 #include "ofx/HTTP/AbstractServerTypes.h"
+#include "ofx/HTTP/SessionEvents.h"
 
 
 namespace ofx {
@@ -31,6 +37,9 @@ public:
     AbstractSession& getSession(Poco::Net::HTTPServerRequest& request,
                                 Poco::Net::HTTPServerResponse& response);
 
+    std::shared_ptr<AbstractSession> getSharedSession(Poco::Net::HTTPServerRequest& request,
+                                                      Poco::Net::HTTPServerResponse& response);
+
     void destroySession(Poco::Net::HTTPServerRequest& request,
                         Poco::Net::HTTPServerResponse& response);
 
@@ -38,10 +47,31 @@ public:
 
 protected:
     virtual bool hasSession(const std::string& sessionId) const = 0;
-    virtual AbstractSession& getSession(const std::string& sessionId) = 0;
-    virtual AbstractSession& createSession() = 0;
+    virtual AbstractSession& getSession(const std::string& sessionId);
+    virtual AbstractSession& createSession();
     virtual void destroySession(const std::string& sessionId) = 0;
 
+    /// \brief Find a live session by its session id.
+    /// \param sessionId The id of the session to find.
+    /// \returns the session, or nullptr if there is none.
+    virtual std::shared_ptr<AbstractSession> findSession(const std::string& sessionId) = 0;
+
+    /// \brief Create and store a completely new session.
+    /// \returns the new session.
+    virtual std::shared_ptr<AbstractSession> createSharedSession() = 0;
+
+    /// \brief Find a live session by its session id, or create a new one.
+    ///
+    /// The default implementation calls findSession() and then, if needed,
+    /// createSharedSession(). Stores override it to do both with a single
+    /// lookup.
+    ///
+    /// \param sessionId The id of the session to find, or empty.
+    /// \param isNew Set to true iff a new session was created.
+    /// \returns the session.
+    virtual std::shared_ptr<AbstractSession> findOrCreateSession(const std::string& sessionId,
+                                                                 bool& isNew);
+
     const std::string _sessionKeyName;
 
 private:
@@ -52,6 +82,15 @@ private:
 
 
 /// \brief An in-memory session store.
+///
+/// Sessions expire once they have been idle for the maximum idle time or
+/// have existed for the maximum lifetime. Each session's expiry time is kept
+/// in an ordered index, so expired sessions are found without scanning the
+/// whole store. Expired sessions are removed on each lookup or creation, or
+/// by calling expireSessions().
+///
+/// When the store holds the maximum number of sessions, creating a session
+/// first evicts the least recently used one.
 class SimpleSessionStore: public BaseSessionStore
 {
 public:
@@ -61,21 +100,249 @@ public:
 
     virtual ~SimpleSessionStore();
 
+    /// \brief Set the time after which an unused session expires.
+    ///
+    /// The new value applies to each session from its next use.
+    ///
+    /// \param maximumIdleTime The idle time, or 0 for no limit.
+    void setMaximumIdleTime(const Poco::Timespan& maximumIdleTime);
+
+    /// \returns the time after which an unused session expires.
+    Poco::Timespan getMaximumIdleTime() const;
+
+    /// \brief Set the time after its creation that a session expires.
+    ///
+    /// The new value applies to each session from its next use.
+    ///
+    /// \param maximumLifetime The lifetime, or 0 for no limit.
+    void setMaximumLifetime(const Poco::Timespan& maximumLifetime);
+
+    /// \returns the time after its creation that a session expires.
+    Poco::Timespan getMaximumLifetime() const;
+
+    /// \brief Set the maximum number of sessions held by the store.
+    /// \param maximumSessions The maximum number of sessions, or 0 for no
+    ///        limit.
+    void setMaximumSessions(std::size_t maximumSessions);
+
+    /// \returns the maximum number of sessions held by the store.
+    std::size_t getMaximumSessions() const;
+
+    /// \brief Remove all expired sessions.
+    void expireSessions();
+
+    /// \returns the number of sessions held by the store.
+    std::size_t getNumSessions() const;
+
+    /// \returns the number of sessions that have expired.
+    uint64_t getNumExpiredSessions() const;
+
+    /// \returns the number of sessions that have been evicted.
+    uint64_t getNumEvictedSessions() const;
+
+    /// \brief The session store events.
+    SessionStoreEvents events;
+
+    /// \brief The default maximum idle time of 30 minutes.
+    static const Poco::Timespan DEFAULT_MAXIMUM_IDLE_TIME;
+
+    /// \brief The default maximum lifetime of 24 hours.
+    static const Poco::Timespan DEFAULT_MAXIMUM_LIFETIME;
+
+    /// \brief The default maximum number of sessions.
+    static const std::size_t DEFAULT_MAXIMUM_SESSIONS;
+
 protected:
     SimpleSessionStore(const SimpleSessionStore&);
     SimpleSessionStore& operator = (const SimpleSessionStore&);
 
     bool hasSession(const std::string& sessionId) const override;
-    AbstractSession& getSession(const std::string& sessionId) override;
-    AbstractSession& createSession() override;
+    std::shared_ptr<AbstractSession> findSession(const std::string& sessionId) override;
+    std::shared_ptr<AbstractSession> createSharedSession() override;
+    std::shared_ptr<AbstractSession> findOrCreateSession(const std::string& sessionId,
+                                                         bool& isNew) override;
     void destroySession(const std::string& sessionId) override;
 
-    typedef std::map<std::string, std::shared_ptr<AbstractSession>> SessionMap;
+    /// \brief Create and store a new session with the given id.
+    /// \param sessionId The new session's unique id.
+    /// \returns the new session.
+    std::shared_ptr<AbstractSession> insertSession(const std::string& sessionId);
+
+    /// \brief Get the time against which sessions are expired.
+    ///
+    /// Tests may override this to advance time without sleeping. It is
+    /// called with the store's mutex held, so it must not use the store.
+    ///
+    /// \returns the current time.
+    virtual Poco::Timestamp currentTime() const;
+
+    /// \brief Session ids ordered by expiry time.
+    typedef std::multimap<Poco::Timestamp, std::string> ExpiryIndex;
+
+    /// \brief Session ids ordered from most to least recently used.
+    typedef std::list<std::string> RecencyList;
+
+    /// \brief A stored session.
+    struct SessionRecord
+    {
+        /// \brief The session.
+        std::shared_ptr<AbstractSession> session;
+
+        /// \brief The time the session was created.
+        Poco::Timestamp created;
+
+        /// \brief The session's expiry entry, or end() if it never expires.
+        ExpiryIndex::iterator expiry;
+
+        /// \brief The session's recency entry.
+        RecencyList::iterator recency;
+    };
+
+    typedef std::map<std::string, SessionRecord> SessionMap;
+
+    /// \brief Sessions removed from the store, waiting to be notified.
+    typedef std::vector<std::shared_ptr<AbstractSession>> SessionList;
 
     SessionMap _sessionMap;
 
+    ExpiryIndex _expiryIndex;
+
+    RecencyList _recencyList;
+
+    Poco::Timespan _maximumIdleTime;
+
+    Poco::Timespan _maximumLifetime;
+
+    std::size_t _maximumSessions;
+
+    uint64_t _numExpiredSessions = 0;
+
+    uint64_t _numEvictedSessions = 0;
+
     mutable std::mutex _mutex;
 
+private:
+    /// \brief Remove the sessions that expire at or before a time.
+    ///
+    /// The caller must hold the lock.
+    void _expire(const Poco::Timestamp& now, SessionList& expired);
+
+    /// \brief Mark a session as used and update its expiry time.
+    ///
+    /// The caller must hold the lock.
+    void _touch(SessionRecord& record, const Poco::Timestamp& now);
+
+    /// \brief Evict sessions as needed and store a new session.
+    ///
+    /// The caller must hold the lock.
+    std::shared_ptr<AbstractSession> _insert(const std::string& sessionId,
+                                             const Poco::Timestamp& now,
+                                             SessionList& evicted);
+
+    /// \brief Remove a session from the store.
+    ///
+    /// The caller must hold the lock.
+    void _erase(SessionMap::iterator iter);
+
+    /// \brief Notify listeners of removed sessions.
+    ///
+    /// The caller must not hold the lock.
+    void _notify(SessionList& expired, SessionList& evicted);
+
+};
+
+
+/// \brief An in-memory session store for servers with many worker threads.
+///
+/// Sessions are spread across a number of independent shards by a hash of
+/// their ids. Each shard is a SimpleSessionStore with its own lock, so
+/// requests for sessions in different shards never wait for each other, and
+/// a request for an existing session costs one lookup under one shard lock.
+/// Client ids are never adopted, so an unknown id simply creates a session
+/// in the shard selected by the new id.
+///
+/// The maximum number of sessions is divided evenly among the shards, so the
+/// least recently used session is evicted per shard rather than overall.
+class ShardedSessionStore: public BaseSessionStore
+{
+public:
+    /// \brief Create a ShardedSessionStore.
+    /// \param numShards The number of shards.
+    ShardedSessionStore(std::size_t numShards = DEFAULT_NUM_SHARDS);
+
+    /// \brief Create a ShardedSessionStore.
+    /// \param sessionKeyName The name of the session cookie.
+    /// \param numShards The number of shards.
+    ShardedSessionStore(const std::string& sessionKeyName,
+                        std::size_t numShards = DEFAULT_NUM_SHARDS);
+
+    virtual ~ShardedSessionStore();
+
+    /// \sa SimpleSessionStore::setMaximumIdleTime()
+    void setMaximumIdleTime(const Poco::Timespan& maximumIdleTime);
+
+    /// \returns the time after which an unused session expires.
+    Poco::Timespan getMaximumIdleTime() const;
+
+    /// \sa SimpleSessionStore::setMaximumLifetime()
+    void setMaximumLifetime(const Poco::Timespan& maximumLifetime);
+
+    /// \returns the time after its creation that a session expires.
+    Poco::Timespan getMaximumLifetime() const;
+
+    /// \brief Set the maximum number of sessions held by the store.
+    /// \param maximumSessions The maximum number of sessions, or 0 for no
+    ///        limit. It is rounded up to a multiple of the number of shards.
+    void setMaximumSessions(std::size_t maximumSessions);
+
+    /// \returns the maximum number of sessions held by the store.
+    std::size_t getMaximumSessions() const;
+
+    /// \brief Remove all expired sessions.
+    void expireSessions();
+
+    /// \returns the number of shards.
+    std::size_t getNumShards() const;
+
+    /// \returns the number of sessions held by the store.
+    std::size_t getNumSessions() const;
+
+    /// \returns the number of sessions that have expired.
+    uint64_t getNumExpiredSessions() const;
+
+    /// \returns the number of sessions that have been evicted.
+    uint64_t getNumEvictedSessions() const;
+
+    /// \brief The session store events, notified by all shards.
+    SessionStoreEvents events;
+
+    /// \brief The default number of shards.
+    static const std::size_t DEFAULT_NUM_SHARDS;
+
+protected:
+    bool hasSession(const std::string& sessionId) const override;
+    std::shared_ptr<AbstractSession> findSession(const std::string& sessionId) override;
+    std::shared_ptr<AbstractSession> createSharedSession() override;
+    void destroySession(const std::string& sessionId) override;
+
+private:
+    ShardedSessionStore(const ShardedSessionStore&);
+    ShardedSessionStore& operator = (const ShardedSessionStore&);
+
+    class Shard;
+
+    /// \brief Create the shards.
+    void _createShards(std::size_t numShards);
+
+    /// \returns the shard that holds a session id.
+    Shard& _shard(const std::string& sessionId) const;
+
+    /// \brief The shards.
+    std::vector<std::unique_ptr<Shard>> _shards;
+
+    /// \brief The maximum number of sessions held by the store.
+    std::atomic<std::size_t> _maximumSessions;
+
 };
 
 
@@ -53,6 +53,20 @@ public:
     /// \param pixels The pixels to send.
     void send(const ofPixels& pixels);
 
+    /// \brief Submit the pixels to send to a named stream.
+    /// \param streamName The name of the stream.
+    /// \param pixels The pixels to send.
+    void send(const std::string& streamName, const ofPixels& pixels);
+
+    /// \brief Submit shared pixels to send without copying them.
+    /// \param pixels The pixels to send.
+    void send(std::shared_ptr<const ofPixels> pixels);
+
+    /// \brief Submit shared pixels to send to a named stream without copying them.
+    /// \param streamName The name of the stream.
+    /// \param pixels The pixels to send.
+    void send(const std::string& streamName, std::shared_ptr<const ofPixels> pixels);
+
     /// \returns the number of clicents that are currently connected.
     std::size_t numConnections() const;
 
@@ -8,6 +8,7 @@
 #pragma once
 
 
+#include <memory>
 #include <queue>
 #include "Poco/Buffer.h"
 #include "Poco/Exception.h"
@@ -49,6 +50,14 @@ public:
     /// \returns false iff frame not queued
     bool sendFrame(const WebSocketFrame& frame) const;
 
+    /// \brief Queue a shared frame to be sent without copying it.
+    ///
+    /// The frame is only copied if send filters must modify it.
+    ///
+    /// \param frame The frame to send. It must not be modified once queued.
+    /// \returns false iff frame not queued
+    bool sendFrame(std::shared_ptr<const WebSocketFrame> frame) const;
+
     void stop() override;
 
 //    /// \brief Called when a WebSocketFrame is received.
@@ -125,7 +134,7 @@ private:
     std::vector<std::unique_ptr<AbstractWebSocketFilter>> _filters;
 
     /// \brief A queue of the WebSocketFrames scheduled for delivery.
-    mutable std::queue<WebSocketFrame> _frameQueue;
+    mutable std::queue<std::shared_ptr<const WebSocketFrame>> _frameQueue;
 
     /// \brief A mutex for threadsafe access to the frame queue, etc.
     mutable std::mutex _mutex;
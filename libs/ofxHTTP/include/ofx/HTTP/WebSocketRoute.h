@@ -8,6 +8,7 @@
 #pragma once
 
 
+#include <memory>
 #include <set>
 #include "ofx/HTTP/BaseRoute.h"
 #include "ofx/HTTP/AbstractServerTypes.h"
@@ -165,6 +166,29 @@ public:
     /// \param frame The frame to send.
     void broadcast(const WebSocketFrame& frame);
 
+    /// \brief Send a WebSocketFrame to a single connection.
+    ///
+    /// The frame is only queued if the connection is still registered with
+    /// this route, so callers may safely hold connection pointers received
+    /// in events after the connection has closed.
+    ///
+    /// \param connection The connection to send the frame to.
+    /// \param frame The frame to send.
+    /// \returns false iff the connection is gone or the frame was not queued.
+    bool sendFrame(const WebSocketConnection* connection,
+                   const WebSocketFrame& frame);
+
+    /// \brief Send a shared WebSocketFrame to a single connection.
+    ///
+    /// The frame is queued without being copied, so one frame can be sent
+    /// to many connections.
+    ///
+    /// \param connection The connection to send the frame to.
+    /// \param frame The frame to send. It must not be modified once queued.
+    /// \returns false iff the connection is gone or the frame was not queued.
+    bool sendFrame(const WebSocketConnection* connection,
+                   std::shared_ptr<const WebSocketFrame> frame);
+
     /// \brief Register event listeners for this route.
     ///
     /// The listener class must implement the following callbacks:
@@ -0,0 +1,729 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/CookieSessionStore.h"
+#include "Poco/NumberParser.h"
+#include "Poco/RandomStream.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+#include "Poco/Timestamp.h"
+#include "Poco/URI.h"
+#include "Poco/Crypto/CryptoException.h"
+#include "Poco/Crypto/DigestEngine.h"
+#include "ofx/IO/Base64Encoding.h"
+#include "ofLog.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+CookieSession::CookieSession(CookieSessionStore& store,
+                             Poco::Net::HTTPServerResponse& response,
+                             const std::string& sessionId,
+                             const std::map<std::string, std::string>& data):
+    SimpleSession(sessionId),
+    _store(store),
+    _response(&response)
+{
+    _sessionDict = data;
+}
+
+
+CookieSession::~CookieSession()
+{
+}
+
+
+void CookieSession::put(const std::string& key, const std::string& value)
+{
+    std::map<std::string, std::string> previousData = data();
+    SimpleSession::put(key, value);
+    _save(previousData);
+}
+
+
+void CookieSession::remove(const std::string& key)
+{
+    if (has(key))
+    {
+        std::map<std::string, std::string> previousData = data();
+        SimpleSession::remove(key);
+        _save(previousData);
+    }
+}
+
+
+void CookieSession::clear()
+{
+    std::map<std::string, std::string> previousData = data();
+    SimpleSession::clear();
+    _save(previousData);
+}
+
+
+std::map<std::string, std::string> CookieSession::data() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _sessionDict;
+}
+
+
+void CookieSession::detach()
+{
+    std::unique_lock<std::mutex> lock(_responseMutex);
+    _response = nullptr;
+}
+
+
+void CookieSession::_save(const std::map<std::string, std::string>& previousData)
+{
+    // Holding the lock keeps the response from being detached mid-save.
+    std::unique_lock<std::mutex> lock(_responseMutex);
+
+    if (_response == nullptr)
+    {
+        ofLogWarning("CookieSession::_save") << "Request already ended, session " << getId() << " not saved.";
+        return;
+    }
+
+    if (_response->sent())
+    {
+        ofLogWarning("CookieSession::_save") << "Response already sent, session " << getId() << " not saved.";
+        return;
+    }
+
+    try
+    {
+        _store.saveSession(*this, *_response);
+    }
+    catch (...)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _sessionDict = previousData;
+        throw;
+    }
+}
+
+
+const std::string CookieSessionStore::DEFAULT_SESSION_KEY_NAME = "session_key";
+const Poco::Timespan CookieSessionStore::DEFAULT_MAXIMUM_LIFETIME = Poco::Timespan(1, 0, 0, 0, 0);
+const std::size_t CookieSessionStore::DEFAULT_MAXIMUM_COOKIE_SIZE = 4096;
+const std::string CookieSessionStore::SIGNED_TAG = "s1";
+const std::string CookieSessionStore::ENCRYPTED_TAG = "e1";
+
+
+CookieSessionStore::CookieSessionStore():
+    _sessionKeyName(DEFAULT_SESSION_KEY_NAME),
+    _maximumLifetime(DEFAULT_MAXIMUM_LIFETIME),
+    _maximumCookieSize(DEFAULT_MAXIMUM_COOKIE_SIZE)
+{
+    std::string secret(32, 0);
+    Poco::RandomInputStream().read(&secret[0], secret.size());
+    setSecret(secret);
+}
+
+
+CookieSessionStore::CookieSessionStore(const std::string& secret,
+                                       const std::string& sessionKeyName):
+    _sessionKeyName(sessionKeyName),
+    _maximumLifetime(DEFAULT_MAXIMUM_LIFETIME),
+    _maximumCookieSize(DEFAULT_MAXIMUM_COOKIE_SIZE)
+{
+    setSecret(secret);
+}
+
+
+CookieSessionStore::~CookieSessionStore()
+{
+}
+
+
+AbstractSession& CookieSessionStore::getSession(Poco::Net::HTTPServerRequest& request,
+                                                Poco::Net::HTTPServerResponse& response)
+{
+    // The store holds the session until the request ends.
+    return *getSharedSession(request, response);
+}
+
+
+std::shared_ptr<AbstractSession> CookieSessionStore::getSharedSession(Poco::Net::HTTPServerRequest& request,
+                                                                      Poco::Net::HTTPServerResponse& response)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto iter = _requestSessions.find(&response);
+
+        if (iter != _requestSessions.end())
+        {
+            return iter->second;
+        }
+    }
+
+    std::shared_ptr<CookieSession> session = readOrCreateSession(request, response);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _requestSessions.insert(std::make_pair(&response, session)).first->second;
+}
+
+
+std::shared_ptr<CookieSession> CookieSessionStore::readOrCreateSession(Poco::Net::HTTPServerRequest& request,
+                                                                        Poco::Net::HTTPServerResponse& response)
+{
+    Poco::Net::NameValueCollection cookies;
+
+    request.getCookies(cookies);
+
+    Poco::Net::NameValueCollection::ConstIterator cookieIter = cookies.find(_sessionKeyName);
+
+    while (cookieIter != cookies.end() && 0 == cookieIter->first.compare(_sessionKeyName))
+    {
+        std::shared_ptr<CookieSession> session = readSession(cookieIter->second, response);
+
+        if (session != nullptr)
+        {
+            return session;
+        }
+
+        ++cookieIter;
+    }
+
+    std::map<std::string, std::string> data;
+
+    std::shared_ptr<CookieSession> session = std::make_shared<CookieSession>(*this,
+                                                                             response,
+                                                                             BaseSession::generateId(),
+                                                                             data);
+
+    saveSession(*session, response);
+
+    return session;
+}
+
+
+void CookieSessionStore::destroySession(Poco::Net::HTTPServerRequest& request,
+                                        Poco::Net::HTTPServerResponse& response)
+{
+    // Later changes to the old session must not restore its cookie.
+    endRequest(request, response);
+
+    Poco::Net::HTTPCookie cookie(_sessionKeyName);
+    cookie.setPath("/");
+    cookie.setMaxAge(0); // Invalidate the cookie.
+    setCookie(response, cookie);
+}
+
+
+void CookieSessionStore::endRequest(Poco::Net::HTTPServerRequest&,
+                                    Poco::Net::HTTPServerResponse& response)
+{
+    std::shared_ptr<CookieSession> session;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto iter = _requestSessions.find(&response);
+
+        if (iter == _requestSessions.end())
+        {
+            return;
+        }
+
+        session = iter->second;
+        _requestSessions.erase(iter);
+    }
+
+    session->detach();
+}
+
+
+void CookieSessionStore::setSecret(const std::string& secret)
+{
+    KeySchedule secretKeys;
+
+    makeDigests(secret, secretKeys);
+
+    // Separate keys are derived for signing and encryption.
+    std::shared_ptr<KeySchedule> keys = std::make_shared<KeySchedule>();
+
+    makeDigests(hmac(secretKeys, "ofxHTTP session signing key"), *keys);
+
+    std::string encryptionKey = hmac(secretKeys, "ofxHTTP session encryption key");
+
+    keys->encryptCipher = makeCipher(encryptionKey, true);
+    keys->decryptCipher = makeCipher(encryptionKey, false);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _keys = keys;
+}
+
+
+void CookieSessionStore::setUseEncryption(bool useEncryption)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _useEncryption = useEncryption;
+}
+
+
+bool CookieSessionStore::useEncryption() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _useEncryption;
+}
+
+
+void CookieSessionStore::setMaximumLifetime(const Poco::Timespan& maximumLifetime)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maximumLifetime = maximumLifetime;
+}
+
+
+Poco::Timespan CookieSessionStore::getMaximumLifetime() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _maximumLifetime;
+}
+
+
+void CookieSessionStore::setMaximumCookieSize(std::size_t maximumCookieSize)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maximumCookieSize = maximumCookieSize;
+}
+
+
+std::size_t CookieSessionStore::getMaximumCookieSize() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _maximumCookieSize;
+}
+
+
+void CookieSessionStore::saveSession(const CookieSession& session,
+                                     Poco::Net::HTTPServerResponse& response)
+{
+    std::shared_ptr<const KeySchedule> keys = this->keys();
+
+    bool useEncryption = this->useEncryption();
+    Poco::Timespan maximumLifetime = getMaximumLifetime();
+
+    // The payload is the expiry time, the session id and the form encoded
+    // data, separated by newlines.
+    std::string payload;
+
+    if (maximumLifetime.totalMicroseconds() > 0)
+    {
+        Poco::Timestamp expires = Poco::Timestamp() + maximumLifetime;
+        payload += std::to_string(expires.epochTime());
+    }
+
+    payload += "\n";
+    payload += session.getId();
+    payload += "\n";
+
+    for (const auto& entry: session.data())
+    {
+        if (payload.back() != '\n')
+        {
+            payload += "&";
+        }
+
+        Poco::URI::encode(entry.first, "&=+", payload);
+        payload += "=";
+        Poco::URI::encode(entry.second, "&=+", payload);
+    }
+
+    std::string value;
+
+    if (useEncryption)
+    {
+        std::vector<unsigned char> iv(16);
+        Poco::RandomInputStream().read(reinterpret_cast<char*>(iv.data()), iv.size());
+
+        std::string body(iv.begin(), iv.end());
+        body += crypt(*keys->encryptCipher, iv.data(), payload);
+
+        value = ENCRYPTED_TAG + "." + IO::Base64Encoding::encode(body, true);
+    }
+    else
+    {
+        value = SIGNED_TAG + "." + IO::Base64Encoding::encode(payload, true);
+    }
+
+    // The cookie name is signed so a value can not be moved to another cookie.
+    value += "." + sign(*keys, _sessionKeyName + "=" + value);
+
+    if (_sessionKeyName.size() + 1 + value.size() > getMaximumCookieSize())
+    {
+        throw Poco::RangeException("Session " + session.getId() + " exceeds the maximum cookie size.");
+    }
+
+    Poco::Net::HTTPCookie cookie(_sessionKeyName, value);
+    cookie.setPath("/");
+    cookie.setHttpOnly(true);
+
+    if (maximumLifetime.totalMicroseconds() > 0)
+    {
+        cookie.setMaxAge(static_cast<int>(maximumLifetime.totalSeconds()));
+    }
+
+    setCookie(response, cookie);
+}
+
+
+bool CookieSessionStore::hasSession(const std::string&) const
+{
+    return false;
+}
+
+
+AbstractSession& CookieSessionStore::getSession(const std::string& sessionId)
+{
+    throw Poco::InvalidAccessException("Session " + sessionId + " not found.");
+}
+
+
+AbstractSession& CookieSessionStore::createSession()
+{
+    throw Poco::NotImplementedException("A cookie session requires a response.");
+}
+
+
+void CookieSessionStore::destroySession(const std::string&)
+{
+}
+
+
+std::shared_ptr<const CookieSessionStore::KeySchedule> CookieSessionStore::keys() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _keys;
+}
+
+
+std::shared_ptr<CookieSession> CookieSessionStore::readSession(const std::string& value,
+                                                               Poco::Net::HTTPServerResponse& response)
+{
+    // Reject oversized cookies before doing any work.
+    if (_sessionKeyName.size() + 1 + value.size() > getMaximumCookieSize())
+    {
+        return nullptr;
+    }
+
+    std::size_t signatureStart = value.rfind('.');
+    std::size_t bodyStart = value.find('.');
+
+    if (signatureStart == std::string::npos || bodyStart == signatureStart)
+    {
+        return nullptr;
+    }
+
+    std::string signedValue = value.substr(0, signatureStart);
+    std::string tag = value.substr(0, bodyStart);
+
+    std::shared_ptr<const KeySchedule> keys = this->keys();
+
+    if (!constantTimeEquals(sign(*keys, _sessionKeyName + "=" + signedValue),
+                            value.substr(signatureStart + 1)))
+    {
+        ofLogVerbose("CookieSessionStore::readSession") << "Invalid signature.";
+        return nullptr;
+    }
+
+    std::string payload;
+
+    try
+    {
+        std::string body = IO::Base64Encoding::decode(signedValue.substr(bodyStart + 1), true);
+
+        if (tag == ENCRYPTED_TAG)
+        {
+            if (body.size() < 16)
+            {
+                return nullptr;
+            }
+
+            payload = crypt(*keys->decryptCipher,
+                            reinterpret_cast<const unsigned char*>(body.data()),
+                            body.substr(16));
+        }
+        else if (tag == SIGNED_TAG)
+        {
+            payload = body;
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogError("CookieSessionStore::readSession") << "Exception: " << exc.code() << " " << exc.displayText();
+        return nullptr;
+    }
+
+    std::size_t idStart = payload.find('\n');
+    std::size_t dataStart = idStart == std::string::npos ? idStart : payload.find('\n', idStart + 1);
+
+    if (dataStart == std::string::npos)
+    {
+        return nullptr;
+    }
+
+    if (idStart > 0)
+    {
+        Poco::Int64 expires = 0;
+
+        if (!Poco::NumberParser::tryParse64(payload.substr(0, idStart), expires)
+        ||  expires <= Poco::Timestamp().epochTime())
+        {
+            return nullptr;
+        }
+    }
+
+    std::map<std::string, std::string> data;
+
+    Poco::StringTokenizer pairs(payload.substr(dataStart + 1), "&", Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+
+    for (const auto& pair: pairs)
+    {
+        std::size_t equals = pair.find('=');
+
+        std::string key;
+        std::string value;
+
+        Poco::URI::decode(pair.substr(0, equals), key);
+
+        if (equals != std::string::npos)
+        {
+            Poco::URI::decode(pair.substr(equals + 1), value);
+        }
+
+        data[key] = value;
+    }
+
+    return std::make_shared<CookieSession>(*this,
+                                           response,
+                                           payload.substr(idStart + 1, dataStart - idStart - 1),
+                                           data);
+}
+
+
+void CookieSessionStore::setCookie(Poco::Net::HTTPServerResponse& response,
+                                   const Poco::Net::HTTPCookie& cookie) const
+{
+    // Keep every Set-Cookie header except an earlier one for this session.
+    std::vector<std::string> otherCookies;
+
+    Poco::Net::NameValueCollection::ConstIterator iter = response.find("Set-Cookie");
+
+    while (iter != response.end() && 0 == Poco::icompare(iter->first, "Set-Cookie"))
+    {
+        if (0 != iter->second.compare(0, _sessionKeyName.size() + 1, _sessionKeyName + "="))
+        {
+            otherCookies.push_back(iter->second);
+        }
+
+        ++iter;
+    }
+
+    response.erase("Set-Cookie");
+
+    for (const auto& otherCookie: otherCookies)
+    {
+        response.add("Set-Cookie", otherCookie);
+    }
+
+    response.addCookie(cookie);
+}
+
+
+std::string CookieSessionStore::sign(const KeySchedule& keys, const std::string& message)
+{
+    return IO::Base64Encoding::encode(hmac(keys, message), true);
+}
+
+
+bool CookieSessionStore::constantTimeEquals(const std::string& lhs, const std::string& rhs)
+{
+    // The lengths of valid signatures are public.
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+
+    unsigned char difference = 0;
+
+    for (std::size_t i = 0; i < lhs.size(); ++i)
+    {
+        difference |= static_cast<unsigned char>(lhs[i] ^ rhs[i]);
+    }
+
+    return difference == 0;
+}
+
+
+void CookieSessionStore::makePads(const std::string& key,
+                                  std::string& innerPad,
+                                  std::string& outerPad)
+{
+    const std::size_t BLOCK_SIZE = 64;
+
+    std::string blockKey = key;
+
+    // Keys longer than a block are hashed.
+    if (blockKey.size() > BLOCK_SIZE)
+    {
+        Poco::Crypto::DigestEngine engine("SHA256");
+        engine.update(blockKey);
+        const Poco::DigestEngine::Digest& digest = engine.digest();
+        blockKey.assign(digest.begin(), digest.end());
+    }
+
+    blockKey.resize(BLOCK_SIZE, 0);
+
+    innerPad = blockKey;
+    outerPad = blockKey;
+
+    for (std::size_t i = 0; i < BLOCK_SIZE; ++i)
+    {
+        innerPad[i] ^= 0x36;
+        outerPad[i] ^= 0x5c;
+    }
+}
+
+
+void CookieSessionStore::makeDigests(const std::string& key, KeySchedule& keys)
+{
+    std::string innerPad;
+    std::string outerPad;
+
+    makePads(key, innerPad, outerPad);
+
+    keys.innerDigest = newDigestContext();
+    keys.outerDigest = newDigestContext();
+
+    if (EVP_DigestInit_ex(keys.innerDigest.get(), EVP_sha256(), nullptr) != 1
+    ||  EVP_DigestUpdate(keys.innerDigest.get(), innerPad.data(), innerPad.size()) != 1
+    ||  EVP_DigestInit_ex(keys.outerDigest.get(), EVP_sha256(), nullptr) != 1
+    ||  EVP_DigestUpdate(keys.outerDigest.get(), outerPad.data(), outerPad.size()) != 1)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+}
+
+
+std::shared_ptr<EVP_CIPHER_CTX> CookieSessionStore::makeCipher(const std::string& key,
+                                                               bool encrypt)
+{
+    std::shared_ptr<EVP_CIPHER_CTX> cipher = newCipherContext();
+
+    // The IV is set per message, on a copy.
+    if (EVP_CipherInit_ex(cipher.get(),
+                          EVP_aes_256_cbc(),
+                          nullptr,
+                          reinterpret_cast<const unsigned char*>(key.data()),
+                          nullptr,
+                          encrypt ? 1 : 0) != 1)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+
+    return cipher;
+}
+
+
+std::string CookieSessionStore::hmac(const KeySchedule& keys, const std::string& message)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int innerSize = 0;
+    unsigned int outerSize = 0;
+
+    std::shared_ptr<EVP_MD_CTX> context = newDigestContext();
+
+    // Resume from the keyed states rather than hashing the pads again.
+    if (EVP_MD_CTX_copy_ex(context.get(), keys.innerDigest.get()) != 1
+    ||  EVP_DigestUpdate(context.get(), message.data(), message.size()) != 1
+    ||  EVP_DigestFinal_ex(context.get(), digest, &innerSize) != 1
+    ||  EVP_MD_CTX_copy_ex(context.get(), keys.outerDigest.get()) != 1
+    ||  EVP_DigestUpdate(context.get(), digest, innerSize) != 1
+    ||  EVP_DigestFinal_ex(context.get(), digest, &outerSize) != 1)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+
+    return std::string(reinterpret_cast<const char*>(digest), outerSize);
+}
+
+
+std::string CookieSessionStore::crypt(const EVP_CIPHER_CTX& keyedCipher,
+                                      const unsigned char* iv,
+                                      const std::string& input)
+{
+    std::string output(input.size() + EVP_MAX_BLOCK_LENGTH, 0);
+
+    unsigned char* out = reinterpret_cast<unsigned char*>(&output[0]);
+
+    int size = 0;
+    int finalSize = 0;
+
+    std::shared_ptr<EVP_CIPHER_CTX> cipher = newCipherContext();
+
+    // Copying keeps the expanded key, so only the IV is set.
+    if (EVP_CIPHER_CTX_copy(cipher.get(), &keyedCipher) != 1
+    ||  EVP_CipherInit_ex(cipher.get(), nullptr, nullptr, nullptr, iv, -1) != 1
+    ||  EVP_CipherUpdate(cipher.get(),
+                         out,
+                         &size,
+                         reinterpret_cast<const unsigned char*>(input.data()),
+                         static_cast<int>(input.size())) != 1
+    ||  EVP_CipherFinal_ex(cipher.get(), out + size, &finalSize) != 1)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+
+    output.resize(static_cast<std::size_t>(size + finalSize));
+
+    return output;
+}
+
+
+std::shared_ptr<EVP_MD_CTX> CookieSessionStore::newDigestContext()
+{
+    std::shared_ptr<EVP_MD_CTX> context(EVP_MD_CTX_create(), [](EVP_MD_CTX* ctx)
+    {
+        EVP_MD_CTX_destroy(ctx);
+    });
+
+    if (context == nullptr)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+
+    return context;
+}
+
+
+std::shared_ptr<EVP_CIPHER_CTX> CookieSessionStore::newCipherContext()
+{
+    std::shared_ptr<EVP_CIPHER_CTX> context(EVP_CIPHER_CTX_new(), [](EVP_CIPHER_CTX* ctx)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    });
+
+    if (context == nullptr)
+    {
+        throw Poco::Crypto::OpenSSLException();
+    }
+
+    return context;
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/EmbeddedAssetBundle.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace ofx {
+namespace HTTP {
+
+
+const EmbeddedAsset* EmbeddedAssetBundle::find(const std::string& path) const
+{
+    const EmbeddedAsset* asset = std::lower_bound(begin(), end(), path, [](const EmbeddedAsset& candidate, const std::string& value)
+    {
+        return std::strcmp(candidate.path, value.c_str()) < 0;
+    });
+
+    if (asset == end() || path != asset->path)
+    {
+        return nullptr;
+    }
+
+    return asset;
+}
+
+
+const EmbeddedAsset* EmbeddedAssetBundle::begin() const
+{
+    return _assets;
+}
+
+
+const EmbeddedAsset* EmbeddedAssetBundle::end() const
+{
+    return _assets + _numAssets;
+}
+
+
+std::size_t EmbeddedAssetBundle::size() const
+{
+    return _numAssets;
+}
+
+
+} } // namespace ofx::HTTP
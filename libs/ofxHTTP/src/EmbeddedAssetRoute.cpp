@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/EmbeddedAssetRoute.h"
+#include "ofx/HTTP/HTTPUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+const std::string EmbeddedAssetRouteSettings::DEFAULT_INDEX = "index.html";
+const std::string EmbeddedAssetRouteSettings::DEFAULT_GET_HTTP_METHODS_ARRAY[] = { "GET", "HEAD" };
+const EmbeddedAssetRouteSettings::HTTPMethodSet EmbeddedAssetRouteSettings::DEFAULT_GET_HTTP_METHODS(INIT_SET_WITH_ARRAY(DEFAULT_GET_HTTP_METHODS_ARRAY));
+
+
+EmbeddedAssetRouteSettings::EmbeddedAssetRouteSettings(const std::string& routePathPattern,
+                                                       bool requireSecurePort,
+                                                       bool requireAuthentication):
+    BaseRouteSettings(routePathPattern,
+                      requireSecurePort,
+                      requireAuthentication,
+                      EmbeddedAssetRouteSettings::DEFAULT_GET_HTTP_METHODS),
+    _defaultIndex(DEFAULT_INDEX)
+{
+}
+
+
+EmbeddedAssetRouteSettings::~EmbeddedAssetRouteSettings()
+{
+}
+
+
+void EmbeddedAssetRouteSettings::setDefaultIndex(const std::string& defaultIndex)
+{
+    _defaultIndex = defaultIndex;
+}
+
+
+const std::string& EmbeddedAssetRouteSettings::getDefaultIndex() const
+{
+    return _defaultIndex;
+}
+
+
+void EmbeddedAssetRouteSettings::setCacheControl(const std::string& cacheControl)
+{
+    _cacheControl = cacheControl;
+}
+
+
+const std::string& EmbeddedAssetRouteSettings::getCacheControl() const
+{
+    return _cacheControl;
+}
+
+
+EmbeddedAssetRoute::EmbeddedAssetRoute(const EmbeddedAssetBundle& bundle,
+                                       const Settings& settings):
+    BaseRoute_<EmbeddedAssetRouteSettings>(settings),
+    _bundle(bundle)
+{
+}
+
+
+EmbeddedAssetRoute::~EmbeddedAssetRoute()
+{
+}
+
+
+void EmbeddedAssetRoute::handleRequest(ServerEventArgs& evt)
+{
+    std::string path = Poco::URI(evt.request().getURI()).getPath();
+
+    if (path.empty())
+    {
+        path = "/";
+    }
+
+    if (path.back() == '/')
+    {
+        path += _settings.getDefaultIndex();
+    }
+
+    const EmbeddedAsset* asset = _bundle.find(path);
+
+    try
+    {
+        if (asset != nullptr)
+        {
+            sendAsset(evt, *asset, true);
+            return;
+        }
+
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+
+        const EmbeddedAsset* errorPage = _bundle.find("/404.html");
+
+        // Otherwise BaseRoute_<>::handleRequest() sends a generic page.
+        if (errorPage != nullptr)
+        {
+            sendAsset(evt, *errorPage, false);
+        }
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogError("EmbeddedAssetRoute::handleRequest") << "Exception: " << exc.code() << " " << exc.displayText();
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("EmbeddedAssetRoute::handleRequest") << "exception: " << exc.what();
+    }
+}
+
+
+Poco::Net::HTTPRequestHandler* EmbeddedAssetRoute::createRequestHandler(const Poco::Net::HTTPServerRequest& request)
+{
+    return new RequestHandlerAdapter(*this);
+}
+
+
+const EmbeddedAssetBundle& EmbeddedAssetRoute::bundle() const
+{
+    return _bundle;
+}
+
+
+void EmbeddedAssetRoute::sendAsset(ServerEventArgs& evt,
+                                   const EmbeddedAsset& asset,
+                                   bool isConditional)
+{
+    Poco::Net::HTTPServerRequest& request = evt.request();
+    Poco::Net::HTTPServerResponse& response = evt.response();
+
+    bool useGzip = asset.gzipData != nullptr
+                && HTTPUtils::acceptsEncoding(request.get("Accept-Encoding", ""), "gzip");
+
+    response.setContentType(asset.mediaType);
+
+    if (asset.gzipData != nullptr)
+    {
+        response.set("Vary", "Accept-Encoding");
+    }
+
+    if (isConditional)
+    {
+        const char* entityTag = useGzip ? asset.gzipEntityTag : asset.entityTag;
+
+        response.set("ETag", entityTag);
+
+        if (!_settings.getCacheControl().empty())
+        {
+            response.set("Cache-Control", _settings.getCacheControl());
+        }
+
+        if (request.has("If-None-Match")
+        &&  HTTPUtils::matchesEntityTag(request.get("If-None-Match"), entityTag, true))
+        {
+            response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED);
+            response.send();
+            return;
+        }
+    }
+
+    if (useGzip)
+    {
+        response.set("Content-Encoding", "gzip");
+        response.sendBuffer(asset.gzipData, asset.gzipSize);
+    }
+    else
+    {
+        response.sendBuffer(asset.data, asset.size);
+    }
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,436 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/FileSystemCache.h"
+#include <fstream>
+#include <vector>
+#if !defined(TARGET_WIN32)
+#include <sys/stat.h>
+#endif
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/File.h"
+#include "Poco/FileStream.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/SHA1Engine.h"
+#include "ofUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+bool FileSystemFileInfo::operator == (const FileSystemFileInfo& other) const
+{
+    return exists == other.exists
+        && size == other.size
+        && modified == other.modified
+        && inode == other.inode;
+}
+
+
+bool FileSystemFileInfo::operator != (const FileSystemFileInfo& other) const
+{
+    return !(*this == other);
+}
+
+
+#if !defined(TARGET_WIN32)
+/// \brief Convert a file status to a file identity.
+static FileSystemFileInfo toFileInfo(const struct ::stat& status)
+{
+    FileSystemFileInfo info;
+
+    if (S_ISREG(status.st_mode))
+    {
+        info.exists = true;
+        info.size = static_cast<uint64_t>(status.st_size);
+        info.inode = static_cast<uint64_t>(status.st_ino);
+#if defined(TARGET_OSX)
+        info.modified = Poco::Timestamp::fromEpochTime(status.st_mtimespec.tv_sec)
+                      + status.st_mtimespec.tv_nsec / 1000;
+#else
+        info.modified = Poco::Timestamp::fromEpochTime(status.st_mtim.tv_sec)
+                      + status.st_mtim.tv_nsec / 1000;
+#endif
+    }
+
+    return info;
+}
+#endif
+
+
+FileSystemFileInfo FileSystemFileInfo::stat(const std::string& path)
+{
+#if !defined(TARGET_WIN32)
+    struct ::stat status;
+
+    if (::stat(path.c_str(), &status) == 0)
+    {
+        return toFileInfo(status);
+    }
+
+    return FileSystemFileInfo();
+#else
+    FileSystemFileInfo info;
+
+    try
+    {
+        Poco::File file(path);
+
+        if (file.exists() && file.isFile())
+        {
+            info.exists = true;
+            info.size = file.getSize();
+            info.modified = file.getLastModified();
+        }
+    }
+    catch (const Poco::Exception&)
+    {
+        // The file is reported as missing.
+    }
+
+    return info;
+#endif
+}
+
+
+FileSystemFileInfo FileSystemFileInfo::stat(int fd)
+{
+#if !defined(TARGET_WIN32)
+    struct ::stat status;
+
+    if (::fstat(fd, &status) == 0)
+    {
+        return toFileInfo(status);
+    }
+#endif
+
+    return FileSystemFileInfo();
+}
+
+
+FileSystemCache::FileSystemCache(uint64_t maximumSize,
+                                 uint64_t maximumFileSize,
+                                 std::size_t maximumEntries,
+                                 uint64_t revalidationInterval,
+                                 bool useContentHash):
+    _maximumSize(maximumSize),
+    _maximumFileSize(maximumFileSize),
+    _maximumEntries(maximumEntries),
+    _revalidationInterval(revalidationInterval),
+    _useContentHash(useContentHash)
+{
+}
+
+
+FileSystemCache::~FileSystemCache()
+{
+}
+
+
+void FileSystemCache::setup(uint64_t maximumSize,
+                            uint64_t maximumFileSize,
+                            std::size_t maximumEntries,
+                            uint64_t revalidationInterval,
+                            bool useContentHash)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maximumSize = maximumSize;
+    _maximumFileSize = maximumFileSize;
+    _maximumEntries = maximumEntries;
+    _revalidationInterval = revalidationInterval;
+    _useContentHash = useContentHash;
+    _entries.clear();
+    _recency.clear();
+    _size = 0;
+}
+
+
+std::shared_ptr<const FileSystemCacheEntry> FileSystemCache::get(const std::string& key)
+{
+    std::shared_ptr<const FileSystemCacheEntry> entry;
+
+    uint64_t now = ofGetElapsedTimeMillis();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto iter = _entries.find(key);
+
+        if (iter == _entries.end())
+        {
+            ++_misses;
+            return nullptr;
+        }
+
+        Node& node = iter->second;
+
+        if (now - node.lastValidated < _revalidationInterval)
+        {
+            _recency.splice(_recency.begin(), _recency, node.recency);
+            ++_hits;
+            return node.entry;
+        }
+
+        entry = node.entry;
+    }
+
+    // Query the file system without holding the lock.
+    FileSystemFileInfo info = FileSystemFileInfo::stat(entry->path);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _entries.find(key);
+
+    // The entry may have been replaced or removed in the meantime.
+    if (iter == _entries.end() || iter->second.entry != entry)
+    {
+        ++_misses;
+        return nullptr;
+    }
+
+    if (info != entry->info)
+    {
+        _remove(iter);
+        ++_misses;
+        return nullptr;
+    }
+
+    iter->second.lastValidated = now;
+    _recency.splice(_recency.begin(), _recency, iter->second.recency);
+    ++_hits;
+    return entry;
+}
+
+
+std::shared_ptr<const FileSystemCacheEntry> FileSystemCache::load(const std::string& key,
+                                                                  const FileSystemCacheEntry& prototype)
+{
+    const std::string& path = prototype.path;
+
+    FileSystemFileInfo info = FileSystemFileInfo::stat(path);
+
+    if (!info.exists)
+    {
+        return nullptr;
+    }
+
+    bool cacheEntry = false;
+    bool cacheContents = false;
+    bool useContentHash = false;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        cacheEntry = _maximumEntries > 0;
+        cacheContents = cacheEntry && info.size <= _maximumFileSize && info.size <= _maximumSize;
+        useContentHash = _useContentHash;
+    }
+
+    auto entry = std::make_shared<FileSystemCacheEntry>(prototype);
+    entry->info = info;
+    entry->hasContents = false;
+    entry->buffer.clear();
+    entry->lastModified = Poco::DateTimeFormatter::format(info.modified,
+                                                          Poco::DateTimeFormat::HTTP_FORMAT);
+
+    if (cacheContents)
+    {
+        entry->buffer.allocate(static_cast<std::size_t>(info.size));
+
+        std::ifstream stream(path, std::ios::binary);
+
+        stream.read(entry->buffer.getData(), static_cast<std::streamsize>(info.size));
+
+        // If the file was truncated while being read, its contents will be
+        // read from disk instead.
+        entry->hasContents = static_cast<uint64_t>(stream.gcount()) == info.size;
+
+        if (!entry->hasContents)
+        {
+            entry->buffer.clear();
+        }
+    }
+
+    if (!useContentHash)
+    {
+        entry->entityTag = makeEntityTag(info);
+    }
+    else if (entry->hasContents)
+    {
+        entry->entityTag = makeContentEntityTag(entry->buffer);
+    }
+    else
+    {
+        entry->entityTag = makeContentEntityTag(path);
+    }
+
+    if (!entry->contentEncoding.empty())
+    {
+        entry->entityTag = makeEncodedEntityTag(entry->entityTag, entry->contentEncoding);
+    }
+
+    if (cacheEntry)
+    {
+        insert(key, entry);
+    }
+
+    return entry;
+}
+
+
+void FileSystemCache::insert(const std::string& key,
+                             std::shared_ptr<const FileSystemCacheEntry> entry)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_maximumEntries == 0
+    || (entry->hasContents && entry->buffer.size() > _maximumSize))
+    {
+        return;
+    }
+
+    auto iter = _entries.find(key);
+
+    if (iter != _entries.end())
+    {
+        _remove(iter);
+    }
+
+    _recency.push_front(key);
+
+    Node& node = _entries[key];
+    node.entry = entry;
+    node.lastValidated = ofGetElapsedTimeMillis();
+    node.recency = _recency.begin();
+
+    if (entry->hasContents)
+    {
+        _size += entry->buffer.size();
+    }
+
+    _evict();
+}
+
+
+void FileSystemCache::remove(const std::string& key)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _entries.find(key);
+
+    if (iter != _entries.end())
+    {
+        _remove(iter);
+    }
+}
+
+
+void FileSystemCache::clear()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _entries.clear();
+    _recency.clear();
+    _size = 0;
+}
+
+
+uint64_t FileSystemCache::size() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _size;
+}
+
+
+std::size_t FileSystemCache::numEntries() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+
+uint64_t FileSystemCache::hits() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+
+uint64_t FileSystemCache::misses() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+
+std::string FileSystemCache::makeEntityTag(const FileSystemFileInfo& info)
+{
+    return "\"" + Poco::NumberFormatter::formatHex(info.inode)
+         + "-" + Poco::NumberFormatter::formatHex(info.size)
+         + "-" + Poco::NumberFormatter::formatHex(static_cast<Poco::UInt64>(info.modified.epochMicroseconds()))
+         + "\"";
+}
+
+
+std::string FileSystemCache::makeContentEntityTag(const std::string& path)
+{
+    Poco::SHA1Engine engine;
+    Poco::FileInputStream stream(path, std::ios::in | std::ios::binary);
+
+    std::vector<char> buffer(65536);
+
+    while (stream.read(buffer.data(), buffer.size()) || stream.gcount() > 0)
+    {
+        engine.update(buffer.data(), static_cast<unsigned>(stream.gcount()));
+    }
+
+    return "\"" + Poco::DigestEngine::digestToHex(engine.digest()) + "\"";
+}
+
+
+std::string FileSystemCache::makeContentEntityTag(const ofBuffer& buffer)
+{
+    Poco::SHA1Engine engine;
+    engine.update(buffer.getData(), static_cast<unsigned>(buffer.size()));
+    return "\"" + Poco::DigestEngine::digestToHex(engine.digest()) + "\"";
+}
+
+
+std::string FileSystemCache::makeEncodedEntityTag(const std::string& entityTag,
+                                                  const std::string& contentEncoding)
+{
+    if (entityTag.size() < 2)
+    {
+        return entityTag;
+    }
+
+    return entityTag.substr(0, entityTag.size() - 1) + "-" + contentEncoding + "\"";
+}
+
+
+void FileSystemCache::_remove(std::unordered_map<std::string, Node>::iterator iter)
+{
+    if (iter->second.entry->hasContents)
+    {
+        _size -= iter->second.entry->buffer.size();
+    }
+
+    _recency.erase(iter->second.recency);
+    _entries.erase(iter);
+}
+
+
+void FileSystemCache::_evict()
+{
+    while ((_size > _maximumSize || _entries.size() > _maximumEntries) && !_recency.empty())
+    {
+        _remove(_entries.find(_recency.back()));
+    }
+}
+
+
+} } // namespace ofx::HTTP
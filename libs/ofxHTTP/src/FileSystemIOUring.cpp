@@ -0,0 +1,786 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/FileSystemIOUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#if defined(TARGET_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <poll.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(IO_URING_OP_SUPPORTED)
+#define OFX_HTTP_HAS_IO_URING 1
+#endif
+#endif
+#endif
+#include "Poco/Exception.h"
+#include "ofLog.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+/// \brief The user data of the wake-up poll.
+static const uint64_t WAKE_OPERATION = 0;
+
+/// \brief The user data tag of a file read.
+static const uint64_t READ_OPERATION = 1;
+
+/// \brief The user data tag of a socket send.
+static const uint64_t SEND_OPERATION = 2;
+
+/// \brief The user data tag of a send's linked timeout.
+static const uint64_t TIMEOUT_OPERATION = 3;
+
+/// \brief The mask of the user data tags.
+static const uint64_t OPERATION_MASK = 3;
+
+
+const Poco::Timespan FileSystemIOUring::DEFAULT_SEND_TIMEOUT = Poco::Timespan(60 * Poco::Timespan::SECONDS);
+
+
+/// \brief A range being sent.
+struct FileSystemIOUring::Transfer
+{
+    /// \brief The file descriptor of the file.
+    int fd = -1;
+
+    /// \brief The file descriptor of the socket.
+    int socket = -1;
+
+    /// \brief The offset of the next block.
+    uint64_t offset = 0;
+
+    /// \brief The number of bytes not yet read.
+    uint64_t remaining = 0;
+
+    /// \brief The index of the transfer's fixed buffer, or -1.
+    int buffer = -1;
+
+    /// \brief The number of bytes in the buffer.
+    std::size_t length = 0;
+
+    /// \brief The number of bytes of the buffer already sent.
+    std::size_t sent = 0;
+
+    /// \brief The number of submitted operations not yet completed.
+    unsigned numInFlight = 0;
+
+    /// \brief True once the block's read has completed.
+    bool isRead = false;
+
+    /// \brief True if a short read cancelled the linked send.
+    bool needsSend = false;
+
+    /// \brief True if the timeout of the last send expired.
+    bool isTimedOut = false;
+
+#if defined(OFX_HTTP_HAS_IO_URING)
+    /// \brief The timeout of each send. The kernel reads it on submission.
+    struct __kernel_timespec timeout;
+#endif
+
+    /// \brief The first error as a negative errno value, or 0.
+    int error = 0;
+
+    /// \brief The result reported to the caller.
+    std::promise<int> result;
+};
+
+
+#if defined(OFX_HTTP_HAS_IO_URING)
+/// \brief A minimal io_uring built on the raw system calls.
+struct FileSystemIOUring::Ring
+{
+    ~Ring()
+    {
+        if (sqes != nullptr) ::munmap(sqes, sqesSize);
+        if (cqRing != nullptr && cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+        if (sqRing != nullptr) ::munmap(sqRing, sqRingSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    /// \brief Create the ring.
+    /// \returns 0 or a negative errno value.
+    int setup(unsigned entries)
+    {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+
+        if (fd < 0)
+        {
+            return -errno;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+        bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+        if (isSingleMap)
+        {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+
+        if (sqRing == nullptr)
+        {
+            return -errno;
+        }
+
+        cqRing = isSingleMap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+
+        if (cqRing == nullptr)
+        {
+            return -errno;
+        }
+
+        sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe*>(map(sqesSize, IORING_OFF_SQES));
+
+        if (sqes == nullptr)
+        {
+            return -errno;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        localTail = *sqTail;
+        submittedTail = localTail;
+
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return 0;
+    }
+
+    /// \returns true iff the kernel supports an operation.
+    bool supports(const struct io_uring_probe* probe, unsigned opcode) const
+    {
+        return opcode <= probe->last_op
+            && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    /// \returns true iff the kernel supports every operation used.
+    bool probe()
+    {
+        const unsigned numOps = 256;
+
+        std::vector<char> storage(sizeof(struct io_uring_probe) + numOps * sizeof(struct io_uring_probe_op), 0);
+        struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(storage.data());
+
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, numOps) < 0)
+        {
+            return false;
+        }
+
+        return supports(probe, IORING_OP_READ_FIXED)
+            && supports(probe, IORING_OP_SEND)
+            && supports(probe, IORING_OP_LINK_TIMEOUT)
+            && supports(probe, IORING_OP_POLL_ADD);
+    }
+
+    /// \brief Register the fixed buffers.
+    /// \returns 0 or a negative errno value.
+    int registerBuffers(const std::vector<struct iovec>& buffers)
+    {
+        if (::syscall(__NR_io_uring_register,
+                      fd,
+                      IORING_REGISTER_BUFFERS,
+                      buffers.data(),
+                      static_cast<unsigned>(buffers.size())) < 0)
+        {
+            return -errno;
+        }
+
+        return 0;
+    }
+
+    /// \returns the number of free submission queue entries.
+    unsigned space() const
+    {
+        return sqEntries - (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE));
+    }
+
+    /// \returns a cleared submission queue entry. The caller must ensure
+    ///          that space() is not zero.
+    struct io_uring_sqe* next()
+    {
+        unsigned index = localTail & sqMask;
+        struct io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        ++localTail;
+        return sqe;
+    }
+
+    /// \brief Submit the prepared entries and optionally wait.
+    /// \param waitFor The number of completions to wait for.
+    /// \returns 0 or a negative errno value.
+    int submit(unsigned waitFor)
+    {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+
+        unsigned toSubmit = localTail - submittedTail;
+
+        int result = static_cast<int>(::syscall(__NR_io_uring_enter,
+                                                fd,
+                                                toSubmit,
+                                                waitFor,
+                                                waitFor > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                                nullptr,
+                                                0));
+
+        if (result < 0)
+        {
+            return -errno;
+        }
+
+        submittedTail += static_cast<unsigned>(result);
+        return 0;
+    }
+
+    void* map(std::size_t size, off_t offset)
+    {
+        void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return data == MAP_FAILED ? nullptr : data;
+    }
+
+    int fd = -1;
+
+    void* sqRing = nullptr;
+    std::size_t sqRingSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned localTail = 0;
+    unsigned submittedTail = 0;
+
+    struct io_uring_sqe* sqes = nullptr;
+    std::size_t sqesSize = 0;
+
+    void* cqRing = nullptr;
+    std::size_t cqRingSize = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+};
+#else
+struct FileSystemIOUring::Ring
+{
+};
+#endif
+
+
+FileSystemIOUring::FileSystemIOUring(std::size_t numBuffers,
+                                     std::size_t bufferSize,
+                                     unsigned queueDepth):
+    _numBuffers(std::max<std::size_t>(1, numBuffers)),
+    _bufferSize(std::max<std::size_t>(1, bufferSize)),
+    _queueDepth(std::max(4u, queueDepth))
+{
+}
+
+
+FileSystemIOUring::~FileSystemIOUring()
+{
+    stop();
+}
+
+
+bool FileSystemIOUring::start()
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    if (isRunning())
+    {
+        return true;
+    }
+
+    std::unique_ptr<Ring> ring = std::make_unique<Ring>();
+
+    int result = ring->setup(_queueDepth);
+
+    if (result < 0)
+    {
+        ofLogWarning("FileSystemIOUring::start") << "Unable to create ring: " << std::strerror(-result);
+        return false;
+    }
+
+    if (!ring->probe())
+    {
+        ofLogWarning("FileSystemIOUring::start") << "The kernel does not support the required operations.";
+        return false;
+    }
+
+    _buffers.assign(_numBuffers * _bufferSize, 0);
+    _freeBuffers.clear();
+
+    std::vector<struct iovec> buffers(_numBuffers);
+
+    for (std::size_t i = 0; i < _numBuffers; ++i)
+    {
+        buffers[i].iov_base = _buffers.data() + i * _bufferSize;
+        buffers[i].iov_len = _bufferSize;
+        _freeBuffers.push_back(static_cast<int>(_numBuffers - 1 - i));
+    }
+
+    result = ring->registerBuffers(buffers);
+
+    if (result < 0)
+    {
+        ofLogWarning("FileSystemIOUring::start") << "Unable to register buffers: " << std::strerror(-result);
+        return false;
+    }
+
+    _eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (_eventFd < 0)
+    {
+        ofLogWarning("FileSystemIOUring::start") << "Unable to create eventfd: " << std::strerror(errno);
+        return false;
+    }
+
+    _ring = std::move(ring);
+    _numActive = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRunning = true;
+    }
+
+    _thread = std::thread(&FileSystemIOUring::_run, this);
+    return true;
+#else
+    ofLogWarning("FileSystemIOUring::start") << "io_uring is not available on this platform.";
+    return false;
+#endif
+}
+
+
+void FileSystemIOUring::stop()
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRunning = false;
+    }
+
+    if (_thread.joinable())
+    {
+        uint64_t value = 1;
+
+        if (::write(_eventFd, &value, sizeof(value)) < 0)
+        {
+            ofLogError("FileSystemIOUring::stop") << "Unable to wake the I/O thread: " << std::strerror(errno);
+        }
+
+        _thread.join();
+    }
+
+    _ring.reset();
+
+    if (_eventFd >= 0)
+    {
+        ::close(_eventFd);
+        _eventFd = -1;
+    }
+#endif
+}
+
+
+bool FileSystemIOUring::isRunning() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _isRunning;
+}
+
+
+void FileSystemIOUring::send(int fd,
+                             int socket,
+                             uint64_t offset,
+                             uint64_t length,
+                             const Poco::Timespan& timeout)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    Transfer transfer;
+    transfer.fd = fd;
+    transfer.socket = socket;
+    transfer.offset = offset;
+    transfer.remaining = length;
+
+#if defined(OFX_HTTP_HAS_IO_URING)
+    Poco::Timespan sendTimeout = timeout.totalMicroseconds() > 0 ? timeout : DEFAULT_SEND_TIMEOUT;
+    transfer.timeout.tv_sec = sendTimeout.totalSeconds();
+    transfer.timeout.tv_nsec = static_cast<long long>(sendTimeout.useconds()) * 1000;
+#endif
+
+    std::future<int> result = transfer.result.get_future();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (!_isRunning)
+        {
+            throw Poco::IllegalStateException("The io_uring is not running.");
+        }
+
+        _queue.push_back(&transfer);
+    }
+
+#if defined(OFX_HTTP_HAS_IO_URING)
+    uint64_t value = 1;
+
+    if (::write(_eventFd, &value, sizeof(value)) < 0)
+    {
+        ofLogError("FileSystemIOUring::send") << "Unable to wake the I/O thread: " << std::strerror(errno);
+    }
+#endif
+
+    // The transfer must outlive its operations, so always wait. Each send
+    // is linked to a timeout, so a stalled peer can not hold the wait.
+    int error = result.get();
+
+    if (error != 0)
+    {
+        throw Poco::IOException("Unable to send file.", std::strerror(-error));
+    }
+}
+
+
+void FileSystemIOUring::_run()
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    _wake();
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            if (!_isRunning && _numActive == 0 && _waiting.empty() && _queue.empty())
+            {
+                return;
+            }
+        }
+
+        int result = _ring->submit(1);
+
+        if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY)
+        {
+            ofLogError("FileSystemIOUring::_run") << "Unable to submit: " << std::strerror(-result);
+        }
+
+        // Reap every available completion before submitting again.
+        unsigned head = *_ring->cqHead;
+        unsigned tail = __atomic_load_n(_ring->cqTail, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            const struct io_uring_cqe& cqe = _ring->cqes[head & _ring->cqMask];
+
+            uint64_t userData = cqe.user_data;
+            int res = cqe.res;
+
+            ++head;
+            __atomic_store_n(_ring->cqHead, head, __ATOMIC_RELEASE);
+
+            _complete(userData, res);
+
+            tail = __atomic_load_n(_ring->cqTail, __ATOMIC_ACQUIRE);
+        }
+    }
+#endif
+}
+
+
+void FileSystemIOUring::_complete(uint64_t userData, int result)
+{
+    if (userData == WAKE_OPERATION)
+    {
+        _wake();
+        return;
+    }
+
+    Transfer& transfer = *reinterpret_cast<Transfer*>(userData & ~OPERATION_MASK);
+
+    --transfer.numInFlight;
+
+    if ((userData & OPERATION_MASK) == TIMEOUT_OPERATION)
+    {
+        // The timeout is cancelled if the send completes first. Otherwise
+        // it cancels the send, which is then failed in _update().
+        if (result == -ETIME)
+        {
+            transfer.isTimedOut = true;
+        }
+    }
+    else if ((userData & OPERATION_MASK) == READ_OPERATION)
+    {
+        transfer.isRead = true;
+
+        if (result < 0)
+        {
+            transfer.error = transfer.error != 0 ? transfer.error : result;
+        }
+        else if (result == 0)
+        {
+            // The file was truncated.
+            transfer.error = transfer.error != 0 ? transfer.error : -EIO;
+        }
+        else if (static_cast<std::size_t>(result) < transfer.length)
+        {
+            // The short read cancels the linked send.
+            transfer.length = static_cast<std::size_t>(result);
+        }
+    }
+    else if (result == -ECANCELED && transfer.error == 0)
+    {
+        transfer.needsSend = true;
+    }
+    else if (result < 0)
+    {
+        transfer.error = transfer.error != 0 ? transfer.error : result;
+    }
+    else
+    {
+        transfer.sent += static_cast<std::size_t>(result);
+
+        if (transfer.sent < transfer.length)
+        {
+            transfer.needsSend = true;
+        }
+        else
+        {
+            transfer.offset += transfer.length;
+            transfer.remaining -= transfer.length;
+            transfer.length = 0;
+            transfer.sent = 0;
+        }
+    }
+
+    _update(transfer);
+}
+
+
+void FileSystemIOUring::_wake()
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    uint64_t value = 0;
+
+    while (::read(_eventFd, &value, sizeof(value)) > 0)
+    {
+    }
+
+    bool isRunning = false;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _waiting.insert(_waiting.end(), _queue.begin(), _queue.end());
+        _queue.clear();
+        isRunning = _isRunning;
+    }
+
+    if (!isRunning)
+    {
+        // Transfers that have not started are abandoned.
+        while (!_waiting.empty())
+        {
+            Transfer* transfer = _waiting.front();
+            _waiting.pop_front();
+            transfer->result.set_value(-ECANCELED);
+        }
+
+        return;
+    }
+
+    if (_ring->space() == 0)
+    {
+        _ring->submit(0);
+    }
+
+    struct io_uring_sqe* sqe = _ring->next();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _eventFd;
+    sqe->poll_events = POLLIN;
+    sqe->user_data = WAKE_OPERATION;
+
+    _assignBuffers();
+#endif
+}
+
+
+void FileSystemIOUring::_assignBuffers()
+{
+    while (!_freeBuffers.empty() && !_waiting.empty())
+    {
+        Transfer& transfer = *_waiting.front();
+        _waiting.pop_front();
+
+        transfer.buffer = _freeBuffers.back();
+        _freeBuffers.pop_back();
+
+        ++_numActive;
+
+        _submitBlock(transfer);
+    }
+}
+
+
+void FileSystemIOUring::_submitBlock(Transfer& transfer)
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    // A linked chain must be submitted together.
+    if (_ring->space() < 3)
+    {
+        _ring->submit(0);
+    }
+
+    char* buffer = _buffers.data() + static_cast<std::size_t>(transfer.buffer) * _bufferSize;
+    uint64_t userData = reinterpret_cast<uint64_t>(&transfer);
+
+    transfer.length = static_cast<std::size_t>(std::min<uint64_t>(transfer.remaining, _bufferSize));
+    transfer.sent = 0;
+    transfer.isRead = false;
+    transfer.needsSend = false;
+    transfer.isTimedOut = false;
+
+    struct io_uring_sqe* read = _ring->next();
+    read->opcode = IORING_OP_READ_FIXED;
+    read->flags = IOSQE_IO_LINK;
+    read->fd = transfer.fd;
+    read->off = transfer.offset;
+    read->addr = reinterpret_cast<uint64_t>(buffer);
+    read->len = static_cast<uint32_t>(transfer.length);
+    read->buf_index = static_cast<uint16_t>(transfer.buffer);
+    read->user_data = userData | READ_OPERATION;
+
+    struct io_uring_sqe* send = _ring->next();
+    send->opcode = IORING_OP_SEND;
+    send->flags = IOSQE_IO_LINK;
+    send->fd = transfer.socket;
+    send->addr = reinterpret_cast<uint64_t>(buffer);
+    send->len = static_cast<uint32_t>(transfer.length);
+    send->msg_flags = MSG_NOSIGNAL;
+    send->user_data = userData | SEND_OPERATION;
+
+    _prepareTimeout(transfer);
+
+    transfer.numInFlight += 3;
+#endif
+}
+
+
+void FileSystemIOUring::_submitSend(Transfer& transfer)
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    // A linked pair must be submitted together.
+    if (_ring->space() < 2)
+    {
+        _ring->submit(0);
+    }
+
+    char* buffer = _buffers.data() + static_cast<std::size_t>(transfer.buffer) * _bufferSize;
+
+    struct io_uring_sqe* send = _ring->next();
+    send->opcode = IORING_OP_SEND;
+    send->flags = IOSQE_IO_LINK;
+    send->fd = transfer.socket;
+    send->addr = reinterpret_cast<uint64_t>(buffer + transfer.sent);
+    send->len = static_cast<uint32_t>(transfer.length - transfer.sent);
+    send->msg_flags = MSG_NOSIGNAL;
+    send->user_data = reinterpret_cast<uint64_t>(&transfer) | SEND_OPERATION;
+
+    _prepareTimeout(transfer);
+
+    transfer.needsSend = false;
+    transfer.isTimedOut = false;
+    transfer.numInFlight += 2;
+#endif
+}
+
+
+void FileSystemIOUring::_prepareTimeout(Transfer& transfer)
+{
+#if defined(OFX_HTTP_HAS_IO_URING)
+    struct io_uring_sqe* timeout = _ring->next();
+    timeout->opcode = IORING_OP_LINK_TIMEOUT;
+    timeout->fd = -1;
+    timeout->addr = reinterpret_cast<uint64_t>(&transfer.timeout);
+    timeout->len = 1;
+    timeout->user_data = reinterpret_cast<uint64_t>(&transfer) | TIMEOUT_OPERATION;
+#endif
+}
+
+
+void FileSystemIOUring::_update(Transfer& transfer)
+{
+    // Wait for the whole chain, as only the timeout's completion tells a
+    // send cancelled by a short read from one cancelled by its timeout.
+    if (transfer.numInFlight > 0)
+    {
+        return;
+    }
+
+    if (transfer.error == 0 && transfer.needsSend && transfer.isTimedOut)
+    {
+        transfer.error = -ETIMEDOUT;
+    }
+
+    if (transfer.error != 0 || transfer.remaining == 0)
+    {
+        _finish(transfer);
+    }
+    else if (transfer.needsSend)
+    {
+        _submitSend(transfer);
+    }
+    else
+    {
+        _submitBlock(transfer);
+    }
+}
+
+
+void FileSystemIOUring::_finish(Transfer& transfer)
+{
+    _freeBuffers.push_back(transfer.buffer);
+    --_numActive;
+
+    // The caller may destroy the transfer as soon as the result is set.
+    transfer.result.set_value(transfer.error);
+
+    _assignBuffers();
+}
+
+
+} } // namespace ofx::HTTP
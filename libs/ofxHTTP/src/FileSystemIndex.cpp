@@ -0,0 +1,440 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/FileSystemIndex.h"
+#include <cerrno>
+#include <cstring>
+#if defined(TARGET_LINUX)
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "ofLog.h"
+#include "ofx/MediaTypeMap.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+#if defined(TARGET_LINUX)
+/// \brief The events that change the files in a watched directory.
+static const uint32_t WATCH_MASK = IN_CREATE
+                                 | IN_DELETE
+                                 | IN_MODIFY
+                                 | IN_CLOSE_WRITE
+                                 | IN_ATTRIB
+                                 | IN_MOVED_FROM
+                                 | IN_MOVED_TO
+                                 | IN_ONLYDIR;
+#endif
+
+
+FileSystemIndex::FileSystemIndex()
+{
+}
+
+
+FileSystemIndex::~FileSystemIndex()
+{
+    close();
+}
+
+
+bool FileSystemIndex::open(const std::string& documentRoot, const std::string& defaultIndex)
+{
+    close();
+
+#if defined(TARGET_LINUX)
+    int inotify = ::inotify_init1(IN_CLOEXEC);
+
+    if (inotify < 0)
+    {
+        ofLogError("FileSystemIndex::open") << "Unable to initialize inotify: " << std::strerror(errno);
+        return false;
+    }
+
+    int wakeup[2] = { -1, -1 };
+
+    if (::pipe2(wakeup, O_CLOEXEC) != 0)
+    {
+        ofLogError("FileSystemIndex::open") << "Unable to create pipe: " << std::strerror(errno);
+        ::close(inotify);
+        return false;
+    }
+
+    std::string root = documentRoot;
+
+    while (root.size() > 1 && root.back() == '/')
+    {
+        root.pop_back();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _documentRoot = root;
+        _defaultIndex = defaultIndex;
+        _inotify = inotify;
+        _wakeup[0] = wakeup[0];
+        _wakeup[1] = wakeup[1];
+    }
+
+    _scan(root);
+
+    _thread = std::thread(&FileSystemIndex::_watch, this);
+
+    ofLogVerbose("FileSystemIndex::open") << "Indexed " << size() << " request paths in " << root;
+
+    return true;
+#else
+    ofLogWarning("FileSystemIndex::open") << "The file system index requires inotify, which is not available on this platform.";
+    return false;
+#endif
+}
+
+
+void FileSystemIndex::close()
+{
+#if defined(TARGET_LINUX)
+    // Closing the write end of the pipe wakes the watching thread.
+    if (_wakeup[1] >= 0)
+    {
+        ::close(_wakeup[1]);
+    }
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    if (_wakeup[0] >= 0)
+    {
+        ::close(_wakeup[0]);
+    }
+
+    if (_inotify >= 0)
+    {
+        ::close(_inotify);
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _inotify = -1;
+    _wakeup[0] = -1;
+    _wakeup[1] = -1;
+    _records.clear();
+    _watches.clear();
+}
+
+
+bool FileSystemIndex::isOpen() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _inotify >= 0;
+}
+
+
+std::shared_ptr<const FileSystemIndexRecord> FileSystemIndex::find(const std::string& requestPath) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _records.find(requestPath);
+
+    if (iter == _records.end())
+    {
+        return nullptr;
+    }
+
+    return iter->second;
+}
+
+
+std::size_t FileSystemIndex::size() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _records.size();
+}
+
+
+void FileSystemIndex::_scan(const std::string& directory)
+{
+#if defined(TARGET_LINUX)
+    // The watch is added before listing so that no new file is missed.
+    int watch = ::inotify_add_watch(_inotify, directory.c_str(), WATCH_MASK);
+
+    if (watch < 0)
+    {
+        ofLogError("FileSystemIndex::_scan") << "Unable to watch " << directory << ": " << std::strerror(errno);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _watches[watch] = directory;
+    }
+
+    DIR* dir = ::opendir(directory.c_str());
+
+    if (dir == nullptr)
+    {
+        ofLogError("FileSystemIndex::_scan") << "Unable to list " << directory << ": " << std::strerror(errno);
+        return;
+    }
+
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        std::string path = directory + "/" + entry->d_name;
+
+        struct ::stat status;
+
+        // Directory symbolic links are not followed, which avoids cycles.
+        if (::lstat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode))
+        {
+            _scan(path);
+        }
+        else
+        {
+            _update(path);
+        }
+    }
+
+    ::closedir(dir);
+#endif
+}
+
+
+void FileSystemIndex::_update(const std::string& path)
+{
+    std::string requestPath = _toRequestPath(path);
+    std::string fileName = path.substr(path.rfind('/') + 1);
+
+    // A default index is also found by its directory's request path.
+    std::string directoryPath;
+
+    if (!_defaultIndex.empty() && fileName == _defaultIndex)
+    {
+        directoryPath = requestPath.substr(0, requestPath.size() - fileName.size());
+    }
+
+    FileSystemFileInfo info = FileSystemFileInfo::stat(path);
+
+    if (!info.exists)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _records.erase(requestPath);
+
+        if (!directoryPath.empty())
+        {
+            _records.erase(directoryPath);
+        }
+
+        return;
+    }
+
+    auto record = std::make_shared<FileSystemIndexRecord>();
+    record->requestPath = requestPath;
+    record->path = path;
+    record->info = info;
+    record->mediaType = MediaTypeMap::getDefault()->getMediaTypeForPath(path).toString();
+    record->lastModified = Poco::DateTimeFormatter::format(info.modified,
+                                                           Poco::DateTimeFormat::HTTP_FORMAT);
+    record->entityTag = FileSystemCache::makeEntityTag(info);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _records[requestPath] = record;
+
+    if (!directoryPath.empty())
+    {
+        _records[directoryPath] = record;
+    }
+}
+
+
+void FileSystemIndex::_removeDirectory(const std::string& directory)
+{
+    std::string requestPrefix = _toRequestPath(directory) + "/";
+    std::string pathPrefix = directory + "/";
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto iter = _records.begin(); iter != _records.end();)
+    {
+        if (iter->first.compare(0, requestPrefix.size(), requestPrefix) == 0)
+        {
+            iter = _records.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    // A moved directory is still watched under its old path.
+    for (auto iter = _watches.begin(); iter != _watches.end();)
+    {
+        if (iter->second == directory
+        ||  iter->second.compare(0, pathPrefix.size(), pathPrefix) == 0)
+        {
+#if defined(TARGET_LINUX)
+            ::inotify_rm_watch(_inotify, iter->first);
+#endif
+            iter = _watches.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+
+void FileSystemIndex::_rescan()
+{
+    ofLogWarning("FileSystemIndex::_rescan") << "File system events were lost, rescanning " << _documentRoot;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+#if defined(TARGET_LINUX)
+        for (const auto& watch: _watches)
+        {
+            ::inotify_rm_watch(_inotify, watch.first);
+        }
+#endif
+
+        _watches.clear();
+        _records.clear();
+    }
+
+    _scan(_documentRoot);
+}
+
+
+std::string FileSystemIndex::_toRequestPath(const std::string& path) const
+{
+    return path.substr(_documentRoot.size());
+}
+
+
+void FileSystemIndex::_watch()
+{
+#if defined(TARGET_LINUX)
+    alignas(struct inotify_event) char buffer[65536];
+
+    while (true)
+    {
+        struct pollfd fds[2] = {
+            { _inotify, POLLIN, 0 },
+            { _wakeup[0], POLLIN, 0 }
+        };
+
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            ofLogError("FileSystemIndex::_watch") << "Unable to poll: " << std::strerror(errno);
+            return;
+        }
+
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+
+        ssize_t length = ::read(_inotify, buffer, sizeof(buffer));
+
+        if (length <= 0)
+        {
+            if (length < 0 && (errno == EINTR || errno == EAGAIN))
+            {
+                continue;
+            }
+
+            ofLogError("FileSystemIndex::_watch") << "Unable to read events: " << std::strerror(errno);
+            return;
+        }
+
+        ssize_t offset = 0;
+
+        while (offset < length)
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                _rescan();
+                break;
+            }
+
+            std::string directory;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                auto iter = _watches.find(event->wd);
+
+                if (iter == _watches.end())
+                {
+                    continue;
+                }
+
+                if (event->mask & IN_IGNORED)
+                {
+                    _watches.erase(iter);
+                    continue;
+                }
+
+                directory = iter->second;
+            }
+
+            // Events on the directory itself are reported by its parent.
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            std::string path = directory + "/" + event->name;
+
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    _removeDirectory(path);
+                }
+                else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    _scan(path);
+                }
+            }
+            else
+            {
+                _update(path);
+            }
+        }
+    }
+#endif
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/FileSystemMappedFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+#include <sys/mman.h>
+#endif
+#include "Poco/Exception.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+FileSystemMappedFile::FileSystemMappedFile(int fd, const FileSystemFileInfo& info):
+    _info(info)
+{
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+    if (_info.size == 0)
+    {
+        return;
+    }
+
+    void* data = ::mmap(nullptr,
+                        static_cast<std::size_t>(_info.size),
+                        PROT_READ,
+                        MAP_SHARED,
+                        fd,
+                        0);
+
+    if (data == MAP_FAILED)
+    {
+        throw Poco::IOException("Unable to map file.", std::strerror(errno));
+    }
+
+    // Advice only affects performance, so failure is ignored.
+    ::madvise(data, static_cast<std::size_t>(_info.size), MADV_SEQUENTIAL);
+
+    _data = static_cast<char*>(data);
+#else
+    throw Poco::NotImplementedException("Memory mapped files are not supported on this platform.");
+#endif
+}
+
+
+FileSystemMappedFile::~FileSystemMappedFile()
+{
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+    if (_data != nullptr)
+    {
+        ::munmap(_data, static_cast<std::size_t>(_info.size));
+    }
+#endif
+}
+
+
+const char* FileSystemMappedFile::data() const
+{
+    return _data;
+}
+
+
+uint64_t FileSystemMappedFile::size() const
+{
+    return _info.size;
+}
+
+
+const FileSystemFileInfo& FileSystemMappedFile::info() const
+{
+    return _info;
+}
+
+
+FileSystemMappedFileCache::FileSystemMappedFileCache()
+{
+}
+
+
+FileSystemMappedFileCache::~FileSystemMappedFileCache()
+{
+}
+
+
+std::shared_ptr<const FileSystemMappedFile> FileSystemMappedFileCache::map(const std::string& path,
+                                                                           int fd,
+                                                                           const FileSystemFileInfo& info)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _files.find(path);
+
+    if (iter != _files.end())
+    {
+        std::shared_ptr<const FileSystemMappedFile> file = iter->second.lock();
+
+        if (file != nullptr && file->info() == info)
+        {
+            return file;
+        }
+    }
+
+    // Mapping does not read the file, so it is cheap enough to do locked.
+    auto file = std::make_shared<const FileSystemMappedFile>(fd, info);
+
+    _files[path] = file;
+
+    if (_files.size() >= _sweepSize)
+    {
+        for (auto sweep = _files.begin(); sweep != _files.end();)
+        {
+            if (sweep->second.expired())
+            {
+                sweep = _files.erase(sweep);
+            }
+            else
+            {
+                ++sweep;
+            }
+        }
+
+        _sweepSize = std::max<std::size_t>(64, _files.size() * 2);
+    }
+
+    return file;
+}
+
+
+std::size_t FileSystemMappedFileCache::numMappedFiles() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    return std::count_if(_files.begin(), _files.end(), [](const std::pair<const std::string, std::weak_ptr<const FileSystemMappedFile>>& file)
+    {
+        return !file.second.expired();
+    });
+}
+
+
+} } // namespace ofx::HTTP
@@ -6,7 +6,33 @@
 
 
 #include "ofx/HTTP/FileSystemRoute.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#if defined(TARGET_LINUX)
+#include <pthread.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#elif defined(TARGET_OSX)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/DateTimeParser.h"
+#include "Poco/DeflatingStream.h"
+#include "Poco/FileStream.h"
+#include "Poco/StreamCopier.h"
+#include "Poco/UUIDGenerator.h"
+#include "Poco/Net/HTTPServerRequestImpl.h"
 #include "ofUtils.h"
+#include "ofx/HTTP/HTTPUtils.h"
 #include "ofx/MediaTypeMap.h"
 
 
@@ -18,6 +44,22 @@ const std::string FileSystemRouteSettings::DEFAULT_DOCUMENT_ROOT = "DocumentRoot
 const std::string FileSystemRouteSettings::DEFAULT_INDEX         = "index.html";
 const std::string FileSystemRouteSettings::DEFAULT_GET_HTTP_METHODS_ARRAY[] = { "GET" };
 const FileSystemRouteSettings::HTTPMethodSet FileSystemRouteSettings::DEFAULT_GET_HTTP_METHODS(INIT_SET_WITH_ARRAY(DEFAULT_GET_HTTP_METHODS_ARRAY));
+const std::string FileSystemRouteSettings::DEFAULT_COMPRESSIBLE_MEDIA_TYPES_ARRAY[] = {
+    "text/*",
+    "application/javascript",
+    "application/json",
+    "application/xml",
+    "image/svg+xml"
+};
+const FileSystemRouteSettings::MediaTypeSet FileSystemRouteSettings::DEFAULT_COMPRESSIBLE_MEDIA_TYPES(INIT_SET_WITH_ARRAY(DEFAULT_COMPRESSIBLE_MEDIA_TYPES_ARRAY));
+
+
+/// \brief The content encodings of precompressed siblings in order of
+///        preference, and their file name extensions.
+static const std::pair<std::string, std::string> PRECOMPRESSED_ENCODINGS[] = {
+    { "br", ".br" },
+    { "gzip", ".gz" }
+};
 
 
 FileSystemRouteSettings::FileSystemRouteSettings(const std::string& routePathPattern,
@@ -30,7 +72,8 @@ FileSystemRouteSettings::FileSystemRouteSettings(const std::string& routePathPat
     _defaultIndex(DEFAULT_INDEX),
     _documentRoot(DEFAULT_DOCUMENT_ROOT),
     _autoCreateDocumentRoot(false),
-    _requireDocumentRootInDataFolder(true)
+    _requireDocumentRootInDataFolder(true),
+    _compressibleMediaTypes(DEFAULT_COMPRESSIBLE_MEDIA_TYPES)
 {
 }
 
@@ -88,9 +131,258 @@ bool FileSystemRouteSettings::getRequireDocumentRootInDataFolder() const
 }
 
 
+void FileSystemRouteSettings::setMaximumCacheSize(uint64_t maximumCacheSize)
+{
+    _maximumCacheSize = maximumCacheSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMaximumCacheSize() const
+{
+    return _maximumCacheSize;
+}
+
+
+void FileSystemRouteSettings::setMaximumCachedFileSize(uint64_t maximumCachedFileSize)
+{
+    _maximumCachedFileSize = maximumCachedFileSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMaximumCachedFileSize() const
+{
+    return _maximumCachedFileSize;
+}
+
+
+void FileSystemRouteSettings::setCacheRevalidationInterval(uint64_t cacheRevalidationInterval)
+{
+    _cacheRevalidationInterval = cacheRevalidationInterval;
+}
+
+
+uint64_t FileSystemRouteSettings::getCacheRevalidationInterval() const
+{
+    return _cacheRevalidationInterval;
+}
+
+
+void FileSystemRouteSettings::setUseSendFile(bool useSendFile)
+{
+    _useSendFile = useSendFile;
+}
+
+
+bool FileSystemRouteSettings::getUseSendFile() const
+{
+    return _useSendFile;
+}
+
+
+void FileSystemRouteSettings::setUseMemoryMappedFiles(bool useMemoryMappedFiles)
+{
+    _useMemoryMappedFiles = useMemoryMappedFiles;
+}
+
+
+bool FileSystemRouteSettings::getUseMemoryMappedFiles() const
+{
+    return _useMemoryMappedFiles;
+}
+
+
+void FileSystemRouteSettings::setMinimumMemoryMappedFileSize(uint64_t minimumMemoryMappedFileSize)
+{
+    _minimumMemoryMappedFileSize = minimumMemoryMappedFileSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMinimumMemoryMappedFileSize() const
+{
+    return _minimumMemoryMappedFileSize;
+}
+
+
+void FileSystemRouteSettings::setUseIOUring(bool useIOUring)
+{
+    _useIOUring = useIOUring;
+}
+
+
+bool FileSystemRouteSettings::getUseIOUring() const
+{
+    return _useIOUring;
+}
+
+
+void FileSystemRouteSettings::setMaximumCacheEntries(std::size_t maximumCacheEntries)
+{
+    _maximumCacheEntries = maximumCacheEntries;
+}
+
+
+std::size_t FileSystemRouteSettings::getMaximumCacheEntries() const
+{
+    return _maximumCacheEntries;
+}
+
+
+void FileSystemRouteSettings::setUseContentHashEntityTags(bool useContentHashEntityTags)
+{
+    _useContentHashEntityTags = useContentHashEntityTags;
+}
+
+
+bool FileSystemRouteSettings::getUseContentHashEntityTags() const
+{
+    return _useContentHashEntityTags;
+}
+
+
+void FileSystemRouteSettings::setUseFileSystemIndex(bool useFileSystemIndex)
+{
+    _useFileSystemIndex = useFileSystemIndex;
+}
+
+
+bool FileSystemRouteSettings::getUseFileSystemIndex() const
+{
+    return _useFileSystemIndex;
+}
+
+
+void FileSystemRouteSettings::addCacheControl(const std::string& mediaTypeRange,
+                                              const std::string& cacheControl)
+{
+    _cacheControl.push_back(std::make_pair(mediaTypeRange, cacheControl));
+}
+
+
+void FileSystemRouteSettings::clearCacheControl()
+{
+    _cacheControl.clear();
+}
+
+
+std::string FileSystemRouteSettings::getCacheControl(const std::string& mediaType) const
+{
+    Poco::Net::MediaType type(mediaType);
+
+    for (const auto& cacheControl: _cacheControl)
+    {
+        if (type.matchesRange(Poco::Net::MediaType(cacheControl.first)))
+        {
+            return cacheControl.second;
+        }
+    }
+
+    return "";
+}
+
+
+void FileSystemRouteSettings::setUsePrecompressedFiles(bool usePrecompressedFiles)
+{
+    _usePrecompressedFiles = usePrecompressedFiles;
+}
+
+
+bool FileSystemRouteSettings::getUsePrecompressedFiles() const
+{
+    return _usePrecompressedFiles;
+}
+
+
+void FileSystemRouteSettings::setUseCompression(bool useCompression)
+{
+    _useCompression = useCompression;
+}
+
+
+bool FileSystemRouteSettings::getUseCompression() const
+{
+    return _useCompression;
+}
+
+
+void FileSystemRouteSettings::setCompressibleMediaTypes(const MediaTypeSet& compressibleMediaTypes)
+{
+    _compressibleMediaTypes = compressibleMediaTypes;
+}
+
+
+const FileSystemRouteSettings::MediaTypeSet& FileSystemRouteSettings::getCompressibleMediaTypes() const
+{
+    return _compressibleMediaTypes;
+}
+
+
+bool FileSystemRouteSettings::isCompressible(const std::string& mediaType) const
+{
+    Poco::Net::MediaType type(mediaType);
+
+    for (const auto& compressibleMediaType: _compressibleMediaTypes)
+    {
+        if (type.matchesRange(Poco::Net::MediaType(compressibleMediaType)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void FileSystemRouteSettings::setMinimumCompressedFileSize(uint64_t minimumCompressedFileSize)
+{
+    _minimumCompressedFileSize = minimumCompressedFileSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMinimumCompressedFileSize() const
+{
+    return _minimumCompressedFileSize;
+}
+
+
+void FileSystemRouteSettings::setMaximumCompressedFileSize(uint64_t maximumCompressedFileSize)
+{
+    _maximumCompressedFileSize = maximumCompressedFileSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMaximumCompressedFileSize() const
+{
+    return _maximumCompressedFileSize;
+}
+
+
+void FileSystemRouteSettings::setMaximumCompressedCacheSize(uint64_t maximumCompressedCacheSize)
+{
+    _maximumCompressedCacheSize = maximumCompressedCacheSize;
+}
+
+
+uint64_t FileSystemRouteSettings::getMaximumCompressedCacheSize() const
+{
+    return _maximumCompressedCacheSize;
+}
+
+
 FileSystemRoute::FileSystemRoute(const Settings& settings):
-    BaseRoute_<FileSystemRouteSettings>(settings)
+    BaseRoute_<FileSystemRouteSettings>(settings),
+    _cache(settings.getMaximumCacheSize(),
+           settings.getMaximumCachedFileSize(),
+           settings.getMaximumCacheEntries(),
+           settings.getCacheRevalidationInterval(),
+           settings.getUseContentHashEntityTags()),
+    _encodedCache(settings.getMaximumCompressedCacheSize(),
+                  settings.getMaximumCompressedFileSize(),
+                  settings.getMaximumCacheEntries(),
+                  settings.getCacheRevalidationInterval(),
+                  false)
 {
+    openIndex();
+    startIOUring();
 }
 
 
@@ -99,27 +391,36 @@ FileSystemRoute::~FileSystemRoute()
 }
 
 
-void FileSystemRoute::handleRequest(ServerEventArgs& evt)
+void FileSystemRoute::setup(const Settings& settings)
 {
-    Poco::Path dataFolder(ofToDataPath("", true));
-    Poco::Path documentRoot(ofToDataPath(settings().getDocumentRoot(), true));
+    BaseRoute_<FileSystemRouteSettings>::setup(settings);
 
-    std::string dataFolderString = dataFolder.toString();
-    std::string documentRootString = documentRoot.toString();
+    // Cached entries may belong to the previous document root.
+    _cache.setup(settings.getMaximumCacheSize(),
+                 settings.getMaximumCachedFileSize(),
+                 settings.getMaximumCacheEntries(),
+                 settings.getCacheRevalidationInterval(),
+                 settings.getUseContentHashEntityTags());
+
+    _encodedCache.setup(settings.getMaximumCompressedCacheSize(),
+                        settings.getMaximumCompressedFileSize(),
+                        settings.getMaximumCacheEntries(),
+                        settings.getCacheRevalidationInterval(),
+                        false);
 
-    // Document root validity check.
-    if (_settings.getRequireDocumentRootInDataFolder() &&
-       (documentRootString.length() < dataFolderString.length() ||
-        documentRootString.substr(0, dataFolderString.length()) != dataFolderString))
     {
-        ofLogError("FileSystemRoute::handleRequest") << "Document Root is not a sub directory of the data folder.";
-        evt.response()   .setStatusAndReason(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
-        handleErrorResponse(evt);
-        return;
+        // Error pages may belong to the previous document root.
+        std::unique_lock<std::mutex> lock(_errorPagesMutex);
+        _errorPages.clear();
     }
 
-    // check path
+    openIndex();
+    startIOUring();
+}
 
+
+void FileSystemRoute::handleRequest(ServerEventArgs& evt)
+{
     Poco::URI uri(evt.request().getURI());
     std::string path = uri.getPath(); // just get the path
 
@@ -129,39 +430,74 @@ void FileSystemRoute::handleRequest(ServerEventArgs& evt)
         path = "/";
     }
 
-    Poco::Path requestPath = documentRoot.append(path).makeAbsolute();
+    // A cached request path was resolved and checked when it was cached.
+    std::shared_ptr<const FileSystemCacheEntry> entry = _cache.get(path);
 
-    // add the default index if no filename is requested
-    if (requestPath.getFileName().empty())
+    try
     {
-        requestPath.append(settings().getDefaultIndex()).makeAbsolute();
-    }
+        if (entry == nullptr)
+        {
+            FileSystemCacheEntry prototype;
 
-    std::string requestPathString = requestPath.toString();
+            // With an index, missing files are not looked for on disk.
+            std::shared_ptr<const FileSystemIndexRecord> record;
 
-    // double check path safety (not needed?)
-    if ((requestPathString.length() < documentRootString.length() ||
-         requestPathString.substr(0, documentRootString.length()) != documentRootString))
-    {
-        ofLogError("FileSystemRoute::handleRequest") << "Requested document not inside DocumentFolder.";
-        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
-        handleErrorResponse(evt);
-        return;
-    }
+            std::shared_ptr<FileSystemIndex> currentIndex = index();
 
-    ofFile file(requestPathString); // use it to parse file name parts
-    std::string mediaTypeString = MediaTypeMap::getDefault()->getMediaTypeForPath(file.path()).toString();
+            if (currentIndex->isOpen())
+            {
+                record = currentIndex->find(path);
 
-    try
-    {
-        // TODO: this is where we would begin to work honoring
-        /// Accept-Encoding:gzip, deflate, sdch
-        evt.response().sendFile(file.getAbsolutePath(), mediaTypeString);
+                if (record == nullptr)
+                {
+                    throw Poco::FileNotFoundException(path);
+                }
+
+                prototype.path = record->path;
+                prototype.mediaType = record->mediaType;
+            }
+            else
+            {
+                if (!resolvePath(evt, path, prototype.path))
+                {
+                    return;
+                }
+
+                prototype.mediaType = MediaTypeMap::getDefault()->getMediaTypeForPath(prototype.path).toString();
+            }
+
+            prototype.cacheControl = _settings.getCacheControl(prototype.mediaType);
+            prototype.isCompressible = _settings.getUseCompression()
+                                    && _settings.isCompressible(prototype.mediaType);
+
+            if (_settings.getUsePrecompressedFiles())
+            {
+                for (const auto& encoding: PRECOMPRESSED_ENCODINGS)
+                {
+                    if (record != nullptr ? currentIndex->find(record->requestPath + encoding.second) != nullptr
+                                          : FileSystemFileInfo::stat(prototype.path + encoding.second).exists)
+                    {
+                        prototype.precompressedEncodings.push_back(encoding.first);
+                    }
+                }
+            }
+
+            entry = _cache.load(path, prototype);
+
+            if (entry == nullptr)
+            {
+                throw Poco::FileNotFoundException(prototype.path);
+            }
+        }
+
+        entry = selectEncoding(evt, path, entry);
+
+        sendEntry(evt, path, *entry);
         return;
     }
     catch (const Poco::FileNotFoundException& exc)
     {
-        ofLogError("FileSystemRoute::handleRequest") << exc.displayText();
+        ofLogVerbose("FileSystemRoute::handleRequest") << exc.displayText();
         evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
         handleErrorResponse(evt);
         return;
@@ -185,24 +521,17 @@ void FileSystemRoute::handleRequest(ServerEventArgs& evt)
 
 void FileSystemRoute::handleErrorResponse(ServerEventArgs& evt)
 {
-    // See if we have an html file with that error code.
-    ofFile errorFile(_settings.getDocumentRoot() + "/" + ofToString(evt.response().getStatus()) + ".html");
+    std::shared_ptr<const std::string> page = getErrorPage(evt.response().getStatus());
 
-    if (errorFile.exists())
+    if (page != nullptr)
     {
         try
         {
-            evt.response().sendFile(errorFile.getAbsolutePath(), "text/html");
+            evt.response().setChunkedTransferEncoding(false);
+            evt.response().setContentType("text/html");
+            evt.response().sendBuffer(page->data(), page->size());
             return;
         }
-        catch (const Poco::FileNotFoundException& exc)
-        {
-            ofLogVerbose("FileSystemRoute::sendErrorResponse") << "Poco::FileNotFoundException: " << exc.code() << " " << exc.displayText();
-        }
-        catch (const Poco::OpenFileException& exc)
-        {
-            ofLogVerbose("FileSystemRoute::sendErrorResponse") << "Poco::OpenFileException: " << exc.code() << " " << exc.displayText();
-        }
         catch (const Poco::Exception& exc)
         {
             ofLogVerbose("FileSystemRoute::sendErrorResponse") << "Exception: " << exc.code() << " " << exc.displayText();
@@ -211,10 +540,6 @@ void FileSystemRoute::handleErrorResponse(ServerEventArgs& evt)
         {
             ofLogVerbose("FileSystemRoute::sendErrorResponse") << "exception: " << exc.what();
         }
-        catch ( ... )
-        {
-            ofLogVerbose("FileSystemRoute::sendErrorResponse") << "... Unknown exception.";
-        }
     }
 
     // Will pass to BaseRoute_<>::sendResponse() if not already sent.
@@ -227,4 +552,862 @@ Poco::Net::HTTPRequestHandler* FileSystemRoute::createRequestHandler(const Poco:
 }
 
 
+FileSystemCache& FileSystemRoute::cache()
+{
+    return _cache;
+}
+
+
+std::shared_ptr<FileSystemIndex> FileSystemRoute::index() const
+{
+    std::unique_lock<std::mutex> lock(_resourcesMutex);
+    return _index;
+}
+
+
+std::shared_ptr<const std::string> FileSystemRoute::getErrorPage(int status)
+{
+    {
+        std::unique_lock<std::mutex> lock(_errorPagesMutex);
+
+        auto iter = _errorPages.find(status);
+
+        if (iter != _errorPages.end())
+        {
+            return iter->second;
+        }
+    }
+
+    std::shared_ptr<const std::string> page;
+
+    // See if we have an html file with that error code.
+    ofFile errorFile(_settings.getDocumentRoot() + "/" + ofToString(status) + ".html");
+
+    if (errorFile.exists())
+    {
+        try
+        {
+            ofBuffer buffer = errorFile.readToBuffer();
+            page = std::make_shared<const std::string>(buffer.getData(), buffer.size());
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogVerbose("FileSystemRoute::getErrorPage") << "exception: " << exc.what();
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_errorPagesMutex);
+    _errorPages[status] = page;
+    return page;
+}
+
+
+void FileSystemRoute::startIOUring()
+{
+    std::shared_ptr<FileSystemIOUring> ioUring;
+
+    if (_settings.getUseIOUring())
+    {
+        ioUring = std::make_shared<FileSystemIOUring>();
+
+        if (!ioUring->start())
+        {
+            ofLogWarning("FileSystemRoute::startIOUring") << "Sending files without io_uring.";
+            ioUring.reset();
+        }
+    }
+
+    // The previous ring is destroyed once the last file using it is sent.
+    std::unique_lock<std::mutex> lock(_resourcesMutex);
+    _ioUring = ioUring;
+}
+
+
+std::shared_ptr<FileSystemIOUring> FileSystemRoute::ioUring() const
+{
+    std::unique_lock<std::mutex> lock(_resourcesMutex);
+    return _ioUring;
+}
+
+
+void FileSystemRoute::openIndex()
+{
+    std::shared_ptr<FileSystemIndex> index = std::make_shared<FileSystemIndex>();
+
+    _openIndex(*index);
+
+    // The previous index is destroyed once the last request using it is done.
+    std::unique_lock<std::mutex> lock(_resourcesMutex);
+    _index = index;
+}
+
+
+void FileSystemRoute::_openIndex(FileSystemIndex& index)
+{
+    if (!_settings.getUseFileSystemIndex())
+    {
+        return;
+    }
+
+    std::string dataFolder = Poco::Path(ofToDataPath("", true)).toString();
+    std::string documentRoot = Poco::Path(ofToDataPath(_settings.getDocumentRoot(), true)).toString();
+
+    // The same check as resolvePath(), which reports the error per request.
+    if (_settings.getRequireDocumentRootInDataFolder() &&
+       (documentRoot.length() < dataFolder.length() ||
+        documentRoot.substr(0, dataFolder.length()) != dataFolder))
+    {
+        ofLogError("FileSystemRoute::openIndex") << "Document Root is not a sub directory of the data folder.";
+        return;
+    }
+
+    if (!index.open(documentRoot, _settings.getDefaultIndex()))
+    {
+        ofLogWarning("FileSystemRoute::openIndex") << "Resolving request paths without an index.";
+    }
+}
+
+
+bool FileSystemRoute::resolvePath(ServerEventArgs& evt,
+                                  const std::string& path,
+                                  std::string& absolutePath)
+{
+    Poco::Path dataFolder(ofToDataPath("", true));
+    Poco::Path documentRoot(ofToDataPath(settings().getDocumentRoot(), true));
+
+    std::string dataFolderString = dataFolder.toString();
+    std::string documentRootString = documentRoot.toString();
+
+    // Document root validity check.
+    if (_settings.getRequireDocumentRootInDataFolder() &&
+       (documentRootString.length() < dataFolderString.length() ||
+        documentRootString.substr(0, dataFolderString.length()) != dataFolderString))
+    {
+        ofLogError("FileSystemRoute::handleRequest") << "Document Root is not a sub directory of the data folder.";
+        evt.response()   .setStatusAndReason(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+        handleErrorResponse(evt);
+        return false;
+    }
+
+    // check path
+
+    Poco::Path requestPath = documentRoot.append(path).makeAbsolute();
+
+    // add the default index if no filename is requested
+    if (requestPath.getFileName().empty())
+    {
+        requestPath.append(settings().getDefaultIndex()).makeAbsolute();
+    }
+
+    std::string requestPathString = requestPath.toString();
+
+    // double check path safety (not needed?)
+    if ((requestPathString.length() < documentRootString.length() ||
+         requestPathString.substr(0, documentRootString.length()) != documentRootString))
+    {
+        ofLogError("FileSystemRoute::handleRequest") << "Requested document not inside DocumentFolder.";
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+        handleErrorResponse(evt);
+        return false;
+    }
+
+    absolutePath = requestPathString;
+    return true;
+}
+
+
+std::shared_ptr<const FileSystemCacheEntry> FileSystemRoute::selectEncoding(ServerEventArgs& evt,
+                                                                            const std::string& key,
+                                                                            std::shared_ptr<const FileSystemCacheEntry> entry)
+{
+    bool canCompress = entry->isCompressible
+                    && entry->info.size >= _settings.getMinimumCompressedFileSize()
+                    && entry->info.size <= _settings.getMaximumCompressedFileSize();
+
+    if (!canCompress && entry->precompressedEncodings.empty())
+    {
+        return entry;
+    }
+
+    evt.response().set("Vary", "Accept-Encoding");
+
+    const std::string& acceptEncoding = evt.request().get("Accept-Encoding", "");
+
+    if (acceptEncoding.empty())
+    {
+        return entry;
+    }
+
+    // A compressed copy is stale if the file changed after it was made.
+    auto isStale = [&entry](const FileSystemCacheEntry& encoded)
+    {
+        return encoded.path == entry->path ? encoded.info != entry->info
+                                           : encoded.info.modified < entry->info.modified;
+    };
+
+    for (const auto& encoding: PRECOMPRESSED_ENCODINGS)
+    {
+        const std::string& contentEncoding = encoding.first;
+
+        bool isPrecompressed = std::find(entry->precompressedEncodings.begin(),
+                                         entry->precompressedEncodings.end(),
+                                         contentEncoding) != entry->precompressedEncodings.end();
+
+        bool isCompressible = canCompress && contentEncoding == "gzip";
+
+        if ((!isPrecompressed && !isCompressible)
+        ||  !HTTPUtils::acceptsEncoding(acceptEncoding, contentEncoding))
+        {
+            continue;
+        }
+
+        // A decoded request path may contain any byte, but a content coding
+        // never contains a line feed, so leading with it keeps keys unique.
+        std::string encodedKey = contentEncoding + "\n" + key;
+
+        std::shared_ptr<const FileSystemCacheEntry> encoded = _encodedCache.get(encodedKey);
+
+        if (encoded != nullptr && isStale(*encoded))
+        {
+            _encodedCache.remove(encodedKey);
+            encoded = nullptr;
+        }
+
+        if (encoded == nullptr && isPrecompressed)
+        {
+            FileSystemCacheEntry prototype;
+            prototype.path = entry->path + encoding.second;
+            prototype.mediaType = entry->mediaType;
+            prototype.cacheControl = entry->cacheControl;
+            prototype.contentEncoding = contentEncoding;
+
+            encoded = _encodedCache.load(encodedKey, prototype);
+
+            if (encoded != nullptr && isStale(*encoded))
+            {
+                _encodedCache.remove(encodedKey);
+                encoded = nullptr;
+            }
+        }
+
+        if (encoded == nullptr && isCompressible)
+        {
+            // A conditional request for the compressed copy is answered
+            // without compressing the file, as no body will be sent.
+            auto unmodified = std::make_shared<FileSystemCacheEntry>();
+            unmodified->path = entry->path;
+            unmodified->info = entry->info;
+            unmodified->mediaType = entry->mediaType;
+            unmodified->lastModified = entry->lastModified;
+            unmodified->entityTag = FileSystemCache::makeEncodedEntityTag(entry->entityTag, contentEncoding);
+            unmodified->cacheControl = entry->cacheControl;
+            unmodified->contentEncoding = contentEncoding;
+
+            if (isNotModified(evt, *unmodified))
+            {
+                return unmodified;
+            }
+
+            encoded = compress(*entry);
+
+            // Remember incompressible files so they are not compressed again.
+            if (encoded == nullptr)
+            {
+                encoded = entry;
+            }
+
+            _encodedCache.insert(encodedKey, encoded);
+        }
+
+        if (encoded != nullptr)
+        {
+            return encoded;
+        }
+    }
+
+    return entry;
+}
+
+
+std::shared_ptr<const FileSystemCacheEntry> FileSystemRoute::compress(const FileSystemCacheEntry& entry) const
+{
+    std::ostringstream compressed;
+
+    Poco::DeflatingOutputStream deflater(compressed, Poco::DeflatingStreamBuf::STREAM_GZIP);
+
+    if (entry.hasContents)
+    {
+        deflater.write(entry.buffer.getData(), static_cast<std::streamsize>(entry.buffer.size()));
+    }
+    else
+    {
+        Poco::FileInputStream input(entry.path, std::ios::in | std::ios::binary);
+        Poco::StreamCopier::copyStream(input, deflater);
+    }
+
+    deflater.close();
+
+    std::string data = compressed.str();
+
+    if (data.size() >= entry.info.size)
+    {
+        return nullptr;
+    }
+
+    auto encoded = std::make_shared<FileSystemCacheEntry>();
+    encoded->path = entry.path;
+    encoded->info = entry.info;
+    encoded->mediaType = entry.mediaType;
+    encoded->lastModified = entry.lastModified;
+    encoded->entityTag = FileSystemCache::makeEncodedEntityTag(entry.entityTag, "gzip");
+    encoded->cacheControl = entry.cacheControl;
+    encoded->contentEncoding = "gzip";
+    encoded->hasContents = true;
+    encoded->buffer.set(data.data(), data.size());
+    return encoded;
+}
+
+
+void FileSystemRoute::sendEntry(ServerEventArgs& evt,
+                                const std::string& key,
+                                const FileSystemCacheEntry& entry)
+{
+    Poco::Net::HTTPServerResponse& response = evt.response();
+
+    response.set("ETag", entry.entityTag);
+    response.set("Last-Modified", entry.lastModified);
+
+    if (!entry.contentEncoding.empty())
+    {
+        response.set("Content-Encoding", entry.contentEncoding);
+    }
+
+    if (!entry.cacheControl.empty())
+    {
+        response.set("Cache-Control", entry.cacheControl);
+    }
+
+    if (isNotModified(evt, entry))
+    {
+        response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED);
+        response.send();
+        return;
+    }
+
+    if (entry.hasContents)
+    {
+        sendCachedFile(evt, entry);
+    }
+    else
+    {
+        sendDiskFile(evt, key, entry);
+    }
+}
+
+
+bool FileSystemRoute::isNotModified(ServerEventArgs& evt,
+                                    const FileSystemCacheEntry& entry) const
+{
+    const Poco::Net::HTTPServerRequest& request = evt.request();
+
+    if (request.getMethod() != Poco::Net::HTTPRequest::HTTP_GET
+    &&  request.getMethod() != Poco::Net::HTTPRequest::HTTP_HEAD)
+    {
+        return false;
+    }
+
+    // If-None-Match takes precedence over If-Modified-Since.
+    if (request.has("If-None-Match"))
+    {
+        return HTTPUtils::matchesEntityTag(request.get("If-None-Match"), entry.entityTag, true);
+    }
+
+    if (request.has("If-Modified-Since"))
+    {
+        Poco::DateTime ifModifiedSince;
+        int timeZoneDifferential = 0;
+
+        if (Poco::DateTimeParser::tryParse(Poco::DateTimeFormat::HTTP_FORMAT,
+                                           request.get("If-Modified-Since"),
+                                           ifModifiedSince,
+                                           timeZoneDifferential))
+        {
+            // HTTP dates have a resolution of one second.
+            Poco::Timestamp::TimeVal modifiedSeconds = entry.info.modified.epochTime();
+            Poco::Timestamp::TimeVal ifModifiedSinceSeconds = ifModifiedSince.timestamp().epochTime() - timeZoneDifferential;
+            return modifiedSeconds <= ifModifiedSinceSeconds;
+        }
+    }
+
+    return false;
+}
+
+
+void FileSystemRoute::sendCachedFile(ServerEventArgs& evt, const FileSystemCacheEntry& entry)
+{
+    sendRanges(evt, entry, [&](std::ostream& stream, uint64_t offset, uint64_t length)
+    {
+        sendBytes(evt, stream, entry.buffer.getData() + offset, static_cast<std::size_t>(length));
+    });
+}
+
+
+void FileSystemRoute::sendDiskFile(ServerEventArgs& evt,
+                                   const std::string& key,
+                                   const FileSystemCacheEntry& entry)
+{
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+    bool isUnencrypted = canSendFile(evt);
+
+    // Hold the ring, as setup() may replace it while the file is sent.
+    std::shared_ptr<FileSystemIOUring> currentIOUring = isUnencrypted ? ioUring() : nullptr;
+
+    bool useIOUring = currentIOUring != nullptr;
+
+    bool useSendFile = !useIOUring && isUnencrypted && _settings.getUseSendFile();
+
+    bool useMappedFile = !useIOUring
+                      && !useSendFile
+                      && _settings.getUseMemoryMappedFiles()
+                      && entry.info.size >= _settings.getMinimumMemoryMappedFileSize();
+
+    if (useIOUring || useSendFile || useMappedFile)
+    {
+        FileSystemCacheEntry current = entry;
+
+        int fd = openFile(evt, key, current);
+
+        try
+        {
+            if (useIOUring)
+            {
+                Poco::Net::StreamSocket& socket = dynamic_cast<Poco::Net::HTTPServerRequestImpl&>(evt.request()).socket();
+
+                // Bound each send as the blocking paths are bounded by the
+                // socket's send timeout.
+                Poco::Timespan timeout = socket.getSendTimeout();
+
+                sendRanges(evt, current, [&](std::ostream& stream, uint64_t offset, uint64_t length)
+                {
+                    // Anything buffered in the stream must precede the file data.
+                    stream.flush();
+                    currentIOUring->send(fd, socket.impl()->sockfd(), offset, length, timeout);
+                });
+            }
+            else if (useSendFile)
+            {
+                Poco::Net::StreamSocket& socket = dynamic_cast<Poco::Net::HTTPServerRequestImpl&>(evt.request()).socket();
+
+                sendRanges(evt, current, [&](std::ostream& stream, uint64_t offset, uint64_t length)
+                {
+                    // Anything buffered in the stream must precede the file data.
+                    stream.flush();
+                    sendFileRange(socket, fd, offset, length);
+                });
+            }
+            else
+            {
+                std::shared_ptr<const FileSystemMappedFile> file = _mappedFiles.map(current.path, fd, current.info);
+
+                sendRanges(evt, current, [&](std::ostream& stream, uint64_t offset, uint64_t length)
+                {
+                    sendMappedRange(evt, stream, *file, fd, offset, length);
+                });
+            }
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+
+        ::close(fd);
+        return;
+    }
+#endif
+
+    Poco::FileInputStream input(entry.path, std::ios::in | std::ios::binary);
+
+    sendRanges(evt, entry, [&](std::ostream& stream, uint64_t offset, uint64_t length)
+    {
+        input.clear();
+        input.seekg(static_cast<std::streamoff>(offset));
+
+        std::vector<char> buffer(static_cast<std::size_t>(std::min<uint64_t>(length, COPY_BUFFER_SIZE)));
+
+        while (length > 0)
+        {
+            input.read(buffer.data(), static_cast<std::streamsize>(std::min<uint64_t>(length, buffer.size())));
+
+            std::size_t n = static_cast<std::size_t>(input.gcount());
+
+            if (n == 0)
+            {
+                throw Poco::IOException("Unable to send file: the file was truncated.");
+            }
+
+            sendBytes(evt, stream, buffer.data(), n);
+            length -= n;
+        }
+    });
+}
+
+
+void FileSystemRoute::sendRanges(ServerEventArgs& evt,
+                                 const FileSystemCacheEntry& entry,
+                                 const BodyWriter& writeBody)
+{
+    Poco::Net::HTTPServerResponse& response = evt.response();
+
+    const std::string& mediaType = entry.mediaType;
+    uint64_t size = entry.info.size;
+
+    response.set("Accept-Ranges", "bytes");
+
+    std::vector<HTTPUtils::ByteRange> ranges;
+
+    bool isRangeRequest = evt.request().has("Range")
+                       && isIfRangeSatisfied(evt, entry)
+                       && HTTPUtils::parseByteRanges(evt.request().get("Range"), size, ranges);
+
+    if (isRangeRequest && ranges.empty())
+    {
+        response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_REQUESTED_RANGE_NOT_SATISFIABLE);
+        response.set("Content-Range", "bytes */" + std::to_string(size));
+        response.setContentLength(0);
+        response.send();
+        return;
+    }
+
+    // The part headers of a multipart response, and its closing delimiter.
+    std::vector<std::string> partHeaders;
+    std::string trailer;
+
+    if (!isRangeRequest)
+    {
+        response.setContentType(mediaType);
+        response.setContentLength64(static_cast<Poco::Int64>(size));
+
+        if (size > 0)
+        {
+            HTTPUtils::ByteRange range;
+            range.last = size - 1;
+            ranges.push_back(range);
+        }
+    }
+    else if (ranges.size() == 1)
+    {
+        const HTTPUtils::ByteRange& range = ranges.front();
+
+        response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_PARTIAL_CONTENT);
+        response.set("Content-Range", "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size));
+        response.setContentType(mediaType);
+        response.setContentLength64(static_cast<Poco::Int64>(range.length()));
+    }
+    else
+    {
+        std::string boundary = Poco::UUIDGenerator::defaultGenerator().createRandom().toString();
+
+        uint64_t contentLength = 0;
+
+        for (const HTTPUtils::ByteRange& range: ranges)
+        {
+            std::string header = partHeaders.empty() ? "" : "\r\n";
+            header += "--" + boundary + "\r\n";
+            header += "Content-Type: " + mediaType + "\r\n";
+            header += "Content-Range: bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size) + "\r\n";
+            header += "\r\n";
+
+            contentLength += header.size() + range.length();
+            partHeaders.push_back(header);
+        }
+
+        trailer = "\r\n--" + boundary + "--\r\n";
+        contentLength += trailer.size();
+
+        Poco::Net::MediaType multipart("multipart/byteranges");
+        multipart.setParameter("boundary", boundary);
+
+        response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_PARTIAL_CONTENT);
+        response.setContentType(multipart);
+        response.setContentLength64(static_cast<Poco::Int64>(contentLength));
+    }
+
+    std::ostream& stream = response.send();
+
+    if (evt.request().getMethod() == Poco::Net::HTTPRequest::HTTP_HEAD)
+    {
+        return;
+    }
+
+    try
+    {
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            if (!partHeaders.empty())
+            {
+                stream << partHeaders[i];
+            }
+
+            writeBody(stream, ranges[i].first, ranges[i].length());
+        }
+
+        stream << trailer;
+        stream.flush();
+    }
+    catch (const Poco::Exception& exc)
+    {
+        // The headers have been sent, so only the connection can be closed.
+        ofLogError("FileSystemRoute::sendRanges") << exc.displayText();
+        response.setKeepAlive(false);
+    }
+}
+
+
+bool FileSystemRoute::isIfRangeSatisfied(ServerEventArgs& evt,
+                                         const FileSystemCacheEntry& entry) const
+{
+    if (!evt.request().has("If-Range"))
+    {
+        return true;
+    }
+
+    const std::string& ifRange = evt.request().get("If-Range");
+
+    // An entity tag must match strongly and a date exactly, RFC 7233 3.2.
+    if (ifRange.find('"') != std::string::npos)
+    {
+        return HTTPUtils::matchesEntityTag(ifRange, entry.entityTag, false);
+    }
+
+    return ifRange == entry.lastModified;
+}
+
+
+int FileSystemRoute::openFile(ServerEventArgs& evt,
+                              const std::string& key,
+                              FileSystemCacheEntry& entry)
+{
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+    int fd = ::open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        if (errno == ENOENT || errno == ENOTDIR)
+        {
+            _cache.remove(key);
+            throw Poco::FileNotFoundException(entry.path);
+        }
+
+        throw Poco::OpenFileException(entry.path, std::strerror(errno));
+    }
+
+    FileSystemFileInfo info = FileSystemFileInfo::stat(fd);
+
+    if (!info.exists)
+    {
+        ::close(fd);
+        _cache.remove(key);
+        throw Poco::FileNotFoundException(entry.path);
+    }
+
+    // The file may have changed since the entry was last validated.
+    if (info != entry.info)
+    {
+        _cache.remove(key);
+        entry.info = info;
+        entry.lastModified = Poco::DateTimeFormatter::format(info.modified,
+                                                             Poco::DateTimeFormat::HTTP_FORMAT);
+        entry.entityTag.clear();
+        evt.response().erase("ETag");
+        evt.response().set("Last-Modified", entry.lastModified);
+    }
+
+    return fd;
+#else
+    throw Poco::NotImplementedException("File descriptors are not supported on this platform.");
+#endif
+}
+
+
+bool FileSystemRoute::canSendFile(ServerEventArgs& evt)
+{
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+    Poco::Net::HTTPServerRequestImpl* request = dynamic_cast<Poco::Net::HTTPServerRequestImpl*>(&evt.request());
+
+    // Encrypted sockets must write through the SSL layer.
+    return request != nullptr && !request->socket().secure();
+#else
+    return false;
+#endif
+}
+
+
+void FileSystemRoute::sendBytes(ServerEventArgs& evt,
+                                std::ostream& stream,
+                                const char* data,
+                                std::size_t size,
+                                std::size_t sliceSize)
+{
+    Poco::Net::HTTPServerRequestImpl* request = dynamic_cast<Poco::Net::HTTPServerRequestImpl*>(&evt.request());
+
+    if (request == nullptr)
+    {
+        stream.write(data, static_cast<std::streamsize>(size));
+        return;
+    }
+
+    // Anything buffered in the stream must precede these bytes.
+    stream.flush();
+
+    Poco::Net::StreamSocket& socket = request->socket();
+
+    while (size > 0)
+    {
+        int n = socket.sendBytes(data, static_cast<int>(std::min<std::size_t>(size, sliceSize)));
+
+        if (n <= 0)
+        {
+            throw Poco::IOException("Unable to send file.");
+        }
+
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+
+void FileSystemRoute::sendMappedRange(ServerEventArgs& evt,
+                                      std::ostream& stream,
+                                      const FileSystemMappedFile& file,
+                                      int fd,
+                                      uint64_t offset,
+                                      uint64_t length)
+{
+    while (length > 0)
+    {
+        std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(length, MAPPED_SLICE_SIZE));
+
+        // Reading a mapped page past the end of a truncated file raises
+        // SIGBUS, so the file must still hold the whole slice.
+        if (FileSystemFileInfo::stat(fd).size < offset + size)
+        {
+            throw Poco::IOException("Unable to send file: the file was truncated.");
+        }
+
+        sendBytes(evt, stream, file.data() + offset, size, MAPPED_SLICE_SIZE);
+
+        offset += size;
+        length -= size;
+    }
+}
+
+
+void FileSystemRoute::sendFileRange(Poco::Net::StreamSocket& socket,
+                                    int fd,
+                                    uint64_t offset,
+                                    uint64_t length)
+{
+#if defined(TARGET_LINUX)
+    // sendfile(2) takes no MSG_NOSIGNAL, so SIGPIPE is blocked on this thread
+    // while it runs. A SIGPIPE raised by a closed connection is consumed
+    // before the mask is restored, leaving only the EPIPE error.
+    sigset_t sigPipeSet;
+    sigemptyset(&sigPipeSet);
+    sigaddset(&sigPipeSet, SIGPIPE);
+
+    // A SIGPIPE that was already pending belongs to someone else.
+    sigset_t pendingSet;
+    sigpending(&pendingSet);
+    bool wasSigPipePending = sigismember(&pendingSet, SIGPIPE) == 1;
+
+    sigset_t previousMask;
+    pthread_sigmask(SIG_BLOCK, &sigPipeSet, &previousMask);
+
+    off_t position = static_cast<off_t>(offset);
+
+    int error = 0;
+    bool isTruncated = false;
+
+    while (length > 0)
+    {
+        // Linux transfers at most 0x7ffff000 bytes per call.
+        std::size_t count = static_cast<std::size_t>(std::min<uint64_t>(length, 0x7ffff000));
+
+        ssize_t n = ::sendfile(socket.impl()->sockfd(), fd, &position, count);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            error = errno;
+            break;
+        }
+
+        if (n == 0)
+        {
+            isTruncated = true;
+            break;
+        }
+
+        length -= static_cast<uint64_t>(n);
+    }
+
+    if (error == EPIPE && !wasSigPipePending)
+    {
+        struct timespec noWait = { 0, 0 };
+
+        while (sigtimedwait(&sigPipeSet, nullptr, &noWait) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+
+    if (error != 0)
+    {
+        throw Poco::IOException("Unable to send file: " + std::string(std::strerror(error)));
+    }
+
+    if (isTruncated)
+    {
+        throw Poco::IOException("Unable to send file: the file was truncated.");
+    }
+#elif defined(TARGET_OSX)
+    off_t position = static_cast<off_t>(offset);
+
+    while (length > 0)
+    {
+        off_t count = static_cast<off_t>(length);
+
+        // On return, count holds the number of bytes sent, even on error.
+        int result = ::sendfile(fd, socket.impl()->sockfd(), position, &count, nullptr, 0);
+
+        position += count;
+        length -= static_cast<uint64_t>(count);
+
+        if (result != 0)
+        {
+            if (errno == EINTR || (errno == EAGAIN && count > 0))
+            {
+                continue;
+            }
+
+            throw Poco::IOException("Unable to send file: " + std::string(std::strerror(errno)));
+        }
+
+        if (count == 0 && length > 0)
+        {
+            throw Poco::IOException("Unable to send file: the file was truncated.");
+        }
+    }
+#else
+    throw Poco::NotImplementedException("FileSystemRoute::sendFileRange");
+#endif
+}
+
+
 } } // namespace ofx::HTTP
@@ -6,6 +6,12 @@
 
 
 #include "ofx/HTTP/HTTPUtils.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "Poco/NumberParser.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
 
 
 namespace ofx {
@@ -154,4 +160,234 @@ std::streamsize HTTPUtils::consume(std::istream& stream)
 }
 
 
+bool HTTPUtils::parseByteRanges(const std::string& range,
+                                uint64_t size,
+                                std::vector<ByteRange>& ranges,
+                                std::size_t maximumRanges)
+{
+    ranges.clear();
+
+    std::size_t equals = range.find('=');
+
+    if (equals == std::string::npos
+    ||  Poco::icompare(Poco::trim(range.substr(0, equals)), "bytes") != 0)
+    {
+        return false;
+    }
+
+    Poco::StringTokenizer specifiers(range.substr(equals + 1),
+                                     ",",
+                                     Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+
+    if (specifiers.count() == 0 || specifiers.count() > maximumRanges)
+    {
+        return false;
+    }
+
+    for (const std::string& specifier: specifiers)
+    {
+        std::size_t dash = specifier.find('-');
+
+        if (dash == std::string::npos)
+        {
+            return false;
+        }
+
+        std::string firstString = specifier.substr(0, dash);
+        std::string lastString = specifier.substr(dash + 1);
+
+        Poco::UInt64 first = 0;
+        Poco::UInt64 last = 0;
+
+        if (firstString.empty())
+        {
+            // A suffix range, e.g. "-500" for the last 500 bytes.
+            if (!Poco::NumberParser::tryParseUnsigned64(lastString, last))
+            {
+                return false;
+            }
+
+            if (last > 0 && size > 0)
+            {
+                ByteRange byteRange;
+                byteRange.first = size - std::min<uint64_t>(last, size);
+                byteRange.last = size - 1;
+                ranges.push_back(byteRange);
+            }
+        }
+        else
+        {
+            if (!Poco::NumberParser::tryParseUnsigned64(firstString, first))
+            {
+                return false;
+            }
+
+            if (lastString.empty())
+            {
+                last = size > 0 ? size - 1 : 0;
+            }
+            else if (!Poco::NumberParser::tryParseUnsigned64(lastString, last) || last < first)
+            {
+                return false;
+            }
+
+            if (first < size)
+            {
+                ByteRange byteRange;
+                byteRange.first = first;
+                byteRange.last = std::min<uint64_t>(last, size - 1);
+                ranges.push_back(byteRange);
+            }
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange& a, const ByteRange& b)
+    {
+        return a.first < b.first;
+    });
+
+    std::vector<ByteRange> coalesced;
+
+    for (const ByteRange& byteRange: ranges)
+    {
+        if (!coalesced.empty() && byteRange.first <= coalesced.back().last + 1)
+        {
+            coalesced.back().last = std::max(coalesced.back().last, byteRange.last);
+        }
+        else
+        {
+            coalesced.push_back(byteRange);
+        }
+    }
+
+    ranges.swap(coalesced);
+
+    return true;
+}
+
+
+bool HTTPUtils::matchesEntityTag(const std::string& condition,
+                                 const std::string& entityTag,
+                                 bool weak)
+{
+    if (entityTag.empty())
+    {
+        return false;
+    }
+
+    if (Poco::trim(condition) == "*")
+    {
+        return true;
+    }
+
+    bool isWeak = entityTag.compare(0, 2, "W/") == 0;
+
+    if (!weak && isWeak)
+    {
+        return false;
+    }
+
+    std::string opaqueTag = isWeak ? entityTag.substr(2) : entityTag;
+
+    Poco::StringTokenizer candidates(condition,
+                                     ",",
+                                     Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+
+    for (const std::string& candidate: candidates)
+    {
+        bool isCandidateWeak = candidate.compare(0, 2, "W/") == 0;
+
+        if (isCandidateWeak && !weak)
+        {
+            continue;
+        }
+
+        if ((isCandidateWeak ? candidate.substr(2) : candidate) == opaqueTag)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool HTTPUtils::acceptsEncoding(const std::string& acceptEncoding,
+                                const std::string& contentCoding)
+{
+    Poco::StringTokenizer codings(acceptEncoding,
+                                  ",",
+                                  Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+
+    bool hasWildcard = false;
+    bool acceptsWildcard = false;
+
+    for (const std::string& coding: codings)
+    {
+        std::size_t semicolon = coding.find(';');
+
+        std::string name = Poco::trim(coding.substr(0, semicolon));
+
+        double quality = 1;
+
+        if (semicolon != std::string::npos)
+        {
+            std::string parameter = Poco::trim(coding.substr(semicolon + 1));
+
+            if (parameter.size() > 2
+            &&  Poco::icompare(parameter.substr(0, 2), "q=") == 0
+            &&  !Poco::NumberParser::tryParseFloat(parameter.substr(2), quality))
+            {
+                quality = 0;
+            }
+        }
+
+        if (Poco::icompare(name, contentCoding) == 0)
+        {
+            return quality > 0;
+        }
+        else if (name == "*")
+        {
+            hasWildcard = true;
+            acceptsWildcard = quality > 0;
+        }
+    }
+
+    return hasWildcard && acceptsWildcard;
+}
+
+
+std::shared_ptr<const std::string> HTTPUtils::getErrorPage(int status,
+                                                           const std::string& reason)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const std::string>> pages;
+
+    std::string title = std::to_string(status) + " - " + reason;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto iter = pages.find(title);
+
+    if (iter != pages.end())
+    {
+        return iter->second;
+    }
+
+    auto page = std::make_shared<const std::string>("<!DOCTYPE html><html><head><meta charset=\"utf-8\"/><title>"
+                                                    + title
+                                                    + "</title></head><body><h1>"
+                                                    + title
+                                                    + "</h1></body></html>");
+
+    // Custom reasons are not cached without bound.
+    if (pages.size() < MAXIMUM_CACHED_ERROR_PAGES)
+    {
+        pages[title] = page;
+    }
+
+    return page;
+}
+
+
 } } // namespace ofx::HTTP
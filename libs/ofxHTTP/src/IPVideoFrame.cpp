@@ -115,4 +115,22 @@ ofBuffer& IPVideoFrame::buffer()
 }
 
 
+const ofBuffer& IPVideoFrame::buffer() const
+{
+    return _buffer;
+}
+
+
+void IPVideoFrame::setHeader(const std::string& header)
+{
+    _header = header;
+}
+
+
+const std::string& IPVideoFrame::header() const
+{
+    return _header;
+}
+
+
 } } // namespace ofx::HTTP
@@ -0,0 +1,657 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoJPEGEncoder.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+
+#undef min // for windows
+#undef max // for windows
+
+
+namespace ofx {
+namespace HTTP {
+
+
+// The zigzag order of the coefficients in an 8x8 block.
+static const uint8_t ZIGZAG[64] =
+{
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+
+// The standard quantization tables from Annex K of the JPEG specification.
+static const uint8_t LUMINANCE_QUANTIZATION[64] =
+{
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99
+};
+
+
+static const uint8_t CHROMINANCE_QUANTIZATION[64] =
+{
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+
+// The standard Huffman tables from Annex K of the JPEG specification.
+static const uint8_t DC_LUMINANCE_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t DC_LUMINANCE_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t DC_CHROMINANCE_BITS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t DC_CHROMINANCE_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t AC_LUMINANCE_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t AC_LUMINANCE_VALUES[162] =
+{
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+static const uint8_t AC_CHROMINANCE_BITS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t AC_CHROMINANCE_VALUES[162] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+
+// The AAN DCT scale factors.
+static const float AAN_SCALE[8] =
+{
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+
+/// A Huffman code table indexed by symbol.
+struct HuffmanTable
+{
+    uint16_t codes[256];
+    uint8_t sizes[256];
+
+    HuffmanTable(const uint8_t* bits, const uint8_t* values)
+    {
+        std::fill(codes, codes + 256, 0);
+        std::fill(sizes, sizes + 256, 0);
+
+        uint16_t code = 0;
+        std::size_t k = 0;
+
+        for (std::size_t length = 1; length <= 16; ++length)
+        {
+            for (std::size_t i = 0; i < bits[length - 1]; ++i)
+            {
+                codes[values[k]] = code++;
+                sizes[values[k]] = static_cast<uint8_t>(length);
+                ++k;
+            }
+
+            code <<= 1;
+        }
+    }
+};
+
+
+static const HuffmanTable DC_LUMINANCE(DC_LUMINANCE_BITS, DC_LUMINANCE_VALUES);
+static const HuffmanTable AC_LUMINANCE(AC_LUMINANCE_BITS, AC_LUMINANCE_VALUES);
+static const HuffmanTable DC_CHROMINANCE(DC_CHROMINANCE_BITS, DC_CHROMINANCE_VALUES);
+static const HuffmanTable AC_CHROMINANCE(AC_CHROMINANCE_BITS, AC_CHROMINANCE_VALUES);
+
+
+/// Writes entropy coded bits with 0xFF byte stuffing.
+class BitWriter
+{
+public:
+    BitWriter(std::string& output): _output(output)
+    {
+    }
+
+    void write(uint32_t bits, uint32_t count)
+    {
+        _buffer = (_buffer << count) | (bits & ((1u << count) - 1));
+        _count += count;
+
+        while (_count >= 8)
+        {
+            _count -= 8;
+            writeByte(static_cast<uint8_t>(_buffer >> _count));
+        }
+    }
+
+    /// Pad the last byte with 1 bits.
+    void flush()
+    {
+        if (_count > 0)
+        {
+            write(0x7F, 8 - _count);
+        }
+
+        _buffer = 0;
+    }
+
+private:
+    void writeByte(uint8_t byte)
+    {
+        _output.push_back(static_cast<char>(byte));
+
+        if (byte == 0xFF)
+        {
+            _output.push_back(0);
+        }
+    }
+
+    std::string& _output;
+    uint32_t _buffer = 0;
+    uint32_t _count = 0;
+
+};
+
+
+static void scaleQuantizationTable(const uint8_t* table, int quality, uint8_t* scaled, float* divisors)
+{
+    quality = std::min(std::max(quality, 1), 100);
+
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        int value = std::min(std::max((table[i] * scale + 50) / 100, 1), 255);
+        scaled[i] = static_cast<uint8_t>(value);
+        divisors[i] = 1.0f / (value * AAN_SCALE[i / 8] * AAN_SCALE[i % 8] * 8.0f);
+    }
+}
+
+
+static void forwardDCT(float* d, std::size_t stride)
+{
+    float tmp0 = d[0] + d[stride * 7];
+    float tmp7 = d[0] - d[stride * 7];
+    float tmp1 = d[stride] + d[stride * 6];
+    float tmp6 = d[stride] - d[stride * 6];
+    float tmp2 = d[stride * 2] + d[stride * 5];
+    float tmp5 = d[stride * 2] - d[stride * 5];
+    float tmp3 = d[stride * 3] + d[stride * 4];
+    float tmp4 = d[stride * 3] - d[stride * 4];
+
+    // Even part.
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+
+    d[0] = tmp10 + tmp11;
+    d[stride * 4] = tmp10 - tmp11;
+
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[stride * 2] = tmp13 + z1;
+    d[stride * 6] = tmp13 - z1;
+
+    // Odd part.
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = tmp10 * 0.541196100f + z5;
+    float z4 = tmp12 * 1.306562965f + z5;
+    float z3 = tmp11 * 0.707106781f;
+
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+
+    d[stride * 5] = z13 + z2;
+    d[stride * 3] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[stride * 7] = z11 - z4;
+}
+
+
+static void encodeBlock(BitWriter& writer,
+                        float* block,
+                        const float* divisors,
+                        int& previousDC,
+                        const HuffmanTable& dc,
+                        const HuffmanTable& ac)
+{
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        forwardDCT(block + i * 8, 1);
+    }
+
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        forwardDCT(block + i, 8);
+    }
+
+    int coefficients[64];
+
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        std::size_t j = ZIGZAG[i];
+        long value = std::lround(block[j] * divisors[j]);
+
+        // Baseline JPEG coefficients are limited to 11 bits.
+        coefficients[i] = static_cast<int>(std::min(std::max(value, -1023L), 1023L));
+    }
+
+    auto writeValue = [&writer](int value, const HuffmanTable& table, uint8_t run)
+    {
+        int magnitude = value < 0 ? -value : value;
+        uint32_t size = 0;
+
+        while (magnitude > 0)
+        {
+            ++size;
+            magnitude >>= 1;
+        }
+
+        uint8_t symbol = static_cast<uint8_t>((run << 4) | size);
+
+        writer.write(table.codes[symbol], table.sizes[symbol]);
+
+        if (size > 0)
+        {
+            writer.write(static_cast<uint32_t>(value < 0 ? value - 1 : value), size);
+        }
+    };
+
+    writeValue(coefficients[0] - previousDC, dc, 0);
+    previousDC = coefficients[0];
+
+    int last = 63;
+
+    while (last > 0 && coefficients[last] == 0)
+    {
+        --last;
+    }
+
+    uint8_t run = 0;
+
+    for (int i = 1; i <= last; ++i)
+    {
+        if (coefficients[i] == 0)
+        {
+            if (++run == 16)
+            {
+                writer.write(ac.codes[0xF0], ac.sizes[0xF0]);
+                run = 0;
+            }
+        }
+        else
+        {
+            writeValue(coefficients[i], ac, run);
+            run = 0;
+        }
+    }
+
+    if (last < 63)
+    {
+        writer.write(ac.codes[0x00], ac.sizes[0x00]);
+    }
+}
+
+
+static void writeMarker(std::string& output, uint8_t marker, std::size_t length)
+{
+    output.push_back(static_cast<char>(0xFF));
+    output.push_back(static_cast<char>(marker));
+    output.push_back(static_cast<char>((length >> 8) & 0xFF));
+    output.push_back(static_cast<char>(length & 0xFF));
+}
+
+
+static void writeHuffmanTable(std::string& output,
+                              uint8_t tableClassAndId,
+                              const uint8_t* bits,
+                              const uint8_t* values,
+                              std::size_t numValues)
+{
+    output.push_back(static_cast<char>(tableClassAndId));
+    output.append(reinterpret_cast<const char*>(bits), 16);
+    output.append(reinterpret_cast<const char*>(values), numValues);
+}
+
+
+bool IPVideoJPEGEncoder::encode(const ofPixels& pixels,
+                                ofBuffer& buffer,
+                                ofImageQualityType quality,
+                                std::size_t maxThreads,
+                                IPVideoWorkerPool* workerPool)
+{
+    bool isBGR = false;
+
+    switch (pixels.getPixelFormat())
+    {
+        case OF_PIXELS_GRAY:
+        case OF_PIXELS_RGB:
+            break;
+        case OF_PIXELS_BGR:
+            isBGR = true;
+            break;
+        default:
+            return false;
+    }
+
+    std::vector<std::string> segments;
+
+    if (!encode(pixels.getData(),
+                pixels.getWidth(),
+                pixels.getHeight(),
+                pixels.getNumChannels(),
+                pixels.getBytesStride(),
+                isBGR,
+                toJPEGQuality(quality),
+                maxThreads,
+                segments,
+                workerPool))
+    {
+        return false;
+    }
+
+    for (const auto& segment: segments)
+    {
+        buffer.append(segment.data(), segment.size());
+    }
+
+    return true;
+}
+
+
+bool IPVideoJPEGEncoder::encode(const unsigned char* data,
+                                std::size_t width,
+                                std::size_t height,
+                                std::size_t numChannels,
+                                std::size_t rowStride,
+                                bool isBGR,
+                                int quality,
+                                std::size_t maxThreads,
+                                std::vector<std::string>& segments,
+                                IPVideoWorkerPool* workerPool)
+{
+    if (data == nullptr
+    ||  width == 0
+    ||  height == 0
+    ||  width > 65535
+    ||  height > 65535
+    ||  (numChannels != 1 && numChannels != 3))
+    {
+        return false;
+    }
+
+    const bool isColor = numChannels == 3;
+    const std::size_t mcuSize = isColor ? 16 : 8;
+    const std::size_t mcusPerRow = (width + mcuSize - 1) / mcuSize;
+    const std::size_t mcuRows = (height + mcuSize - 1) / mcuSize;
+
+    if (mcusPerRow > 65535)
+    {
+        return false;
+    }
+
+    uint8_t luminanceTable[64];
+    uint8_t chrominanceTable[64];
+    float luminanceDivisors[64];
+    float chrominanceDivisors[64];
+
+    scaleQuantizationTable(LUMINANCE_QUANTIZATION, quality, luminanceTable, luminanceDivisors);
+    scaleQuantizationTable(CHROMINANCE_QUANTIZATION, quality, chrominanceTable, chrominanceDivisors);
+
+    const std::size_t numComponents = isColor ? 3 : 1;
+
+    // Headers.
+    std::string header;
+
+    header.append("\xFF\xD8", 2);
+
+    writeMarker(header, 0xE0, 16);
+    header.append("JFIF\0\x01\x01\x00\x00\x01\x00\x01\x00\x00", 14);
+
+    writeMarker(header, 0xDB, 2 + 65 * (isColor ? 2 : 1));
+    header.push_back(0);
+
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        header.push_back(static_cast<char>(luminanceTable[ZIGZAG[i]]));
+    }
+
+    if (isColor)
+    {
+        header.push_back(1);
+
+        for (std::size_t i = 0; i < 64; ++i)
+        {
+            header.push_back(static_cast<char>(chrominanceTable[ZIGZAG[i]]));
+        }
+    }
+
+    writeMarker(header, 0xC0, 8 + 3 * numComponents);
+    header.push_back(8);
+    header.push_back(static_cast<char>((height >> 8) & 0xFF));
+    header.push_back(static_cast<char>(height & 0xFF));
+    header.push_back(static_cast<char>((width >> 8) & 0xFF));
+    header.push_back(static_cast<char>(width & 0xFF));
+    header.push_back(static_cast<char>(numComponents));
+
+    if (isColor)
+    {
+        header.append("\x01\x22\x00\x02\x11\x01\x03\x11\x01", 9);
+    }
+    else
+    {
+        header.append("\x01\x11\x00", 3);
+    }
+
+    writeMarker(header, 0xC4, 2 + (17 + 12) * (isColor ? 2 : 1) + (17 + 162) * (isColor ? 2 : 1));
+    writeHuffmanTable(header, 0x00, DC_LUMINANCE_BITS, DC_LUMINANCE_VALUES, 12);
+    writeHuffmanTable(header, 0x10, AC_LUMINANCE_BITS, AC_LUMINANCE_VALUES, 162);
+
+    if (isColor)
+    {
+        writeHuffmanTable(header, 0x01, DC_CHROMINANCE_BITS, DC_CHROMINANCE_VALUES, 12);
+        writeHuffmanTable(header, 0x11, AC_CHROMINANCE_BITS, AC_CHROMINANCE_VALUES, 162);
+    }
+
+    // Every MCU row is a restart interval.
+    writeMarker(header, 0xDD, 4);
+    header.push_back(static_cast<char>((mcusPerRow >> 8) & 0xFF));
+    header.push_back(static_cast<char>(mcusPerRow & 0xFF));
+
+    writeMarker(header, 0xDA, 6 + 2 * numComponents);
+    header.push_back(static_cast<char>(numComponents));
+
+    if (isColor)
+    {
+        header.append("\x01\x00\x02\x11\x03\x11", 6);
+    }
+    else
+    {
+        header.append("\x01\x00", 2);
+    }
+
+    header.append("\x00\x3F\x00", 3);
+
+    // Entropy coded bands.
+    if (maxThreads == 0)
+    {
+        maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    std::size_t numBands = std::max(std::min(maxThreads, mcuRows / MIN_BAND_MCU_ROWS),
+                                    std::size_t(1));
+
+    std::size_t rowsPerBand = (mcuRows + numBands - 1) / numBands;
+
+    segments.assign(numBands + 2, std::string());
+    segments.front().swap(header);
+    segments.back().assign("\xFF\xD9", 2);
+
+    const std::size_t redIndex = isBGR ? 2 : 0;
+    const std::size_t blueIndex = isBGR ? 0 : 2;
+
+    auto encodeRows = [&](std::size_t row0, std::size_t row1, std::string& output)
+    {
+        output.reserve((row1 - row0) * mcusPerRow * mcuSize * mcuSize / 4);
+
+        BitWriter writer(output);
+
+        float y[4][64];
+        float cb[64];
+        float cr[64];
+
+        for (std::size_t row = row0; row < row1; ++row)
+        {
+            int previousY = 0;
+            int previousCb = 0;
+            int previousCr = 0;
+
+            for (std::size_t mcu = 0; mcu < mcusPerRow; ++mcu)
+            {
+                std::size_t x0 = mcu * mcuSize;
+                std::size_t y0 = row * mcuSize;
+
+                if (isColor)
+                {
+                    std::fill(cb, cb + 64, 0.0f);
+                    std::fill(cr, cr + 64, 0.0f);
+
+                    for (std::size_t py = 0; py < 16; ++py)
+                    {
+                        // Replicate the edge pixels to fill partial MCUs.
+                        const unsigned char* line = data + std::min(y0 + py, height - 1) * rowStride;
+
+                        for (std::size_t px = 0; px < 16; ++px)
+                        {
+                            const unsigned char* p = line + std::min(x0 + px, width - 1) * 3;
+
+                            float r = p[redIndex];
+                            float g = p[1];
+                            float b = p[blueIndex];
+
+                            std::size_t block = (py / 8) * 2 + px / 8;
+                            std::size_t i = (py % 8) * 8 + px % 8;
+                            std::size_t c = (py / 2) * 8 + px / 2;
+
+                            y[block][i] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+                            cb[c] += (-0.168736f * r - 0.331264f * g + 0.5f * b) * 0.25f;
+                            cr[c] += (0.5f * r - 0.418688f * g - 0.081312f * b) * 0.25f;
+                        }
+                    }
+
+                    for (std::size_t block = 0; block < 4; ++block)
+                    {
+                        encodeBlock(writer, y[block], luminanceDivisors, previousY, DC_LUMINANCE, AC_LUMINANCE);
+                    }
+
+                    encodeBlock(writer, cb, chrominanceDivisors, previousCb, DC_CHROMINANCE, AC_CHROMINANCE);
+                    encodeBlock(writer, cr, chrominanceDivisors, previousCr, DC_CHROMINANCE, AC_CHROMINANCE);
+                }
+                else
+                {
+                    for (std::size_t py = 0; py < 8; ++py)
+                    {
+                        const unsigned char* line = data + std::min(y0 + py, height - 1) * rowStride;
+
+                        for (std::size_t px = 0; px < 8; ++px)
+                        {
+                            y[0][py * 8 + px] = line[std::min(x0 + px, width - 1)] - 128.0f;
+                        }
+                    }
+
+                    encodeBlock(writer, y[0], luminanceDivisors, previousY, DC_LUMINANCE, AC_LUMINANCE);
+                }
+            }
+
+            writer.flush();
+
+            // Restart markers separate the rows and cycle through RST0 - RST7.
+            if (row + 1 < mcuRows)
+            {
+                output.push_back(static_cast<char>(0xFF));
+                output.push_back(static_cast<char>(0xD0 + (row & 7)));
+            }
+        }
+    };
+
+    if (workerPool == nullptr)
+    {
+        workerPool = &IPVideoWorkerPool::defaultPool();
+    }
+
+    workerPool->run(numBands, [&](std::size_t band)
+    {
+        std::size_t row0 = std::min(band * rowsPerBand, mcuRows);
+        std::size_t row1 = std::min(row0 + rowsPerBand, mcuRows);
+
+        if (row0 < row1)
+        {
+            encodeRows(row0, row1, segments[band + 1]);
+        }
+    });
+
+    return true;
+}
+
+
+int IPVideoJPEGEncoder::toJPEGQuality(ofImageQualityType quality)
+{
+    switch (quality)
+    {
+        case OF_IMAGE_QUALITY_BEST:
+            return 100;
+        case OF_IMAGE_QUALITY_HIGH:
+            return 75;
+        case OF_IMAGE_QUALITY_MEDIUM:
+            return 50;
+        case OF_IMAGE_QUALITY_LOW:
+            return 25;
+        case OF_IMAGE_QUALITY_WORST:
+            return 10;
+    }
+
+    return 75;
+}
+
+
+} } // namespace ofx::HTTP
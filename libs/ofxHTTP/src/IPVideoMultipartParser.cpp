@@ -0,0 +1,238 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoMultipartParser.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberParser.h"
+#include "Poco/String.h"
+#include "Poco/Net/MediaType.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+IPVideoMultipartParser::IPVideoMultipartParser(const std::string& boundary):
+    _boundary(boundary)
+{
+}
+
+
+IPVideoMultipartParser::~IPVideoMultipartParser()
+{
+}
+
+
+bool IPVideoMultipartParser::next(std::istream& stream, ofBuffer& part)
+{
+    std::string line;
+
+    // Skip the preamble or the line ending that follows the previous body.
+    while (!_hasPendingBoundary)
+    {
+        if (!readLine(stream, line))
+        {
+            return false;
+        }
+
+        _hasPendingBoundary = isBoundary(line, _isFinal);
+    }
+
+    _hasPendingBoundary = false;
+
+    if (_isFinal)
+    {
+        return false;
+    }
+
+    int64_t contentLength = -1;
+
+    while (true)
+    {
+        if (!readLine(stream, line))
+        {
+            return false;
+        }
+
+        if (line.empty())
+        {
+            break;
+        }
+
+        std::size_t colon = line.find(':');
+
+        if (colon != std::string::npos
+        &&  Poco::icompare(Poco::trim(line.substr(0, colon)), "Content-Length") == 0)
+        {
+            Poco::Int64 value = 0;
+
+            if (!Poco::NumberParser::tryParse64(Poco::trim(line.substr(colon + 1)), value)
+            ||  value < 0
+            ||  value > MAX_PART_SIZE)
+            {
+                throw Poco::DataFormatException("Invalid part Content-Length: " + line);
+            }
+
+            contentLength = value;
+        }
+    }
+
+    if (contentLength < 0)
+    {
+        return readUntilBoundary(stream, part);
+    }
+
+    part.allocate(static_cast<std::size_t>(contentLength));
+    stream.read(part.getData(), contentLength);
+
+    return stream.gcount() == contentLength;
+}
+
+
+std::string IPVideoMultipartParser::boundary(const std::string& contentType)
+{
+    Poco::Net::MediaType mediaType(contentType);
+    return mediaType.hasParameter("boundary") ? mediaType.getParameter("boundary") : "";
+}
+
+
+bool IPVideoMultipartParser::readLine(std::istream& stream, std::string& line)
+{
+    line.clear();
+
+    std::istream::int_type c;
+
+    while ((c = stream.get()) != std::istream::traits_type::eof())
+    {
+        if (c == '\n')
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            return true;
+        }
+
+        line.push_back(static_cast<char>(c));
+
+        if (line.size() > MAX_LINE_LENGTH)
+        {
+            throw Poco::DataFormatException("Multipart line too long.");
+        }
+    }
+
+    return false;
+}
+
+
+bool IPVideoMultipartParser::isBoundary(const std::string& line, bool& isFinal) const
+{
+    std::string trimmed = Poco::trimRight(line);
+
+    for (const std::string& delimiter: { "--" + _boundary, _boundary })
+    {
+        if (trimmed == delimiter)
+        {
+            isFinal = false;
+            return true;
+        }
+        else if (trimmed == delimiter + "--")
+        {
+            isFinal = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool IPVideoMultipartParser::readUntilBoundary(std::istream& stream, ofBuffer& part)
+{
+    std::string body;
+    std::string line;
+
+    // Read line by line, since a boundary always begins a new line. The
+    // line ending before the boundary belongs to the boundary.
+    while (true)
+    {
+        line.clear();
+
+        std::istream::int_type c;
+
+        while ((c = stream.get()) != std::istream::traits_type::eof())
+        {
+            line.push_back(static_cast<char>(c));
+
+            if (c == '\n')
+            {
+                break;
+            }
+
+            // Binary data may contain no line endings at all, so the limit
+            // must be enforced while the line is read.
+            if (body.size() + line.size() > MAX_PART_SIZE)
+            {
+                throw Poco::DataFormatException("Multipart part too large.");
+            }
+        }
+
+        if (line.empty())
+        {
+            return false;
+        }
+
+        std::string content = line;
+
+        if (!content.empty() && content.back() == '\n')
+        {
+            content.pop_back();
+        }
+
+        if (!content.empty() && content.back() == '\r')
+        {
+            content.pop_back();
+        }
+
+        if (content.size() <= MAX_LINE_LENGTH && isBoundary(content, _isFinal))
+        {
+            // Remove the line ending that precedes the boundary.
+            if (!body.empty() && body.back() == '\n')
+            {
+                body.pop_back();
+            }
+
+            if (!body.empty() && body.back() == '\r')
+            {
+                body.pop_back();
+            }
+
+            _hasPendingBoundary = true;
+            break;
+        }
+
+        body += line;
+
+        if (body.size() > MAX_PART_SIZE)
+        {
+            throw Poco::DataFormatException("Multipart part too large.");
+        }
+
+        if (c == std::istream::traits_type::eof())
+        {
+            return false;
+        }
+    }
+
+    part.set(body.data(), body.size());
+
+    return true;
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoPixelPool.h"
+#include <algorithm>
+
+
+namespace ofx {
+namespace HTTP {
+
+
+IPVideoPixelPool::IPVideoPixelPool(std::size_t maxIdle):
+    _state(std::make_shared<State>())
+{
+    _state->maxIdle = maxIdle;
+}
+
+
+IPVideoPixelPool::~IPVideoPixelPool()
+{
+}
+
+
+std::shared_ptr<ofPixels> IPVideoPixelPool::acquire(std::size_t width,
+                                                    std::size_t height,
+                                                    ofPixelFormat format)
+{
+    std::unique_ptr<ofPixels> pixels;
+
+    {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+
+        auto& idle = _state->idle;
+
+        auto iter = std::find_if(idle.begin(), idle.end(), [&](const std::unique_ptr<ofPixels>& candidate)
+        {
+            return candidate->getWidth() == width
+                && candidate->getHeight() == height
+                && candidate->getPixelFormat() == format;
+        });
+
+        // Reuse any idle buffer if none match, replacing its allocation.
+        if (iter == idle.end() && !idle.empty())
+        {
+            iter = idle.begin();
+        }
+
+        if (iter != idle.end())
+        {
+            pixels = std::move(*iter);
+            idle.erase(iter);
+        }
+    }
+
+    if (pixels == nullptr)
+    {
+        pixels = std::make_unique<ofPixels>();
+    }
+
+    if (pixels->getWidth() != width
+    ||  pixels->getHeight() != height
+    ||  pixels->getPixelFormat() != format)
+    {
+        pixels->allocate(width, height, format);
+    }
+
+    std::weak_ptr<State> state = _state;
+
+    return std::shared_ptr<ofPixels>(pixels.release(), [state](ofPixels* released)
+    {
+        release(state, released);
+    });
+}
+
+
+std::size_t IPVideoPixelPool::numIdle() const
+{
+    std::unique_lock<std::mutex> lock(_state->mutex);
+    return _state->idle.size();
+}
+
+
+void IPVideoPixelPool::release(const std::weak_ptr<State>& state, ofPixels* pixels)
+{
+    std::unique_ptr<ofPixels> released(pixels);
+
+    std::shared_ptr<State> lockedState = state.lock();
+
+    if (lockedState != nullptr)
+    {
+        std::unique_lock<std::mutex> lock(lockedState->mutex);
+
+        if (lockedState->idle.size() < lockedState->maxIdle)
+        {
+            lockedState->idle.push_back(std::move(released));
+        }
+    }
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,364 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoRecorder.h"
+#include <iomanip>
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "ofUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+const std::string IPVideoRecorder::INDEX_FILE_NAME = "index.bin";
+const std::string IPVideoRecorder::SEGMENT_FILE_EXTENSION = ".mjpeg";
+
+
+IPVideoRecorder::IPVideoRecorder(IPVideoRoute& route,
+                                 const std::string& streamName):
+    _stream(route.findOrCreateStream(streamName))
+{
+    _stream->addListener(this);
+}
+
+
+IPVideoRecorder::~IPVideoRecorder()
+{
+    _stream->removeListener(this);
+    stop();
+}
+
+
+bool IPVideoRecorder::start(const std::string& directory,
+                            uint64_t maxSegmentSize,
+                            std::size_t maxQueueSize)
+{
+    stop();
+
+    std::string absoluteDirectory = ofToDataPath(directory, true);
+
+    try
+    {
+        Poco::File(absoluteDirectory).createDirectories();
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogError("IPVideoRecorder::start") << "Unable to create directory: " << exc.displayText();
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _directory = absoluteDirectory;
+    _maxSegmentSize = std::max(maxSegmentSize, uint64_t(1));
+    _maxQueueSize = std::max(maxQueueSize, std::size_t(1));
+    _framesRecorded = 0;
+    _framesDropped = 0;
+    _bytesRecorded = 0;
+    _isRecording = true;
+
+    _thread = std::thread(&IPVideoRecorder::run, this);
+
+    return true;
+}
+
+
+void IPVideoRecorder::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRecording = false;
+    }
+
+    _condition.notify_all();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+
+bool IPVideoRecorder::isRecording() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _isRecording;
+}
+
+
+void IPVideoRecorder::frameEncoded(const IPVideoStream&,
+                                   std::shared_ptr<IPVideoFrame> frame,
+                                   uint64_t)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (!_isRecording)
+        {
+            return;
+        }
+
+        _queue.push_back(frame);
+
+        while (_queue.size() > _maxQueueSize)
+        {
+            _queue.pop_front();
+            ++_framesDropped;
+        }
+    }
+
+    _condition.notify_one();
+}
+
+
+bool IPVideoRecorder::isListening() const
+{
+    return isRecording();
+}
+
+
+uint64_t IPVideoRecorder::framesRecorded() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesRecorded;
+}
+
+
+uint64_t IPVideoRecorder::framesDropped() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesDropped;
+}
+
+
+uint64_t IPVideoRecorder::bytesRecorded() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _bytesRecorded;
+}
+
+
+std::string IPVideoRecorder::indexPath(const std::string& directory)
+{
+    return Poco::Path(Poco::Path(directory).makeDirectory(), INDEX_FILE_NAME).toString();
+}
+
+
+std::string IPVideoRecorder::segmentPath(const std::string& directory,
+                                         uint32_t segment)
+{
+    std::stringstream name;
+    name << "segment-" << std::setw(5) << std::setfill('0') << segment << SEGMENT_FILE_EXTENSION;
+    return Poco::Path(Poco::Path(directory).makeDirectory(), name.str()).toString();
+}
+
+
+void IPVideoRecorder::writeIndexEntry(std::ostream& stream, const IndexEntry& entry)
+{
+    char bytes[INDEX_ENTRY_SIZE];
+
+    auto write = [&bytes](std::size_t offset, uint64_t value, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            bytes[offset + i] = static_cast<char>((value >> (8 * (size - 1 - i))) & 0xFF);
+        }
+    };
+
+    write(0, entry.timestamp, 8);
+    write(8, entry.segment, 4);
+    write(12, entry.offset, 8);
+    write(20, entry.size, 4);
+
+    stream.write(bytes, INDEX_ENTRY_SIZE);
+}
+
+
+bool IPVideoRecorder::readIndexEntry(std::istream& stream,
+                                     std::size_t position,
+                                     IndexEntry& entry)
+{
+    unsigned char bytes[INDEX_ENTRY_SIZE];
+
+    stream.clear();
+    stream.seekg(static_cast<std::streamoff>(position * INDEX_ENTRY_SIZE));
+    stream.read(reinterpret_cast<char*>(bytes), INDEX_ENTRY_SIZE);
+
+    if (stream.gcount() != INDEX_ENTRY_SIZE)
+    {
+        return false;
+    }
+
+    auto read = [&bytes](std::size_t offset, std::size_t size)
+    {
+        uint64_t value = 0;
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            value = (value << 8) | bytes[offset + i];
+        }
+
+        return value;
+    };
+
+    entry.timestamp = read(0, 8);
+    entry.segment = static_cast<uint32_t>(read(8, 4));
+    entry.offset = read(12, 8);
+    entry.size = static_cast<uint32_t>(read(20, 4));
+
+    return true;
+}
+
+
+std::size_t IPVideoRecorder::numIndexEntries(std::istream& stream)
+{
+    stream.clear();
+    stream.seekg(0, std::ios::end);
+    std::streamoff size = stream.tellg();
+    return size > 0 ? static_cast<std::size_t>(size) / INDEX_ENTRY_SIZE : 0;
+}
+
+
+std::size_t IPVideoRecorder::findIndexEntry(std::istream& stream, uint64_t timestamp)
+{
+    std::size_t first = 0;
+    std::size_t last = numIndexEntries(stream);
+
+    // Entries are written in time order, so binary search for the lower bound.
+    while (first < last)
+    {
+        std::size_t middle = first + (last - first) / 2;
+
+        IndexEntry entry;
+
+        if (!readIndexEntry(stream, middle, entry))
+        {
+            break;
+        }
+
+        if (entry.timestamp < timestamp)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+
+void IPVideoRecorder::run()
+{
+    std::string directory;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        directory = _directory;
+    }
+
+    std::ofstream index(indexPath(directory), std::ios::binary | std::ios::trunc);
+
+    if (!index)
+    {
+        ofLogError("IPVideoRecorder::run") << "Unable to open index: " << indexPath(directory);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRecording = false;
+        return;
+    }
+
+    std::ofstream segment;
+    IndexEntry entry;
+    uint64_t firstTimestamp = 0;
+    bool isFirstFrame = true;
+
+    while (true)
+    {
+        std::shared_ptr<IPVideoFrame> frame;
+        bool isQueueEmpty = false;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [this]() {
+                return !_queue.empty() || !_isRecording;
+            });
+
+            if (_queue.empty())
+            {
+                // Stopped and all queued frames are written.
+                break;
+            }
+
+            frame = _queue.front();
+            _queue.pop_front();
+            isQueueEmpty = _queue.empty();
+        }
+
+        const ofBuffer& buffer = frame->buffer();
+
+        if (isFirstFrame)
+        {
+            firstTimestamp = frame->timestamp();
+        }
+
+        if (!segment.is_open() || (!isFirstFrame && entry.offset + entry.size >= _maxSegmentSize))
+        {
+            if (segment.is_open())
+            {
+                segment.close();
+                ++entry.segment;
+            }
+
+            entry.offset = 0;
+            entry.size = 0;
+
+            segment.open(segmentPath(directory, entry.segment), std::ios::binary | std::ios::trunc);
+        }
+        else
+        {
+            entry.offset += entry.size;
+        }
+
+        entry.timestamp = frame->timestamp() - firstTimestamp;
+        entry.size = static_cast<uint32_t>(buffer.size());
+
+        segment.write(buffer.getData(), buffer.size());
+
+        if (!segment)
+        {
+            ofLogError("IPVideoRecorder::run") << "Unable to write segment: " << segmentPath(directory, entry.segment);
+            std::unique_lock<std::mutex> lock(_mutex);
+            _isRecording = false;
+            _queue.clear();
+            break;
+        }
+
+        writeIndexEntry(index, entry);
+
+        isFirstFrame = false;
+
+        if (isQueueEmpty)
+        {
+            // The segment is flushed first so that readers of a recording in
+            // progress never see an index entry before its frame.
+            segment.flush();
+            index.flush();
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_framesRecorded;
+        _bytesRecorded += buffer.size();
+    }
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,262 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoReplayRoute.h"
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/Thread.h"
+#include "Poco/Net/HTTPServerRequestImpl.h"
+#include "ofUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+const std::string IPVideoReplayRouteSettings::DEFAULT_REPLAY_ROUTE = "/ipvideo-replay";
+const std::string IPVideoReplayRouteSettings::DEFAULT_RECORDING_DIRECTORY = "recording";
+
+
+IPVideoReplayRouteSettings::IPVideoReplayRouteSettings(const std::string& routePathPattern,
+                                                       bool requireSecurePort):
+    BaseRouteSettings(routePathPattern, requireSecurePort),
+    _recordingDirectory(DEFAULT_RECORDING_DIRECTORY),
+    _boundaryMarker(IPVideoRouteSettings::DEFAULT_BOUNDARY_MARKER),
+    _mediaType(IPVideoRouteSettings::DEFAULT_MEDIA_TYPE)
+{
+}
+
+
+IPVideoReplayRouteSettings::~IPVideoReplayRouteSettings()
+{
+}
+
+
+void IPVideoReplayRouteSettings::setRecordingDirectory(const std::string& recordingDirectory)
+{
+    _recordingDirectory = recordingDirectory;
+}
+
+
+const std::string& IPVideoReplayRouteSettings::getRecordingDirectory() const
+{
+    return _recordingDirectory;
+}
+
+
+void IPVideoReplayRouteSettings::setBoundaryMarker(const std::string& boundaryMarker)
+{
+    _boundaryMarker = boundaryMarker;
+}
+
+
+const std::string& IPVideoReplayRouteSettings::getBoundaryMarker() const
+{
+    return _boundaryMarker;
+}
+
+
+void IPVideoReplayRouteSettings::setMediaType(const Poco::Net::MediaType& mediaType)
+{
+    _mediaType = mediaType;
+}
+
+
+const Poco::Net::MediaType& IPVideoReplayRouteSettings::getMediaType() const
+{
+    return _mediaType;
+}
+
+
+IPVideoReplayRoute::IPVideoReplayRoute(const Settings& settings):
+    BaseRoute_<IPVideoReplayRouteSettings>(settings)
+{
+}
+
+
+IPVideoReplayRoute::~IPVideoReplayRoute()
+{
+}
+
+
+Poco::Net::HTTPRequestHandler* IPVideoReplayRoute::createRequestHandler(const Poco::Net::HTTPServerRequest&)
+{
+    return new IPVideoReplayConnection(*this);
+}
+
+
+void IPVideoReplayRoute::stop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto* connection: _connections)
+    {
+        connection->stop();
+    }
+}
+
+
+std::size_t IPVideoReplayRoute::numConnections() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _connections.size();
+}
+
+
+void IPVideoReplayRoute::addConnection(IPVideoReplayConnection* connection)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _connections.push_back(connection);
+}
+
+
+void IPVideoReplayRoute::removeConnection(IPVideoReplayConnection* connection)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _connections.erase(std::remove(_connections.begin(), _connections.end(), connection), _connections.end());
+}
+
+
+IPVideoReplayConnection::IPVideoReplayConnection(IPVideoReplayRoute& route):
+    BaseRouteHandler_<IPVideoReplayRoute>(route),
+    _isRunning(true)
+{
+}
+
+
+IPVideoReplayConnection::~IPVideoReplayConnection()
+{
+}
+
+
+void IPVideoReplayConnection::handleRequest(ServerEventArgs& evt)
+{
+    uint64_t startTime = 0;
+
+    try
+    {
+        Poco::Net::NameValueCollection queryMap = HTTPUtils::getQueryMap(Poco::URI(evt.request().getURI()));
+
+        if (queryMap.has("t"))
+        {
+            std::istringstream token(queryMap.get("t"));
+            token >> startTime;
+        }
+    }
+    catch (const Poco::SyntaxException& exc)
+    {
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_BAD_REQUEST,
+                                          "Request URI Invalid.");
+        route().handleRequest(evt);
+        return;
+    }
+
+    std::string directory = ofToDataPath(route().settings().getRecordingDirectory(), true);
+
+    std::ifstream index(IPVideoRecorder::indexPath(directory), std::ios::binary);
+
+    if (!index)
+    {
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+        route().handleRequest(evt);
+        return;
+    }
+
+    std::size_t position = IPVideoRecorder::findIndexEntry(index, startTime);
+
+    route().addConnection(this);
+
+    try
+    {
+        Poco::Net::MediaType mediaType = route().settings().getMediaType();
+        mediaType.setParameter("boundary", route().settings().getBoundaryMarker());
+        evt.response().set("Cache-control", "no-cache, no-store, must-revalidate");
+        evt.response().set("Pragma", "no-cache");
+        evt.response().set("Server", "ofx::HTTP::IPVideoServer");
+        evt.response().setContentType(mediaType);
+        evt.response().set("Expires", Poco::DateTimeFormatter::format(Poco::Timestamp(0),
+                                                                      Poco::DateTimeFormat::HTTP_FORMAT));
+
+        evt.response().send().flush();
+
+        Poco::Net::StreamSocket& socket = dynamic_cast<Poco::Net::HTTPServerRequestImpl&>(evt.request()).socket();
+
+        // A single frame is reused so that only one JPEG is held in memory.
+        IPVideoFrame frame(IPVideoFrameSettings(), 0, ofBuffer());
+
+        std::ifstream segment;
+        uint32_t segmentNumber = 0;
+
+        IPVideoRecorder::IndexEntry entry;
+
+        uint64_t playbackStart = ofGetElapsedTimeMillis();
+        uint64_t firstTimestamp = 0;
+        bool isFirstFrame = true;
+
+        while (_isRunning && IPVideoRecorder::readIndexEntry(index, position++, entry))
+        {
+            if (!segment.is_open() || entry.segment != segmentNumber)
+            {
+                segment.close();
+                segment.clear();
+                segmentNumber = entry.segment;
+                segment.open(IPVideoRecorder::segmentPath(directory, segmentNumber), std::ios::binary);
+            }
+
+            frame.buffer().allocate(entry.size);
+            segment.seekg(static_cast<std::streamoff>(entry.offset));
+            segment.read(frame.buffer().getData(), entry.size);
+
+            if (segment.gcount() != static_cast<std::streamsize>(entry.size))
+            {
+                ofLogError("IPVideoReplayConnection::handleRequest") << "Truncated segment: " << IPVideoRecorder::segmentPath(directory, segmentNumber);
+                break;
+            }
+
+            if (isFirstFrame)
+            {
+                firstTimestamp = entry.timestamp;
+                isFirstFrame = false;
+            }
+
+            // Pace the frames by their recorded timestamps, waking regularly
+            // so that long gaps in the recording don't delay stopping.
+            uint64_t due = playbackStart + (entry.timestamp - firstTimestamp);
+            uint64_t now = ofGetElapsedTimeMillis();
+
+            while (_isRunning && due > now)
+            {
+                Poco::Thread::sleep(static_cast<long>(std::min(due - now, uint64_t(100))));
+                now = ofGetElapsedTimeMillis();
+            }
+
+            frame.setHeader(IPVideoRoute::multipartHeader(route().settings().getBoundaryMarker(),
+                                                          entry.size));
+
+            IPVideoConnection::sendFrame(socket, frame);
+        }
+    }
+    catch (const Poco::Exception& e)
+    {
+        ofLogError("IPVideoReplayConnection::handleRequest") << "Exception: " << e.displayText();
+    }
+    catch (const std::exception& e)
+    {
+        ofLogError("IPVideoReplayConnection::handleRequest") << "exception: " << e.what();
+    }
+
+    route().removeConnection(this);
+}
+
+
+void IPVideoReplayConnection::stop()
+{
+    _isRunning = false;
+}
+
+
+} } // namespace ofx::HTTP
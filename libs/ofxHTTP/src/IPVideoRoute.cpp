@@ -6,10 +6,19 @@
 
 
 #include "ofx/HTTP/IPVideoRoute.h"
-#include "Poco/CountingStream.h"
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#if !defined(TARGET_WIN32)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 #include "Poco/DateTimeFormat.h"
 #include "Poco/DateTimeFormatter.h"
+#include "Poco/Net/HTTPServerRequestImpl.h"
 #include "ofImage.h"
+#include "ofUtils.h"
 
 
 #undef min // for windows
@@ -105,6 +114,10 @@ void IPVideoFrameQueue::clear()
 
 const std::string IPVideoRouteSettings::DEFAULT_VIDEO_ROUTE = "/ipvideo";
 const std::string IPVideoRouteSettings::DEFAULT_BOUNDARY_MARKER = "--boundary";
+const std::string IPVideoRouteSettings::DEFAULT_SNAPSHOT_PATH = "/ipvideo/snapshot.jpg";
+const std::string IPVideoRouteSettings::DEFAULT_STREAM_PATH_PREFIX = "/ipvideo/";
+const float IPVideoRouteSettings::DEFAULT_DOWNGRADE_UTILIZATION = 0.9f;
+const float IPVideoRouteSettings::DEFAULT_UPGRADE_UTILIZATION = 0.6f;
 const Poco::Net::MediaType IPVideoRouteSettings::DEFAULT_MEDIA_TYPE = Poco::Net::MediaType("multipart/x-mixed-replace");
 
 
@@ -117,6 +130,18 @@ IPVideoRouteSettings::IPVideoRouteSettings(const std::string& routePathPattern,
     _maxClientQueueSize(DEFAULT_MAX_CLIENT_QUEUE_SIZE),
     _maxStreamWidth(DEFAULT_MAX_STREAM_WIDTH),
     _maxStreamHeight(DEFAULT_MAX_STREAM_HEIGHT),
+    _skipUnchangedFrames(false),
+    _frameHashRowStride(DEFAULT_FRAME_HASH_ROW_STRIDE),
+    _maxResampleThreads(DEFAULT_MAX_RESAMPLE_THREADS),
+    _snapshotPath(DEFAULT_SNAPSHOT_PATH),
+    _snapshotIdleTimeout(DEFAULT_SNAPSHOT_IDLE_TIMEOUT),
+    _streamPathPrefix(DEFAULT_STREAM_PATH_PREFIX),
+    _numQualityTiers(DEFAULT_NUM_QUALITY_TIERS),
+    _adaptiveHoldTime(DEFAULT_ADAPTIVE_HOLD_TIME),
+    _downgradeUtilization(DEFAULT_DOWNGRADE_UTILIZATION),
+    _upgradeUtilization(DEFAULT_UPGRADE_UTILIZATION),
+    _useParallelEncoder(false),
+    _maxEncoderThreads(DEFAULT_MAX_ENCODER_THREADS),
     _boundaryMarker(DEFAULT_BOUNDARY_MARKER),
     _mediaType(DEFAULT_MEDIA_TYPE)
 {
@@ -236,129 +261,1335 @@ std::size_t IPVideoRouteSettings::getMaxStreamHeight() const
 }
 
 
+void IPVideoRouteSettings::setSkipUnchangedFrames(bool skipUnchangedFrames)
+{
+    _skipUnchangedFrames = skipUnchangedFrames;
+}
+
+
+bool IPVideoRouteSettings::getSkipUnchangedFrames() const
+{
+    return _skipUnchangedFrames;
+}
+
+
+void IPVideoRouteSettings::setFrameHashRowStride(std::size_t frameHashRowStride)
+{
+    _frameHashRowStride = std::max(frameHashRowStride, std::size_t(1));
+}
+
+
+std::size_t IPVideoRouteSettings::getFrameHashRowStride() const
+{
+    return _frameHashRowStride;
+}
+
+
+void IPVideoRouteSettings::setMaxResampleThreads(std::size_t maxResampleThreads)
+{
+    _maxResampleThreads = maxResampleThreads;
+}
+
+
+std::size_t IPVideoRouteSettings::getMaxResampleThreads() const
+{
+    return _maxResampleThreads;
+}
+
+
+void IPVideoRouteSettings::setSnapshotPath(const std::string& snapshotPath)
+{
+    _snapshotPath = snapshotPath;
+}
+
+
+const std::string& IPVideoRouteSettings::getSnapshotPath() const
+{
+    return _snapshotPath;
+}
+
+
+void IPVideoRouteSettings::setSnapshotIdleTimeout(uint64_t snapshotIdleTimeout)
+{
+    _snapshotIdleTimeout = snapshotIdleTimeout;
+}
+
+
+uint64_t IPVideoRouteSettings::getSnapshotIdleTimeout() const
+{
+    return _snapshotIdleTimeout;
+}
+
+
+void IPVideoRouteSettings::setStreamPathPrefix(const std::string& streamPathPrefix)
+{
+    _streamPathPrefix = streamPathPrefix;
+}
+
+
+const std::string& IPVideoRouteSettings::getStreamPathPrefix() const
+{
+    return _streamPathPrefix;
+}
+
+
+void IPVideoRouteSettings::setNumQualityTiers(std::size_t numQualityTiers)
+{
+    _numQualityTiers = std::max(numQualityTiers, std::size_t(1));
+}
+
+
+std::size_t IPVideoRouteSettings::getNumQualityTiers() const
+{
+    return _numQualityTiers;
+}
+
+
+void IPVideoRouteSettings::setAdaptiveHoldTime(uint64_t adaptiveHoldTime)
+{
+    _adaptiveHoldTime = adaptiveHoldTime;
+}
+
+
+uint64_t IPVideoRouteSettings::getAdaptiveHoldTime() const
+{
+    return _adaptiveHoldTime;
+}
+
+
+void IPVideoRouteSettings::setDowngradeUtilization(float downgradeUtilization)
+{
+    _downgradeUtilization = downgradeUtilization;
+}
+
+
+float IPVideoRouteSettings::getDowngradeUtilization() const
+{
+    return _downgradeUtilization;
+}
+
+
+void IPVideoRouteSettings::setUpgradeUtilization(float upgradeUtilization)
+{
+    _upgradeUtilization = upgradeUtilization;
+}
+
+
+float IPVideoRouteSettings::getUpgradeUtilization() const
+{
+    return _upgradeUtilization;
+}
+
+
+void IPVideoRouteSettings::setUseParallelEncoder(bool useParallelEncoder)
+{
+    _useParallelEncoder = useParallelEncoder;
+}
+
+
+bool IPVideoRouteSettings::getUseParallelEncoder() const
+{
+    return _useParallelEncoder;
+}
+
+
+void IPVideoRouteSettings::setMaxEncoderThreads(std::size_t maxEncoderThreads)
+{
+    _maxEncoderThreads = maxEncoderThreads;
+}
+
+
+std::size_t IPVideoRouteSettings::getMaxEncoderThreads() const
+{
+    return _maxEncoderThreads;
+}
+
+
+IPVideoQualityController::IPVideoQualityController(std::size_t numTiers,
+                                                   uint64_t holdTime,
+                                                   float downgradeUtilization,
+                                                   float upgradeUtilization):
+    _numTiers(std::max(numTiers, std::size_t(1))),
+    _holdTime(holdTime),
+    _downgradeUtilization(downgradeUtilization),
+    _upgradeUtilization(upgradeUtilization)
+{
+}
+
+
+IPVideoQualityController::~IPVideoQualityController()
+{
+}
+
+
+bool IPVideoQualityController::update(uint64_t now,
+                                      uint64_t sendDuration,
+                                      uint64_t frameInterval,
+                                      std::size_t backlog)
+{
+    if (_numTiers < 2 || frameInterval == 0)
+    {
+        return false;
+    }
+
+    float utilization = static_cast<float>(sendDuration) / frameInterval;
+
+    // Smooth the utilization to ignore single slow frames.
+    _utilization = _utilization * 0.75f + utilization * 0.25f;
+
+    bool isUnderPressure = backlog > 1 || _utilization > _downgradeUtilization;
+    bool hasHeadroom = backlog == 0 && _utilization * TIER_COST_FACTOR < _upgradeUtilization;
+
+    _pressureSince = isUnderPressure ? (_pressureSince == 0 ? now : _pressureSince) : 0;
+    _headroomSince = hasHeadroom ? (_headroomSince == 0 ? now : _headroomSince) : 0;
+
+    if (isUnderPressure && _tier + 1 < _numTiers && now - _pressureSince >= _holdTime / 4)
+    {
+        ++_tier;
+        _utilization /= TIER_COST_FACTOR;
+    }
+    else if (hasHeadroom && _tier > 0 && now - _headroomSince >= _holdTime)
+    {
+        --_tier;
+        _utilization *= TIER_COST_FACTOR;
+    }
+    else
+    {
+        return false;
+    }
+
+    _pressureSince = 0;
+    _headroomSince = 0;
+
+    return true;
+}
+
+
+std::size_t IPVideoQualityController::tier() const
+{
+    return _tier;
+}
+
+
+float IPVideoQualityController::utilization() const
+{
+    return _utilization;
+}
+
+
+IPVideoStream::IPVideoStream(const std::string& name,
+                             uint64_t instanceId,
+                             std::shared_ptr<IPVideoWorkerPool> workerPool,
+                             std::shared_ptr<std::atomic<std::size_t>> routeConnections):
+    _name(name),
+    _instanceId(instanceId),
+    _lastActiveTime(ofGetElapsedTimeMillis()),
+    _routeConnections(routeConnections),
+    _workerPool(workerPool)
+{
+}
+
+
+IPVideoStream::~IPVideoStream()
+{
+    stopEncoder();
+}
+
+
+const std::string& IPVideoStream::name() const
+{
+    return _name;
+}
+
+
+void IPVideoStream::send(const ofPixels& pix, const IPVideoRouteSettings& settings)
+{
+    if (!pix.isAllocated())
+    {
+        ofLogError("IPVideoStream::send") << "Pushing unallocated pixels.";
+        return;
+    }
+
+    std::size_t numTiers = std::max(settings.getNumQualityTiers(), std::size_t(1));
+
+    // Only the tiers that currently have an audience are encoded.
+    std::vector<bool> isTierNeeded(numTiers, false);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        uint64_t now = ofGetElapsedTimeMillis();
+
+        if (_lastSendTime != 0)
+        {
+            _frameInterval = _frameInterval == 0
+                ? now - _lastSendTime
+                : (_frameInterval * 3 + (now - _lastSendTime)) / 4;
+        }
+
+        _lastSendTime = now;
+        _lastActiveTime = now;
+
+        bool isSnapshotRequested = _lastSnapshotRequest != 0
+            && now - _lastSnapshotRequest < settings.getSnapshotIdleTimeout();
+
+        std::unique_lock<std::mutex> listenerLock(_listenerMutex);
+
+        bool isListened = std::any_of(_listeners.begin(),
+                                      _listeners.end(),
+                                      [](const AbstractIPVideoFrameListener* listener)
+                                      {
+                                          return listener->isListening();
+                                      });
+
+        listenerLock.unlock();
+
+        // Nobody is watching, so don't bother encoding.
+        if (_connections.empty() && !isSnapshotRequested && !isListened)
+        {
+            return;
+        }
+
+        // Snapshots and listeners are always served from the first tier.
+        isTierNeeded[0] = isSnapshotRequested || isListened;
+
+        for (const auto* connection: _connections)
+        {
+            isTierNeeded[std::min(connection->tier(), numTiers - 1)] = true;
+        }
+    }
+
+    IPVideoFrameSettings frameSettings = settings.getFrameSettings();
+
+    std::vector<std::shared_ptr<IPVideoFrame>> frames(numTiers);
+
+    uint64_t frameHash = 0;
+
+    if (isTierNeeded[0] && settings.getSkipUnchangedFrames())
+    {
+        frameHash = IPVideoRoute::hash(pix, settings.getFrameHashRowStride());
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (_lastFrame != nullptr && _lastFrameHash == frameHash)
+        {
+            frames[0] = _lastFrame;
+            ++_framesReused;
+        }
+    }
+
+    for (std::size_t tier = 0; tier < numTiers; ++tier)
+    {
+        if (isTierNeeded[tier] && frames[tier] == nullptr)
+        {
+            frames[tier] = encode(pix,
+                                  IPVideoRoute::tierFrameSettings(frameSettings, tier, pix),
+                                  settings);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (std::size_t tier = 0; tier < numTiers; ++tier)
+    {
+        if (frames[tier] != nullptr && frames[tier] != _lastFrame)
+        {
+            ++_framesEncoded;
+            _bytesEncoded += frames[tier]->buffer().size();
+        }
+    }
+
+    if (frames[0] != nullptr)
+    {
+        _lastFrameTime = ofGetElapsedTimeMillis();
+    }
+
+    bool isNewFrame = frames[0] != nullptr && frames[0] != _lastFrame;
+
+    if (isNewFrame)
+    {
+        _lastFrame = frames[0];
+        _lastFrameHash = frameHash;
+        _lastFrameETag = "\"" + ofToHex(_instanceId) + "-" + ofToString(++_frameSequence) + "\"";
+    }
+
+    Connections::const_iterator iter = _connections.begin();
+
+    while (iter != _connections.end())
+    {
+        if (*iter != nullptr)
+        {
+            // A client may have changed tiers since the tiers were chosen, so
+            // fall back to the nearest encoded tier.
+            std::size_t tier = std::min((*iter)->tier(), numTiers - 1);
+
+            std::shared_ptr<IPVideoFrame> frame = frames[tier];
+
+            for (std::size_t i = 0; frame == nullptr && i < numTiers; ++i)
+            {
+                frame = frames[numTiers - 1 - i];
+            }
+
+            (*iter)->push(frame);
+        }
+        else
+        {
+            ofLogError("IPVideoStream::send") << "Found a NULL IPVideoRouteHandler*.  This should not happen.";
+        }
+
+        ++iter;
+    }
+
+    if (isNewFrame)
+    {
+        std::shared_ptr<IPVideoFrame> frame = _lastFrame;
+        uint64_t sequence = _frameSequence;
+
+        // Listeners are notified without the stream lock. The listener lock
+        // is taken first so that listeners receive frames in order.
+        std::unique_lock<std::mutex> listenerLock(_listenerMutex);
+
+        lock.unlock();
+
+        for (auto* listener: _listeners)
+        {
+            listener->frameEncoded(*this, frame, sequence);
+        }
+    }
+}
+
+
+void IPVideoStream::send(std::shared_ptr<const ofPixels> pix,
+                         std::shared_ptr<const IPVideoRouteSettings> settings)
+{
+    if (pix == nullptr || settings == nullptr)
+    {
+        ofLogError("IPVideoStream::send") << "Pushing null pixels.";
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_pendingMutex);
+
+        // Only the latest pixels are kept. Replaced pixels are released here.
+        _pendingPixels = pix;
+        _pendingSettings = settings;
+
+        if (!_isEncoderRunning)
+        {
+            // stopEncoder() takes the previous thread under this lock, so
+            // _encoderThread is never joinable here.
+            _isEncoderRunning = true;
+            _encoderThread = std::thread(&IPVideoStream::encodePending, this, _encoderGeneration);
+        }
+    }
+
+    _pendingCondition.notify_one();
+}
+
+
+void IPVideoStream::stopEncoder()
+{
+    std::thread encoderThread;
+
+    {
+        std::unique_lock<std::mutex> lock(_pendingMutex);
+        _isEncoderRunning = false;
+        ++_encoderGeneration;
+        _pendingPixels.reset();
+        _pendingSettings.reset();
+
+        // The thread is taken under the lock, so a concurrent send() that
+        // starts a new encoder never assigns to a joinable thread.
+        encoderThread.swap(_encoderThread);
+    }
+
+    _pendingCondition.notify_all();
+
+    if (encoderThread.joinable())
+    {
+        encoderThread.join();
+    }
+}
+
+
+void IPVideoStream::encodePending(uint64_t generation)
+{
+    while (true)
+    {
+        std::shared_ptr<const ofPixels> pix;
+        std::shared_ptr<const IPVideoRouteSettings> settings;
+
+        {
+            std::unique_lock<std::mutex> lock(_pendingMutex);
+
+            _pendingCondition.wait(lock, [&]() {
+                return _pendingPixels != nullptr || generation != _encoderGeneration;
+            });
+
+            // A stopped thread exits even if a newer encoder has started.
+            if (generation != _encoderGeneration)
+            {
+                return;
+            }
+
+            pix.swap(_pendingPixels);
+            settings.swap(_pendingSettings);
+        }
+
+        send(*pix, *settings);
+    }
+}
+
+
+std::shared_ptr<IPVideoFrame> IPVideoStream::encode(const ofPixels& pix,
+                                                    const IPVideoFrameSettings& frameSettings,
+                                                    const IPVideoRouteSettings& settings)
+{
+    uint64_t timestamp = ofGetElapsedTimeMillis();
+
+    std::size_t newWidth = frameSettings.getWidth() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getWidth() : pix.getWidth();
+    std::size_t newHeight = frameSettings.getHeight() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getHeight() : pix.getHeight();
+
+    // The frame records the dimensions it was actually encoded with.
+    IPVideoFrameSettings encodedSettings = frameSettings;
+    encodedSettings.setWidth(newWidth);
+    encodedSettings.setHeight(newHeight);
+
+    // Encode directly into the frame's buffer to avoid copying it.
+    std::shared_ptr<IPVideoFrame> frame = std::make_shared<IPVideoFrame>(encodedSettings, timestamp, ofBuffer());
+
+    ofBuffer& compressedPixels = frame->buffer();
+
+    auto compress = [&](const ofPixels& pixels)
+    {
+        if (!settings.getUseParallelEncoder()
+        ||  !IPVideoJPEGEncoder::encode(pixels,
+                                        compressedPixels,
+                                        frameSettings.getQuality(),
+                                        settings.getMaxEncoderThreads(),
+                                        _workerPool.get()))
+        {
+            ofSaveImage(pixels, compressedPixels, OF_IMAGE_FORMAT_JPEG, frameSettings.getQuality());
+        }
+    };
+
+    bool isJPEGCompatible = pix.getPixelFormat() == OF_PIXELS_GRAY
+                        ||  pix.getPixelFormat() == OF_PIXELS_RGB
+                        ||  pix.getPixelFormat() == OF_PIXELS_BGR;
+
+    if (newWidth == pix.getWidth()
+        &&  newHeight == pix.getHeight()
+        &&  !frameSettings.getFlipHorizontal()
+        &&  !frameSettings.getFlipVertical()
+        &&  isJPEGCompatible)
+    {
+        // The encoder can read the source pixels directly.
+        compress(pix);
+    }
+    else
+    {
+        std::unique_lock<std::mutex> encoderLock(_encoderMutex);
+
+        if (!IPVideoRoute::resample(pix,
+                                    _encoderPixels,
+                                    newWidth,
+                                    newHeight,
+                                    frameSettings.getFlipHorizontal(),
+                                    frameSettings.getFlipVertical(),
+                                    settings.getMaxResampleThreads(),
+                                    _workerPool.get()))
+        {
+            // Fall back to the general purpose ofPixels operations.
+            _encoderPixels = pix;
+
+            if (newWidth != pix.getWidth() || newHeight != pix.getHeight())
+            {
+                _encoderPixels.resize(newWidth, newHeight);
+            }
+
+            if (frameSettings.getFlipVertical() || frameSettings.getFlipHorizontal())
+            {
+                _encoderPixels.mirror(frameSettings.getFlipVertical(),
+                                      frameSettings.getFlipHorizontal());
+            }
+        }
+
+        compress(_encoderPixels);
+    }
+
+    // Render the multipart header once for all clients.
+    frame->setHeader(IPVideoRoute::multipartHeader(settings.getBoundaryMarker(),
+                                                   compressedPixels.size()));
+
+    return frame;
+}
+
+
+
+
+std::size_t IPVideoStream::numConnections() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _connections.size();
+}
+
+
+bool IPVideoStream::isIdle(uint64_t timeout) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::unique_lock<std::mutex> listenerLock(_listenerMutex);
+
+    return _connections.empty()
+        && _listeners.empty()
+        && ofGetElapsedTimeMillis() - _lastActiveTime > timeout;
+}
+
+
+std::shared_ptr<IPVideoFrame> IPVideoStream::snapshot() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _lastFrame;
+}
+
+
+uint64_t IPVideoStream::frameInterval() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _frameInterval;
+}
+
+
+uint64_t IPVideoStream::framesEncoded() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesEncoded;
+}
+
+
+uint64_t IPVideoStream::framesReused() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesReused;
+}
+
+
+uint64_t IPVideoStream::bytesEncoded() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _bytesEncoded;
+}
+
+
+void IPVideoStream::reset()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _lastFrame.reset();
+    _lastFrameHash = 0;
+    _lastFrameETag.clear();
+    _lastFrameTime = 0;
+}
+
+
+void IPVideoStream::stop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Connections::reverse_iterator iter = _connections.rbegin();
+
+    while (iter != _connections.rend())
+    {
+        if (*iter != nullptr)
+        {
+            (*iter)->stop();
+        }
+
+        ++iter;
+    }
+}
+
+
+std::shared_ptr<IPVideoFrame> IPVideoStream::requestSnapshot(std::string& etag,
+                                                             uint64_t maxAge)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint64_t now = ofGetElapsedTimeMillis();
+
+    _lastSnapshotRequest = now;
+
+    if (_lastFrame == nullptr || now - _lastFrameTime > maxAge)
+    {
+        return nullptr;
+    }
+
+    etag = _lastFrameETag;
+    return _lastFrame;
+}
+
+
+void IPVideoStream::addListener(AbstractIPVideoFrameListener* listener)
+{
+    std::unique_lock<std::mutex> lock(_listenerMutex);
+
+    if (std::find(_listeners.begin(), _listeners.end(), listener) == _listeners.end())
+    {
+        _listeners.push_back(listener);
+    }
+}
+
+
+void IPVideoStream::removeListener(AbstractIPVideoFrameListener* listener)
+{
+    std::unique_lock<std::mutex> lock(_listenerMutex);
+    _listeners.erase(std::remove(_listeners.begin(), _listeners.end(), listener), _listeners.end());
+}
+
+
+void IPVideoStream::addConnection(IPVideoConnection* handler)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _connections.push_back(handler);
+    _lastActiveTime = ofGetElapsedTimeMillis();
+
+    if (_routeConnections != nullptr)
+    {
+        ++(*_routeConnections);
+    }
+}
+
+
+void IPVideoStream::removeConnection(IPVideoConnection* handler)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Connections::iterator iter = std::remove(_connections.begin(), _connections.end(), handler);
+
+    if (_routeConnections != nullptr)
+    {
+        *_routeConnections -= std::distance(iter, _connections.end());
+    }
+
+    _connections.erase(iter, _connections.end());
+    _lastActiveTime = ofGetElapsedTimeMillis();
+}
+
+
+const std::string IPVideoRoute::DEFAULT_STREAM_NAME = "";
+const std::string IPVideoRoute::SNAPSHOT_FILE_NAME = "snapshot.jpg";
+
+
 IPVideoRoute::IPVideoRoute(const Settings& settings):
-    BaseRoute_<IPVideoRouteSettings>(settings)
+    BaseRoute_<IPVideoRouteSettings>(settings),
+    _numConnections(std::make_shared<std::atomic<std::size_t>>(0)),
+    _instanceId(ofGetSystemTimeMicros()),
+    _workerPool(std::make_shared<IPVideoWorkerPool>()),
+    _sharedSettings(std::make_shared<IPVideoRouteSettings>(settings))
+{
+    // The default stream always exists so that clients can connect before
+    // the first frame is sent.
+    _streams[DEFAULT_STREAM_NAME] = std::make_shared<IPVideoStream>(DEFAULT_STREAM_NAME,
+                                                                    _instanceId,
+                                                                    _workerPool,
+                                                                    _numConnections);
+}
+
+
+IPVideoRoute::~IPVideoRoute()
+{
+    // Streams may outlive the route while clients hold them, so their
+    // encoder threads are stopped now.
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto& entry: _streams)
+    {
+        entry.second->stopEncoder();
+    }
+}
+
+
+bool IPVideoRoute::canHandleRequest(const Poco::Net::HTTPServerRequest& request,
+                                    bool isSecurePort) const
+{
+    if (BaseRoute_<IPVideoRouteSettings>::canHandleRequest(request, isSecurePort))
+    {
+        return true;
+    }
+
+    std::string streamName;
+    bool isSnapshot = false;
+
+    return (!_settings.requireSecurePort() || isSecurePort)
+        && parseRequest(request, streamName, isSnapshot);
+}
+
+
+Poco::Net::HTTPRequestHandler* IPVideoRoute::createRequestHandler(const Poco::Net::HTTPServerRequest& request)
+{
+    // Requests matching the route path pattern select the default stream.
+    std::string streamName = DEFAULT_STREAM_NAME;
+    bool isSnapshot = false;
+
+    parseRequest(request, streamName, isSnapshot);
+
+    if (isSnapshot)
+    {
+        return new IPVideoSnapshotHandler(*this, stream(streamName));
+    }
+
+    return new IPVideoConnection(*this, stream(streamName));
+}
+
+
+void IPVideoRoute::setup(const Settings& settings)
+{
+    BaseRoute_<IPVideoRouteSettings>::setup(settings);
+
+    // The cached frames may have been encoded with different frame settings.
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _sharedSettings = std::make_shared<IPVideoRouteSettings>(settings);
+
+    for (auto& entry: _streams)
+    {
+        entry.second->reset();
+    }
+}
+
+
+void IPVideoRoute::send(const ofPixels& pix) const
+{
+    send(DEFAULT_STREAM_NAME, pix);
+}
+
+
+void IPVideoRoute::send(const std::string& streamName, const ofPixels& pix) const
+{
+    findOrCreateStream(streamName)->send(pix, _settings);
+}
+
+
+void IPVideoRoute::send(std::shared_ptr<const ofPixels> pix) const
+{
+    send(DEFAULT_STREAM_NAME, pix);
+}
+
+
+void IPVideoRoute::send(const std::string& streamName,
+                        std::shared_ptr<const ofPixels> pix) const
+{
+    std::shared_ptr<const IPVideoRouteSettings> settings;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        settings = _sharedSettings;
+    }
+
+    findOrCreateStream(streamName)->send(pix, settings);
+}
+
+
+std::shared_ptr<IPVideoStream> IPVideoRoute::findOrCreateStream(const std::string& streamName) const
+{
+    std::vector<std::shared_ptr<IPVideoStream>> removed;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Streams::iterator iter = _streams.find(streamName);
+
+    if (iter != _streams.end())
+    {
+        return iter->second;
+    }
+
+    // Streams are only created here, so this keeps the number of abandoned
+    // streams bounded.
+    removeIdleStreams(removed);
+
+    std::shared_ptr<IPVideoStream> s = std::make_shared<IPVideoStream>(streamName,
+                                                                       _instanceId,
+                                                                       _workerPool,
+                                                                       _numConnections);
+    _streams[streamName] = s;
+
+    return s;
+}
+
+
+std::string IPVideoRoute::multipartHeader(const std::string& boundaryMarker,
+                                          std::size_t contentLength)
+{
+    std::stringstream header;
+    header << boundaryMarker << "\r\n";
+    header << "Content-Type: image/jpeg\r\n";
+    header << "Content-Length: " << contentLength << "\r\n";
+    header << "\r\n";
+    return header.str();
+}
+
+
+IPVideoFrameSettings IPVideoRoute::tierFrameSettings(const IPVideoFrameSettings& frameSettings,
+                                                     std::size_t tier,
+                                                     const ofPixels& pix)
+{
+    if (tier == 0)
+    {
+        return frameSettings;
+    }
+
+    IPVideoFrameSettings result = frameSettings;
+
+    int width = frameSettings.getWidth() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getWidth() : pix.getWidth();
+    int height = frameSettings.getHeight() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getHeight() : pix.getHeight();
+
+    // Each tier halves both dimensions and lowers the quality one step.
+    result.setWidth(std::max(width >> tier, 1));
+    result.setHeight(std::max(height >> tier, 1));
+    result.setQuality(static_cast<ofImageQualityType>(std::min(static_cast<int>(frameSettings.getQuality()) + static_cast<int>(tier),
+                                                               static_cast<int>(OF_IMAGE_QUALITY_WORST))));
+
+    return result;
+}
+
+
+std::size_t IPVideoRoute::numConnections() const
 {
+    return *_numConnections;
 }
 
 
-IPVideoRoute::~IPVideoRoute()
+std::size_t IPVideoRoute::numConnections(const std::string& streamName) const
 {
+    std::shared_ptr<IPVideoStream> s = stream(streamName);
+    return s != nullptr ? s->numConnections() : 0;
 }
 
 
-Poco::Net::HTTPRequestHandler* IPVideoRoute::createRequestHandler(const Poco::Net::HTTPServerRequest& request)
+std::shared_ptr<IPVideoFrame> IPVideoRoute::snapshot() const
 {
-    return new IPVideoConnection(*this);
+    return snapshot(DEFAULT_STREAM_NAME);
 }
 
 
-void IPVideoRoute::send(const ofPixels& pix) const
+std::shared_ptr<IPVideoFrame> IPVideoRoute::snapshot(const std::string& streamName) const
+{
+    std::shared_ptr<IPVideoStream> s = stream(streamName);
+    return s != nullptr ? s->snapshot() : nullptr;
+}
+
+
+std::shared_ptr<IPVideoStream> IPVideoRoute::stream(const std::string& streamName) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Streams::const_iterator iter = _streams.find(streamName);
+
+    return iter != _streams.end() ? iter->second : nullptr;
+}
+
+
+std::vector<std::string> IPVideoRoute::streamNames() const
 {
-    if (pix.isAllocated())
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    std::vector<std::string> names;
+
+    for (const auto& entry: _streams)
     {
-        uint64_t timestamp = ofGetElapsedTimeMillis();
+        names.push_back(entry.first);
+    }
+
+    return names;
+}
+
 
-        ofBuffer compressedPixels;
+void IPVideoRoute::stop()
+{
+    std::vector<std::shared_ptr<IPVideoStream>> streams;
 
-        IPVideoFrameSettings frameSettings = _settings.getFrameSettings();
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
 
-        if (frameSettings.getWidth() != IPVideoFrameSettings::NO_RESIZE
-            ||  frameSettings.getHeight() != IPVideoFrameSettings::NO_RESIZE
-            ||  frameSettings.getFlipHorizontal()
-            ||  frameSettings.getFlipVertical())
+        for (const auto& entry: _streams)
         {
-            int newWidth = frameSettings.getWidth() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getWidth() : pix.getWidth();
-            int newHeight = frameSettings.getHeight() != IPVideoFrameSettings::NO_RESIZE ? frameSettings.getHeight() : pix.getHeight();
+            streams.push_back(entry.second);
+        }
+    }
+
+    for (auto& s: streams)
+    {
+        s->stop();
+    }
+}
 
-            ofPixels pixels = pix;
 
-            if (newWidth != pix.getWidth() || newHeight != pix.getHeight())
-            {
-                pixels.resize(newWidth, newHeight);
-            }
+uint64_t IPVideoRoute::hash(const ofPixels& pix, std::size_t rowStride)
+{
+    // A word-at-a-time multiply / xor-shift hash. Four independent lanes
+    // keep the multiplies in flight and let the compiler vectorize the loop.
+    const uint64_t k = 0x9E3779B97F4A7C15ULL;
 
-            if (frameSettings.getFlipVertical() || frameSettings.getFlipHorizontal())
+    uint64_t lanes[4] = { k, k ^ 1, k ^ 2, k ^ 3 };
+
+    std::size_t width = pix.getWidth();
+    std::size_t height = pix.getHeight();
+    std::size_t rowBytes = width * pix.getBytesPerPixel();
+    std::size_t rowPitch = pix.getBytesStride();
+
+    const unsigned char* data = pix.getData();
+
+    rowStride = std::max(rowStride, std::size_t(1));
+
+    for (std::size_t y = 0; y < height; y += rowStride)
+    {
+        const unsigned char* row = data + y * rowPitch;
+
+        std::size_t x = 0;
+
+        for (; x + 32 <= rowBytes; x += 32)
+        {
+            uint64_t words[4];
+            std::memcpy(words, row + x, sizeof(words));
+
+            for (std::size_t i = 0; i < 4; ++i)
             {
-                pixels.mirror(frameSettings.getFlipVertical(),
-                              frameSettings.getFlipHorizontal());
+                lanes[i] = (lanes[i] ^ words[i]) * k;
+                lanes[i] ^= lanes[i] >> 29;
             }
-
-            ofSaveImage(pixels, compressedPixels, OF_IMAGE_FORMAT_JPEG, frameSettings.getQuality());
         }
-        else
+
+        for (; x < rowBytes; ++x)
         {
-            ofPixels pixels = pix;
-            ofSaveImage(pixels, compressedPixels, OF_IMAGE_FORMAT_JPEG, frameSettings.getQuality());
+            lanes[x & 3] = (lanes[x & 3] ^ row[x]) * k;
         }
+    }
 
-        std::unique_lock<std::mutex> lock(_mutex);
+    uint64_t result = (uint64_t(width) << 32) ^ (uint64_t(height) << 8) ^ pix.getNumChannels();
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        result = (result ^ lanes[i]) * k;
+        result ^= result >> 32;
+    }
+
+    return result;
+}
+
+
+bool IPVideoRoute::resample(const ofPixels& src,
+                            ofPixels& dst,
+                            std::size_t width,
+                            std::size_t height,
+                            bool flipHorizontal,
+                            bool flipVertical,
+                            std::size_t maxThreads,
+                            IPVideoWorkerPool* workerPool)
+{
+    ofPixelFormat dstFormat = OF_PIXELS_UNKNOWN;
+
+    switch (src.getPixelFormat())
+    {
+        case OF_PIXELS_GRAY:
+        case OF_PIXELS_RGB:
+        case OF_PIXELS_BGR:
+            dstFormat = src.getPixelFormat();
+            break;
+        case OF_PIXELS_RGBA:
+            dstFormat = OF_PIXELS_RGB;
+            break;
+        case OF_PIXELS_BGRA:
+            dstFormat = OF_PIXELS_BGR;
+            break;
+        default:
+            return false;
+    }
+
+    if (!src.isAllocated() || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    if (dst.getWidth() != width
+        ||  dst.getHeight() != height
+        ||  dst.getPixelFormat() != dstFormat)
+    {
+        dst.allocate(width, height, dstFormat);
+    }
 
-        Connections::const_iterator iter = _connections.begin();
+    const std::size_t srcWidth = src.getWidth();
+    const std::size_t srcHeight = src.getHeight();
+    const std::size_t srcChannels = src.getNumChannels();
+    const std::size_t srcPitch = src.getBytesStride();
+    const std::size_t dstChannels = dst.getNumChannels();
+    const std::size_t dstPitch = dst.getBytesStride();
+    const unsigned char* srcData = src.getData();
+    unsigned char* dstData = dst.getData();
 
-        std::shared_ptr<IPVideoFrame> frame = std::make_shared<IPVideoFrame>(frameSettings, timestamp, compressedPixels);
+    // Precompute the source byte offset of each destination column.
+    std::vector<std::size_t> columns(width);
 
-        while (iter != _connections.end())
+    for (std::size_t x = 0; x < width; ++x)
+    {
+        std::size_t sx = x * srcWidth / width;
+        columns[x] = (flipHorizontal ? srcWidth - 1 - sx : sx) * srcChannels;
+    }
+
+    // Rows can be copied whole if the columns map one-to-one.
+    const bool copyRows = width == srcWidth
+                      &&  !flipHorizontal
+                      &&  srcChannels == dstChannels;
+
+    auto resampleRows = [&](std::size_t y0, std::size_t y1)
+    {
+        for (std::size_t y = y0; y < y1; ++y)
         {
-            if (*iter != nullptr)
+            std::size_t sy = y * srcHeight / height;
+
+            const unsigned char* s = srcData + (flipVertical ? srcHeight - 1 - sy : sy) * srcPitch;
+            unsigned char* d = dstData + y * dstPitch;
+
+            if (copyRows)
+            {
+                std::memcpy(d, s, width * dstChannels);
+            }
+            else if (dstChannels == 3)
+            {
+                for (std::size_t x = 0; x < width; ++x, d += 3)
+                {
+                    const unsigned char* p = s + columns[x];
+                    d[0] = p[0];
+                    d[1] = p[1];
+                    d[2] = p[2];
+                }
+            }
+            else if (dstChannels == 1)
             {
-                (*iter)->push(frame);
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    d[x] = s[columns[x]];
+                }
             }
             else
             {
-                ofLogError("IPVideoRoute::send") << "Found a NULL IPVideoRouteHandler*.  This should not happen.";
+                for (std::size_t x = 0; x < width; ++x, d += dstChannels)
+                {
+                    std::memcpy(d, s + columns[x], dstChannels);
+                }
             }
-
-            ++iter;
         }
+    };
+
+    if (maxThreads == 0)
+    {
+        maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
     }
-    else
+
+    std::size_t numBands = std::max(std::min(maxThreads, height / MIN_RESAMPLE_BAND_ROWS),
+                                    std::size_t(1));
+
+    std::size_t rowsPerBand = (height + numBands - 1) / numBands;
+
+    if (workerPool == nullptr)
     {
-        ofLogError("IPVideoRoute::pushFrame") << "Pushing unallocated pixels.";
+        workerPool = &IPVideoWorkerPool::defaultPool();
     }
+
+    workerPool->run(numBands, [&](std::size_t band)
+    {
+        std::size_t y0 = band * rowsPerBand;
+        resampleRows(std::min(y0, height), std::min(y0 + rowsPerBand, height));
+    });
+
+    return true;
 }
 
 
-std::size_t IPVideoRoute::numConnections() const
+std::shared_ptr<IPVideoStream> IPVideoRoute::addConnection(std::shared_ptr<IPVideoStream> stream,
+                                                           IPVideoConnection* connection)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    return _connections.size();
+
+    // Holding the route's lock keeps the stream from being removed until the
+    // connection has been added.
+    std::shared_ptr<IPVideoStream>& s = _streams[stream->name()];
+
+    if (s == nullptr)
+    {
+        s = stream;
+    }
+
+    s->addConnection(connection);
+
+    return s;
 }
 
 
-void IPVideoRoute::stop()
+void IPVideoRoute::removeConnection(std::shared_ptr<IPVideoStream> stream,
+                                    IPVideoConnection* connection)
 {
-    Connections::reverse_iterator iter = _connections.rbegin();
+    stream->removeConnection(connection);
 
-    while (iter != _connections.rend())
+    // The removed streams are released after the lock, as releasing a
+    // stream joins its encoder thread.
+    std::vector<std::shared_ptr<IPVideoStream>> removed;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    removeIdleStreams(removed);
+}
+
+
+void IPVideoRoute::removeIdleStreams(std::vector<std::shared_ptr<IPVideoStream>>& removed) const
+{
+    Streams::iterator iter = _streams.begin();
+
+    while (iter != _streams.end())
     {
-        if (*iter != nullptr)
+        if (iter->first != DEFAULT_STREAM_NAME
+        &&  iter->second->isIdle(_settings.getSnapshotIdleTimeout()))
         {
-            (*iter)->stop();
+            removed.push_back(iter->second);
+            iter = _streams.erase(iter);
         }
+        else
+        {
+            ++iter;
+        }
+    }
+}
 
-        ++iter;
+
+bool IPVideoRoute::parseRequest(const Poco::Net::HTTPServerRequest& request,
+                                std::string& streamName,
+                                bool& isSnapshot) const
+{
+    std::string path;
+
+    try
+    {
+        path = Poco::URI(request.getURI()).getPath();
+    }
+    catch (const Poco::SyntaxException& exc)
+    {
+        ofLogError("IPVideoRoute::parseRequest") << exc.displayText();
+        return false;
+    }
+
+    const std::string& snapshotPath = _settings.getSnapshotPath();
+
+    bool isGetOrHead = request.getMethod() == Poco::Net::HTTPRequest::HTTP_GET
+                    || request.getMethod() == Poco::Net::HTTPRequest::HTTP_HEAD;
+
+    if (!snapshotPath.empty() && isGetOrHead && path == snapshotPath)
+    {
+        streamName = DEFAULT_STREAM_NAME;
+        isSnapshot = true;
+        return true;
+    }
+
+    const std::string& prefix = _settings.getStreamPathPrefix();
+
+    if (prefix.empty()
+    ||  path.size() <= prefix.size()
+    ||  path.compare(0, prefix.size(), prefix) != 0)
+    {
+        return false;
     }
+
+    std::string name = path.substr(prefix.size());
+    std::string snapshotSuffix = "/" + SNAPSHOT_FILE_NAME;
+
+    bool hasSnapshotSuffix = !snapshotPath.empty()
+                          && name.size() > snapshotSuffix.size()
+                          && name.compare(name.size() - snapshotSuffix.size(),
+                                          snapshotSuffix.size(),
+                                          snapshotSuffix) == 0;
+
+    if (hasSnapshotSuffix)
+    {
+        name.resize(name.size() - snapshotSuffix.size());
+    }
+
+    if (name.find('/') != std::string::npos || (hasSnapshotSuffix && !isGetOrHead))
+    {
+        return false;
+    }
+
+    streamName = name;
+    isSnapshot = hasSnapshotSuffix;
+    return true;
 }
 
 
-void IPVideoRoute::addConnection(IPVideoConnection* handler)
+IPVideoSnapshotHandler::IPVideoSnapshotHandler(IPVideoRoute& route,
+                                               std::shared_ptr<IPVideoStream> stream):
+    BaseRouteHandler_<IPVideoRoute>(route),
+    _stream(stream)
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-    _connections.push_back(handler);
 }
 
 
-void IPVideoRoute::removeConnection(IPVideoConnection* handler)
+IPVideoSnapshotHandler::~IPVideoSnapshotHandler()
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-    _connections.erase(std::remove(_connections.begin(), _connections.end(), handler), _connections.end());
 }
 
 
-IPVideoConnection::IPVideoConnection(IPVideoRoute& route):
+void IPVideoSnapshotHandler::handleRequest(ServerEventArgs& evt)
+{
+    if (_stream == nullptr)
+    {
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+        route().handleRequest(evt);
+        return;
+    }
+
+    std::string etag;
+    std::shared_ptr<IPVideoFrame> frame = _stream->requestSnapshot(etag,
+                                                                   route().settings().getSnapshotIdleTimeout());
+
+    if (frame == nullptr)
+    {
+        evt.response().set("Retry-After", "1");
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_SERVICE_UNAVAILABLE,
+                                          "No frame available. Please try again later.");
+        route().handleRequest(evt);
+        return;
+    }
+
+    evt.response().set("Cache-control", "no-cache");
+    evt.response().set("Server", "ofx::HTTP::IPVideoServer");
+    evt.response().set("ETag", etag);
+
+    if (evt.request().has("If-None-Match"))
+    {
+        std::vector<std::string> tags = ofSplitString(evt.request().get("If-None-Match"), ",", true, true);
+
+        if (std::find(tags.begin(), tags.end(), etag) != tags.end()
+        ||  std::find(tags.begin(), tags.end(), "*") != tags.end())
+        {
+            evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED);
+            evt.response().setContentLength(0);
+            evt.response().send();
+            return;
+        }
+    }
+
+    const ofBuffer& buffer = frame->buffer();
+
+    evt.response().setContentType("image/jpeg");
+    evt.response().sendBuffer(buffer.getData(), buffer.size());
+}
+
+
+IPVideoConnection::IPVideoConnection(IPVideoRoute& route,
+                                     std::shared_ptr<IPVideoStream> stream):
     BaseRouteHandler_<IPVideoRoute>(route),
-    IPVideoFrameQueue(route.settings().getMaxClientQueueSize())
+    IPVideoFrameQueue(route.settings().getMaxClientQueueSize()),
+    _stream(stream),
+    _qualityController(route.settings().getNumQualityTiers(),
+                       route.settings().getAdaptiveHoldTime(),
+                       route.settings().getDowngradeUtilization(),
+                       route.settings().getUpgradeUtilization()),
+    _tier(0)
 {
 }
 
@@ -370,6 +1601,13 @@ IPVideoConnection::~IPVideoConnection()
 
 void IPVideoConnection::handleRequest(ServerEventArgs& evt)
 {
+    if (_stream == nullptr)
+    {
+        evt.response().setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+        route().handleRequest(evt);
+        return;
+    }
+
     if(route().settings().getMaxClientConnections() != 0 && // 0 == no limit
        route().numConnections() >= route().settings().getMaxClientConnections())
     {
@@ -476,7 +1714,7 @@ void IPVideoConnection::handleRequest(ServerEventArgs& evt)
         }
     }
     
-    route().addConnection(this);
+    _stream = route().addConnection(_stream, this);
     
     try
     {
@@ -489,53 +1727,58 @@ void IPVideoConnection::handleRequest(ServerEventArgs& evt)
         evt.response().set("Expires", Poco::DateTimeFormatter::format(Poco::Timestamp(0),
                                                                       Poco::DateTimeFormat::HTTP_FORMAT));
         
-        std::ostream& outputStream = evt.response().send();
-        
-        Poco::CountingOutputStream ostr(outputStream);
-        
+        evt.response().send().flush();
+
+        // Frames are written directly to the socket, bypassing the response
+        // stream's formatting and buffering.
+        Poco::Net::StreamSocket& socket = dynamic_cast<Poco::Net::HTTPServerRequestImpl&>(evt.request()).socket();
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _startTime = ofGetElapsedTimeMillis();
+        }
+
         while (_isRunning)
         {
-            if (outputStream.good() && !outputStream.fail() && !outputStream.bad())
+            if (!empty())
             {
-                if (!empty())
+                std::shared_ptr<IPVideoFrame> frame = pop();
+
+                if (frame != nullptr)
                 {
-                    std::shared_ptr<IPVideoFrame> frame = pop();
-                    
-                    if (frame != nullptr)
-                    {
-                        const ofBuffer& buffer = frame->buffer();
-
-                        ostr << route().settings().getBoundaryMarker();
-                        ostr << "\r\n";
-                        ostr << "Content-Type: image/jpeg";
-                        ostr << "\r\n";
-                        ostr << "Content-Length: " << buffer.size();
-                        ostr << "\r\n";
-                        ostr << "\r\n";
-                        ostr << buffer;
-                        
-                        uint64_t now = ofGetElapsedTimeMillis();
-                        _lastFrameDuration = now - _lastFrameSent;
-                        _lastFrameSent = now;
-                        _bytesSent += static_cast<uint64_t>(ostr.chars()); // add the counts
-                        ostr.reset();               // reset the counts
-                        ostr.flush();
-                    }
-                    else
+                    uint64_t sendStart = ofGetElapsedTimeMillis();
+
+                    std::size_t bytesSent = sendFrame(socket, *frame);
+
+                    uint64_t now = ofGetElapsedTimeMillis();
+
+                    uint64_t frameInterval = _stream->frameInterval();
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _lastFrameDuration = now - _lastFrameSent;
+                    _lastFrameSent = now;
+                    _bytesSent += bytesSent;
+                    _framesSent++;
+
+                    if (_qualityController.update(now, now - sendStart, frameInterval, size()))
                     {
-                        ofLogVerbose("IPVideoRouteHandler::handleRequest") << "Null buffer.";
+                        _tier = _qualityController.tier();
+
+                        // Drop the stale backlog so the client catches up to
+                        // the live stream at its new tier.
+                        clear();
                     }
                 }
                 else
                 {
-                    // ofLogVerbose("IPVideoRouteHandler::handleRequest") << "Queue empty.";
+                    ofLogVerbose("IPVideoRouteHandler::handleRequest") << "Null buffer.";
                 }
             }
             else
             {
-                throw Poco::Exception("Response stream failed or went bad -- it was probably interrupted.");
+                // ofLogVerbose("IPVideoRouteHandler::handleRequest") << "Queue empty.";
             }
-            
+
             Poco::Thread::sleep(30);  // TODO: smarter ways of doing for rate / fps limiting
         }
     }
@@ -543,8 +1786,108 @@ void IPVideoConnection::handleRequest(ServerEventArgs& evt)
     {
         ofLogError("IPVideoRouteHandler::handleRequest") << "Exception: " << e.displayText();
     }
+    catch (const std::exception& e)
+    {
+        ofLogError("IPVideoRouteHandler::handleRequest") << "exception: " << e.what();
+    }
     
-    route().removeConnection(this);
+    route().removeConnection(_stream, this);
+}
+
+
+std::size_t IPVideoConnection::sendFrame(Poco::Net::StreamSocket& socket,
+                                         const IPVideoFrame& frame)
+{
+    const std::string& header = frame.header();
+    const ofBuffer& buffer = frame.buffer();
+
+    std::size_t total = header.size() + buffer.size();
+
+#if !defined(TARGET_WIN32)
+    if (!socket.secure())
+    {
+        // Gather the header and the payload into a single system call.
+        struct iovec iov[2];
+        iov[0].iov_base = const_cast<char*>(header.data());
+        iov[0].iov_len = header.size();
+        iov[1].iov_base = const_cast<char*>(buffer.getData());
+        iov[1].iov_len = buffer.size();
+
+        struct iovec* pending = iov;
+        int numPending = 2;
+
+#if defined(MSG_NOSIGNAL)
+        // A closed connection must fail the write, not raise SIGPIPE.
+        const int flags = MSG_NOSIGNAL;
+#else
+        // Platforms without MSG_NOSIGNAL set SO_NOSIGPIPE on the socket.
+        const int flags = 0;
+#endif
+
+        while (numPending > 0)
+        {
+            struct msghdr message;
+            std::memset(&message, 0, sizeof(message));
+            message.msg_iov = pending;
+            message.msg_iovlen = numPending;
+
+            ssize_t n = ::sendmsg(socket.impl()->sockfd(), &message, flags);
+
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw Poco::IOException("Unable to write frame: " + std::string(std::strerror(errno)));
+            }
+
+            // Advance past the bytes written, handling partial writes.
+            std::size_t written = static_cast<std::size_t>(n);
+
+            while (numPending > 0 && written >= pending->iov_len)
+            {
+                written -= pending->iov_len;
+                ++pending;
+                --numPending;
+            }
+
+            if (numPending > 0)
+            {
+                pending->iov_base = static_cast<char*>(pending->iov_base) + written;
+                pending->iov_len -= written;
+            }
+        }
+
+        return total;
+    }
+#endif
+
+    // Secure sockets must write through the SSL layer.
+    sendBytes(socket, header.data(), header.size());
+    sendBytes(socket, buffer.getData(), buffer.size());
+
+    return total;
+}
+
+
+void IPVideoConnection::sendBytes(Poco::Net::StreamSocket& socket,
+                                  const char* data,
+                                  std::size_t size)
+{
+    while (size > 0)
+    {
+        int n = socket.sendBytes(data, static_cast<int>(size));
+
+        if (n <= 0)
+        {
+            throw Poco::IOException("Unable to write frame.");
+        }
+
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
 }
 
 
@@ -564,14 +1907,36 @@ IPVideoFrameSettings IPVideoConnection::frameSettings() const
 float IPVideoConnection::currentBitRate() const
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    return static_cast<float>(_bytesSent) * 8.0f / (ofGetElapsedTimeMillis() - _startTime);
+
+    uint64_t elapsed = ofGetElapsedTimeMillis() - _startTime;
+
+    if (_startTime == 0 || elapsed == 0)
+    {
+        return 0;
+    }
+
+    return static_cast<float>(_bytesSent) * 8.0f * 1000.0f / elapsed;
 }
 
 
 float IPVideoConnection::currentFrameRate() const
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    return static_cast<float>(_framesSent) / (ofGetElapsedTimeMillis() - _startTime);
+
+    uint64_t elapsed = ofGetElapsedTimeMillis() - _startTime;
+
+    if (_startTime == 0 || elapsed == 0)
+    {
+        return 0;
+    }
+
+    return static_cast<float>(_framesSent) * 1000.0f / elapsed;
+}
+
+
+std::size_t IPVideoConnection::tier() const
+{
+    return _tier;
 }
 
 
@@ -0,0 +1,343 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoStreamReader.h"
+#include "Poco/Thread.h"
+#include "ofImage.h"
+#include "ofLog.h"
+#include "ofx/HTTP/Client.h"
+#include "ofx/HTTP/GetRequest.h"
+#include "ofx/HTTP/IPVideoMultipartParser.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+IPVideoStreamReader::IPVideoStreamReader(std::size_t numDecoderThreads)
+{
+    if (numDecoderThreads == 0)
+    {
+        numDecoderThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Keep one part ready for each decoder, and drop anything older.
+    _maxPendingParts = numDecoderThreads;
+
+    for (std::size_t i = 0; i < numDecoderThreads; ++i)
+    {
+        _decoders.push_back(std::thread(&IPVideoStreamReader::decode, this));
+    }
+}
+
+
+IPVideoStreamReader::~IPVideoStreamReader()
+{
+    stop();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isDecoding = false;
+    }
+
+    _condition.notify_all();
+
+    for (auto& decoder: _decoders)
+    {
+        decoder.join();
+    }
+}
+
+
+void IPVideoStreamReader::start(const std::string& uri)
+{
+    stop();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRunning = true;
+    }
+
+    _receiver = std::thread(&IPVideoStreamReader::receive, this, uri);
+}
+
+
+void IPVideoStreamReader::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRunning = false;
+        ++_stopCount;
+
+        if (_socket != nullptr)
+        {
+            try
+            {
+                // Wake the receiver if it is blocked reading the stream.
+                _socket->shutdown();
+            }
+            catch (const Poco::Exception& exc)
+            {
+                ofLogVerbose("IPVideoStreamReader::stop") << exc.displayText();
+            }
+        }
+    }
+
+    if (_receiver.joinable())
+    {
+        _receiver.join();
+    }
+}
+
+
+bool IPVideoStreamReader::isRunning() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _isRunning;
+}
+
+
+std::size_t IPVideoStreamReader::read(BaseResponse& response)
+{
+    std::string boundary = IPVideoMultipartParser::boundary(response.getContentType());
+
+    if (boundary.empty())
+    {
+        throw Poco::DataFormatException("Not a multipart response: " + response.getContentType());
+    }
+
+    return read(response.stream(), boundary);
+}
+
+
+std::size_t IPVideoStreamReader::read(std::istream& stream, const std::string& boundary)
+{
+    uint64_t stopCount = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        stopCount = _stopCount;
+    }
+
+    IPVideoMultipartParser parser(boundary);
+
+    std::size_t numParts = 0;
+
+    std::shared_ptr<ofBuffer> buffer = acquireBuffer();
+
+    while (parser.next(stream, *buffer))
+    {
+        ++numParts;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            if (_stopCount != stopCount)
+            {
+                break;
+            }
+
+            Part part;
+            part.sequence = ++_framesReceived;
+            part.buffer = buffer;
+
+            _parts.push_back(part);
+
+            while (_parts.size() > _maxPendingParts)
+            {
+                _parts.pop_front();
+                ++_framesDropped;
+            }
+        }
+
+        _condition.notify_one();
+
+        buffer = acquireBuffer();
+    }
+
+    return numParts;
+}
+
+
+std::shared_ptr<const ofPixels> IPVideoStreamReader::latestFrame() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _latestFrame;
+}
+
+
+uint64_t IPVideoStreamReader::latestSequence() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _latestSequence;
+}
+
+
+uint64_t IPVideoStreamReader::framesReceived() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesReceived;
+}
+
+
+uint64_t IPVideoStreamReader::framesDecoded() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesDecoded;
+}
+
+
+uint64_t IPVideoStreamReader::framesDropped() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesDropped;
+}
+
+
+void IPVideoStreamReader::receive(const std::string& uri)
+{
+    while (isRunning())
+    {
+        try
+        {
+            Client client;
+            Context context;
+            GetRequest request(uri);
+
+            auto response = client.execute(context, request);
+
+            if (response->getStatus() == Poco::Net::HTTPResponse::HTTP_OK)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+
+                    if (!_isRunning)
+                    {
+                        break;
+                    }
+
+                    // Shares the session's socket so that stop() can shut it down.
+                    _socket = std::make_unique<Poco::Net::StreamSocket>(context.clientSession()->socket());
+                }
+
+                read(*response);
+            }
+            else
+            {
+                ofLogError("IPVideoStreamReader::receive") << "Unexpected response: " << response->getStatus() << " " << response->getReason();
+            }
+        }
+        catch (const Poco::Exception& exc)
+        {
+            ofLogError("IPVideoStreamReader::receive") << exc.displayText();
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("IPVideoStreamReader::receive") << exc.what();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _socket.reset();
+        }
+
+        // Wait before reconnecting, waking regularly to check for stop().
+        for (int elapsed = 0; elapsed < RECONNECT_DELAY && isRunning(); elapsed += 50)
+        {
+            Poco::Thread::sleep(50);
+        }
+    }
+}
+
+
+void IPVideoStreamReader::decode()
+{
+    while (true)
+    {
+        Part part;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [this]() {
+                return !_parts.empty() || !_isDecoding;
+            });
+
+            if (!_isDecoding)
+            {
+                return;
+            }
+
+            part = _parts.front();
+            _parts.pop_front();
+        }
+
+        std::shared_ptr<ofPixels> pixels = acquirePixels();
+
+        if (!ofLoadImage(*pixels, *part.buffer))
+        {
+            ofLogWarning("IPVideoStreamReader::decode") << "Unable to decode frame " << part.sequence << ".";
+            std::unique_lock<std::mutex> lock(_mutex);
+            ++_framesDropped;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // Another decoder may already have published a newer frame.
+        if (part.sequence > _latestSequence)
+        {
+            _latestFrame = pixels;
+            _latestSequence = part.sequence;
+            ++_framesDecoded;
+        }
+        else
+        {
+            ++_framesDropped;
+        }
+    }
+}
+
+
+std::shared_ptr<ofBuffer> IPVideoStreamReader::acquireBuffer()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // A buffer referenced only by the pool is not in use.
+    for (auto& buffer: _bufferPool)
+    {
+        if (buffer.use_count() == 1)
+        {
+            return buffer;
+        }
+    }
+
+    _bufferPool.push_back(std::make_shared<ofBuffer>());
+    return _bufferPool.back();
+}
+
+
+std::shared_ptr<ofPixels> IPVideoStreamReader::acquirePixels()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Pixels referenced only by the pool are neither the latest frame, nor
+    // held by a caller, nor being decoded into.
+    for (auto& pixels: _pixelPool)
+    {
+        if (pixels.use_count() == 1)
+        {
+            return pixels;
+        }
+    }
+
+    _pixelPool.push_back(std::make_shared<ofPixels>());
+    return _pixelPool.back();
+}
+
+
+} } // namespace ofx::HTTP
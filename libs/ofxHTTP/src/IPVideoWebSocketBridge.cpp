@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoWebSocketBridge.h"
+#include <algorithm>
+#include "Poco/Timestamp.h"
+#include "ofUtils.h"
+
+
+namespace ofx {
+namespace HTTP {
+
+
+const std::string IPVideoWebSocketBridge::HEADER_MAGIC = "IPVF";
+const std::string IPVideoWebSocketBridge::ACK_COMMAND = "ack";
+
+
+IPVideoWebSocketBridge::IPVideoWebSocketBridge(IPVideoRoute& videoRoute,
+                                               WebSocketRoute& webSocketRoute,
+                                               const std::string& streamName,
+                                               std::size_t maxFramesInFlight):
+    _webSocketRoute(webSocketRoute),
+    _stream(videoRoute.findOrCreateStream(streamName)),
+    _maxFramesInFlight(std::max(maxFramesInFlight, std::size_t(1)))
+{
+    _webSocketRoute.registerWebSocketEvents(this);
+    _stream->addListener(this);
+}
+
+
+IPVideoWebSocketBridge::~IPVideoWebSocketBridge()
+{
+    _stream->removeListener(this);
+    _webSocketRoute.unregisterWebSocketEvents(this);
+}
+
+
+void IPVideoWebSocketBridge::frameEncoded(const IPVideoStream&,
+                                          std::shared_ptr<IPVideoFrame> frame,
+                                          uint64_t sequence)
+{
+    // The viewers with credit are charged for the frame under the lock, and
+    // the frame is queued for them after it is released.
+    std::vector<const WebSocketConnection*> recipients;
+
+    uint64_t now = ofGetElapsedTimeMillis();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (auto& entry: _clients)
+        {
+            expireFramesInFlight(entry.second, now);
+
+            if (entry.second.framesInFlight.size() >= _maxFramesInFlight)
+            {
+                ++_framesDropped;
+                continue;
+            }
+
+            entry.second.framesInFlight.push_back(std::make_pair(sequence, frame->timestamp()));
+            recipients.push_back(entry.first);
+        }
+    }
+
+    if (recipients.empty())
+    {
+        return;
+    }
+
+    // Convert the encode time to wall clock time for the client.
+    uint64_t age = now - frame->timestamp();
+    uint64_t timestamp = Poco::Timestamp().epochMicroseconds() / 1000 - age;
+
+    std::string header = makeHeader(sequence,
+                                    timestamp,
+                                    frame->settings().getWidth(),
+                                    frame->settings().getHeight());
+
+    const ofBuffer& buffer = frame->buffer();
+
+    // The JPEG is copied once into a payload that all viewers share.
+    std::shared_ptr<WebSocketFrame> payload = std::make_shared<WebSocketFrame>(Poco::Net::WebSocket::FRAME_BINARY);
+    payload->writeBytes(reinterpret_cast<const uint8_t*>(header.data()), header.size());
+    payload->writeBytes(reinterpret_cast<const uint8_t*>(buffer.getData()), buffer.size());
+
+    std::size_t numSent = 0;
+
+    for (const auto* connection: recipients)
+    {
+        if (_webSocketRoute.sendFrame(connection, payload))
+        {
+            ++numSent;
+        }
+        else
+        {
+            // The connection is gone.
+            removeClient(connection);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _framesSent += numSent;
+}
+
+
+bool IPVideoWebSocketBridge::isListening() const
+{
+    uint64_t now = ofGetElapsedTimeMillis();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint64_t timeout = frameTimeout();
+
+    for (const auto& entry: _clients)
+    {
+        const auto& framesInFlight = entry.second.framesInFlight;
+
+        // An expired frame returns its credit when the next frame is sent.
+        if (framesInFlight.size() < _maxFramesInFlight
+        ||  framesInFlight.front().second + timeout <= now)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void IPVideoWebSocketBridge::onWebSocketOpenEvent(WebSocketOpenEventArgs& evt)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _clients[&evt.connection()] = Client();
+}
+
+
+void IPVideoWebSocketBridge::onWebSocketCloseEvent(WebSocketCloseEventArgs& evt)
+{
+    removeClient(&evt.connection());
+}
+
+
+void IPVideoWebSocketBridge::onWebSocketFrameReceivedEvent(WebSocketFrameEventArgs& evt)
+{
+    if (!evt.frame().isText())
+    {
+        return;
+    }
+
+    std::vector<std::string> tokens = ofSplitString(evt.frame().getText(), " ", true, true);
+
+    if (tokens.size() != 2 || tokens[0] != ACK_COMMAND)
+    {
+        ofLogWarning("IPVideoWebSocketBridge::onWebSocketFrameReceivedEvent") << "Unknown message: " << evt.frame().getText();
+        return;
+    }
+
+    uint64_t sequence = 0;
+    std::istringstream token(tokens[1]);
+    token >> sequence;
+
+    if (token.fail())
+    {
+        ofLogWarning("IPVideoWebSocketBridge::onWebSocketFrameReceivedEvent") << "Invalid sequence: " << tokens[1];
+        return;
+    }
+
+    uint64_t now = ofGetElapsedTimeMillis();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Clients::iterator iter = _clients.find(&evt.connection());
+
+    if (iter == _clients.end())
+    {
+        return;
+    }
+
+    auto& framesInFlight = iter->second.framesInFlight;
+
+    while (!framesInFlight.empty() && framesInFlight.front().first <= sequence)
+    {
+        if (framesInFlight.front().first == sequence)
+        {
+            uint64_t latency = now - framesInFlight.front().second;
+            _latency = _latency == 0 ? latency : (_latency * 7 + latency) / 8;
+        }
+
+        framesInFlight.pop_front();
+    }
+}
+
+
+void IPVideoWebSocketBridge::onWebSocketFrameSentEvent(WebSocketFrameEventArgs&)
+{
+}
+
+
+void IPVideoWebSocketBridge::onWebSocketErrorEvent(WebSocketErrorEventArgs& evt)
+{
+    removeClient(&evt.connection());
+}
+
+
+std::size_t IPVideoWebSocketBridge::numClients() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _clients.size();
+}
+
+
+uint64_t IPVideoWebSocketBridge::framesSent() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesSent;
+}
+
+
+uint64_t IPVideoWebSocketBridge::framesDropped() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesDropped;
+}
+
+
+uint64_t IPVideoWebSocketBridge::framesExpired() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _framesExpired;
+}
+
+
+uint64_t IPVideoWebSocketBridge::latency() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _latency;
+}
+
+
+std::string IPVideoWebSocketBridge::makeHeader(uint64_t sequence,
+                                               uint64_t timestamp,
+                                               uint32_t width,
+                                               uint32_t height)
+{
+    std::string header(HEADER_SIZE, '\0');
+
+    auto write = [&header](std::size_t offset, uint64_t value, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            header[offset + i] = static_cast<char>((value >> (8 * (size - 1 - i))) & 0xFF);
+        }
+    };
+
+    header.replace(0, HEADER_MAGIC.size(), HEADER_MAGIC);
+    write(4, HEADER_VERSION, 1);
+    write(5, HEADER_SIZE, 1);
+    write(8, sequence, 8);
+    write(16, timestamp, 8);
+    write(24, width, 4);
+    write(28, height, 4);
+
+    return header;
+}
+
+
+uint64_t IPVideoWebSocketBridge::frameTimeout() const
+{
+    return std::max<uint64_t>(_latency * FRAME_TIMEOUT_LATENCY_FACTOR,
+                              MINIMUM_FRAME_TIMEOUT);
+}
+
+
+void IPVideoWebSocketBridge::expireFramesInFlight(Client& client, uint64_t now)
+{
+    uint64_t timeout = frameTimeout();
+
+    auto& framesInFlight = client.framesInFlight;
+
+    // Frames are sent in order, so the oldest frames expire first.
+    while (!framesInFlight.empty() && framesInFlight.front().second + timeout <= now)
+    {
+        framesInFlight.pop_front();
+        ++_framesExpired;
+    }
+}
+
+
+void IPVideoWebSocketBridge::removeClient(const WebSocketConnection* connection)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _clients.erase(connection);
+}
+
+
+} } // namespace ofx::HTTP
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2012 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/HTTP/IPVideoWorkerPool.h"
+#include <algorithm>
+
+
+#undef min // for windows
+#undef max // for windows
+
+
+namespace ofx {
+namespace HTTP {
+
+
+IPVideoWorkerPool::IPVideoWorkerPool(std::size_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    for (std::size_t i = 0; i < numThreads; ++i)
+    {
+        _threads.push_back(std::thread(&IPVideoWorkerPool::_work, this));
+    }
+}
+
+
+IPVideoWorkerPool::~IPVideoWorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isRunning = false;
+    }
+
+    _batchCondition.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        thread.join();
+    }
+}
+
+
+void IPVideoWorkerPool::run(std::size_t numJobs,
+                            const std::function<void(std::size_t)>& job)
+{
+    if (numJobs == 0)
+    {
+        return;
+    }
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->job = &job;
+    batch->numJobs = numJobs;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (numJobs > 1 && !_threads.empty())
+    {
+        _batches.push_back(batch);
+        _batchCondition.notify_all();
+    }
+
+    // The calling thread helps with its own batch rather than waiting idle.
+    while (_runNext(*batch, lock))
+    {
+    }
+
+    _finishedCondition.wait(lock, [&]() {
+        return batch->numFinished == batch->numJobs;
+    });
+
+    if (batch->exception)
+    {
+        std::rethrow_exception(batch->exception);
+    }
+}
+
+
+std::size_t IPVideoWorkerPool::numThreads() const
+{
+    return _threads.size();
+}
+
+
+IPVideoWorkerPool& IPVideoWorkerPool::defaultPool()
+{
+    static IPVideoWorkerPool pool;
+    return pool;
+}
+
+
+bool IPVideoWorkerPool::_runNext(Batch& batch, std::unique_lock<std::mutex>& lock)
+{
+    if (batch.nextJob == batch.numJobs)
+    {
+        return false;
+    }
+
+    std::size_t index = batch.nextJob++;
+
+    if (batch.nextJob == batch.numJobs)
+    {
+        // Every job has started, so the workers can move on.
+        _batches.erase(std::remove_if(_batches.begin(),
+                                      _batches.end(),
+                                      [&](const std::shared_ptr<Batch>& b)
+                                      {
+                                          return b.get() == &batch;
+                                      }),
+                       _batches.end());
+    }
+
+    lock.unlock();
+
+    std::exception_ptr exception;
+
+    try
+    {
+        (*batch.job)(index);
+    }
+    catch (...)
+    {
+        exception = std::current_exception();
+    }
+
+    lock.lock();
+
+    if (exception && !batch.exception)
+    {
+        batch.exception = exception;
+    }
+
+    if (++batch.numFinished == batch.numJobs)
+    {
+        _finishedCondition.notify_all();
+    }
+
+    return true;
+}
+
+
+void IPVideoWorkerPool::_work()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _batchCondition.wait(lock, [this]() {
+            return !_batches.empty() || !_isRunning;
+        });
+
+        if (!_isRunning)
+        {
+            return;
+        }
+
+        // Hold a reference, as the batch leaves the queue once started.
+        std::shared_ptr<Batch> batch = _batches.front();
+
+        _runNext(*batch, lock);
+    }
+}
+
+
+} } // namespace ofx::HTTP
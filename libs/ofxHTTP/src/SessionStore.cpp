@@ -6,6 +6,8 @@
 
 
 #include "ofx/HTTP/SessionStore.h"
+#include <algorithm>
+#include <functional>
 #include "ofx/HTTP/Session.h"
 
 
@@ -34,6 +36,13 @@ BaseSessionStore::~BaseSessionStore()
 
 AbstractSession& BaseSessionStore::getSession(Poco::Net::HTTPServerRequest& request,
                                               Poco::Net::HTTPServerResponse& response)
+{
+    return *getSharedSession(request, response);
+}
+
+
+std::shared_ptr<AbstractSession> BaseSessionStore::getSharedSession(Poco::Net::HTTPServerRequest& request,
+                                                                    Poco::Net::HTTPServerResponse& response)
 {
     // Get the cookies from the client.
     Poco::Net::NameValueCollection cookies;
@@ -65,23 +74,20 @@ AbstractSession& BaseSessionStore::getSession(Poco::Net::HTTPServerRequest& requ
         ++cookieIter;
     }
 
-    if (hasSession(sessionId))
-    {
-        return getSession(sessionId);
-    }
-    else
-    {
-        // Create a new sesssion and return a reference.
-        AbstractSession& session = createSession();
+    bool isNew = false;
+
+    std::shared_ptr<AbstractSession> session = findOrCreateSession(sessionId, isNew);
 
+    if (isNew)
+    {
         // Create a cookie with the session id.
-        Poco::Net::HTTPCookie cookie(_sessionKeyName, session.getId());
+        Poco::Net::HTTPCookie cookie(_sessionKeyName, session->getId());
 
         // Send our cookie with the response.
         response.addCookie(cookie);
-
-        return session;
     }
+
+    return session;
 }
 
 
@@ -116,13 +122,64 @@ void BaseSessionStore::destroySession(Poco::Net::HTTPServerRequest& request,
 }
 
 
-SimpleSessionStore::SimpleSessionStore()
+AbstractSession& BaseSessionStore::getSession(const std::string& sessionId)
+{
+    std::shared_ptr<AbstractSession> session = findSession(sessionId);
+
+    if (session == nullptr)
+    {
+        throw Poco::InvalidAccessException("Session " + sessionId + " not found.");
+    }
+
+    return *session;
+}
+
+
+AbstractSession& BaseSessionStore::createSession()
+{
+    return *createSharedSession();
+}
+
+
+std::shared_ptr<AbstractSession> BaseSessionStore::findOrCreateSession(const std::string& sessionId,
+                                                                       bool& isNew)
+{
+    std::shared_ptr<AbstractSession> session;
+
+    if (!sessionId.empty())
+    {
+        session = findSession(sessionId);
+    }
+
+    isNew = (session == nullptr);
+
+    if (isNew)
+    {
+        session = createSharedSession();
+    }
+
+    return session;
+}
+
+
+const Poco::Timespan SimpleSessionStore::DEFAULT_MAXIMUM_IDLE_TIME = Poco::Timespan(0, 0, 30, 0, 0);
+const Poco::Timespan SimpleSessionStore::DEFAULT_MAXIMUM_LIFETIME = Poco::Timespan(1, 0, 0, 0, 0);
+const std::size_t SimpleSessionStore::DEFAULT_MAXIMUM_SESSIONS = 100000;
+
+
+SimpleSessionStore::SimpleSessionStore():
+    _maximumIdleTime(DEFAULT_MAXIMUM_IDLE_TIME),
+    _maximumLifetime(DEFAULT_MAXIMUM_LIFETIME),
+    _maximumSessions(DEFAULT_MAXIMUM_SESSIONS)
 {
 }
 
 
 SimpleSessionStore::SimpleSessionStore(const std::string& sessionKeyName):
-    BaseSessionStore(sessionKeyName)
+    BaseSessionStore(sessionKeyName),
+    _maximumIdleTime(DEFAULT_MAXIMUM_IDLE_TIME),
+    _maximumLifetime(DEFAULT_MAXIMUM_LIFETIME),
+    _maximumSessions(DEFAULT_MAXIMUM_SESSIONS)
 {
 }
 
@@ -132,48 +189,536 @@ SimpleSessionStore::~SimpleSessionStore()
 }
 
 
-bool SimpleSessionStore::hasSession(const std::string& sessionId) const
+void SimpleSessionStore::setMaximumIdleTime(const Poco::Timespan& maximumIdleTime)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maximumIdleTime = maximumIdleTime;
+}
+
+
+Poco::Timespan SimpleSessionStore::getMaximumIdleTime() const
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    return _sessionMap.find(sessionId) != _sessionMap.end();
+    return _maximumIdleTime;
 }
 
 
-AbstractSession& SimpleSessionStore::getSession(const std::string& sessionId)
+void SimpleSessionStore::setMaximumLifetime(const Poco::Timespan& maximumLifetime)
 {
     std::unique_lock<std::mutex> lock(_mutex);
+    _maximumLifetime = maximumLifetime;
+}
 
-    SessionMap::iterator sessionsIter = _sessionMap.find(sessionId);
 
-    if (sessionsIter != _sessionMap.end())
+Poco::Timespan SimpleSessionStore::getMaximumLifetime() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _maximumLifetime;
+}
+
+
+void SimpleSessionStore::setMaximumSessions(std::size_t maximumSessions)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maximumSessions = maximumSessions;
+}
+
+
+std::size_t SimpleSessionStore::getMaximumSessions() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _maximumSessions;
+}
+
+
+void SimpleSessionStore::expireSessions()
+{
+    SessionList expired;
+    SessionList evicted;
+
     {
-        // This must be valid b/c it's designed that way and we
-        // need to return a reference.
-        poco_assert(sessionsIter->second);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _expire(currentTime(), expired);
+    }
+
+    _notify(expired, evicted);
+}
+
+
+std::size_t SimpleSessionStore::getNumSessions() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _sessionMap.size();
+}
+
+
+uint64_t SimpleSessionStore::getNumExpiredSessions() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _numExpiredSessions;
+}
+
+
+uint64_t SimpleSessionStore::getNumEvictedSessions() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _numEvictedSessions;
+}
+
 
-        return (*sessionsIter->second);
+bool SimpleSessionStore::hasSession(const std::string& sessionId) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    SessionMap::const_iterator iter = _sessionMap.find(sessionId);
+
+    if (iter == _sessionMap.end())
+    {
+        return false;
     }
-    else
+
+    // An expired session counts as missing until it is removed.
+    return iter->second.expiry == _expiryIndex.end()
+        || iter->second.expiry->first > currentTime();
+}
+
+
+std::shared_ptr<AbstractSession> SimpleSessionStore::findSession(const std::string& sessionId)
+{
+    std::shared_ptr<AbstractSession> session;
+
+    SessionList expired;
+    SessionList evicted;
+
     {
+        std::unique_lock<std::mutex> lock(_mutex);
 
-        throw Poco::InvalidAccessException("Session " + sessionId + " not found.");
+        Poco::Timestamp now = currentTime();
+
+        _expire(now, expired);
+
+        SessionMap::iterator iter = _sessionMap.find(sessionId);
+
+        if (iter != _sessionMap.end())
+        {
+            _touch(iter->second, now);
+            session = iter->second.session;
+        }
     }
+
+    _notify(expired, evicted);
+
+    return session;
 }
 
 
-AbstractSession& SimpleSessionStore::createSession()
+std::shared_ptr<AbstractSession> SimpleSessionStore::createSharedSession()
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-    std::shared_ptr<SimpleSession> session = std::make_shared<SimpleSession>();
-    _sessionMap[session->getId()] = session;
-    return *session;
+    return insertSession(BaseSession::generateId());
+}
+
+
+std::shared_ptr<AbstractSession> SimpleSessionStore::findOrCreateSession(const std::string& sessionId,
+                                                                         bool& isNew)
+{
+    std::shared_ptr<AbstractSession> session;
+
+    SessionList expired;
+    SessionList evicted;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        Poco::Timestamp now = currentTime();
+
+        _expire(now, expired);
+
+        SessionMap::iterator iter = _sessionMap.find(sessionId);
+
+        isNew = (iter == _sessionMap.end());
+
+        if (isNew)
+        {
+            // Never adopt a session id chosen by the client.
+            session = _insert(BaseSession::generateId(), now, evicted);
+        }
+        else
+        {
+            _touch(iter->second, now);
+            session = iter->second.session;
+        }
+    }
+
+    _notify(expired, evicted);
+
+    return session;
+}
+
+
+std::shared_ptr<AbstractSession> SimpleSessionStore::insertSession(const std::string& sessionId)
+{
+    std::shared_ptr<AbstractSession> session;
+
+    SessionList expired;
+    SessionList evicted;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        Poco::Timestamp now = currentTime();
+
+        _expire(now, expired);
+
+        session = _insert(sessionId, now, evicted);
+    }
+
+    _notify(expired, evicted);
+
+    return session;
 }
 
 
 void SimpleSessionStore::destroySession(const std::string& sessionId)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _sessionMap.erase(_sessionMap.find(sessionId));
+
+    SessionMap::iterator iter = _sessionMap.find(sessionId);
+
+    if (iter != _sessionMap.end())
+    {
+        _erase(iter);
+    }
+}
+
+
+Poco::Timestamp SimpleSessionStore::currentTime() const
+{
+    return Poco::Timestamp();
+}
+
+
+void SimpleSessionStore::_expire(const Poco::Timestamp& now, SessionList& expired)
+{
+    // The index is ordered by expiry time, so only expired entries are visited.
+    while (!_expiryIndex.empty() && _expiryIndex.begin()->first <= now)
+    {
+        SessionMap::iterator iter = _sessionMap.find(_expiryIndex.begin()->second);
+        expired.push_back(iter->second.session);
+        _erase(iter);
+        ++_numExpiredSessions;
+    }
+}
+
+
+void SimpleSessionStore::_touch(SessionRecord& record, const Poco::Timestamp& now)
+{
+    _recencyList.splice(_recencyList.begin(), _recencyList, record.recency);
+
+    if (record.expiry != _expiryIndex.end())
+    {
+        _expiryIndex.erase(record.expiry);
+        record.expiry = _expiryIndex.end();
+    }
+
+    bool expires = false;
+    Poco::Timestamp expiresAt;
+
+    if (_maximumIdleTime.totalMicroseconds() > 0)
+    {
+        expires = true;
+        expiresAt = now + _maximumIdleTime;
+    }
+
+    if (_maximumLifetime.totalMicroseconds() > 0)
+    {
+        Poco::Timestamp endOfLife = record.created + _maximumLifetime;
+
+        if (!expires || endOfLife < expiresAt)
+        {
+            expires = true;
+            expiresAt = endOfLife;
+        }
+    }
+
+    if (expires)
+    {
+        record.expiry = _expiryIndex.insert(std::make_pair(expiresAt, *record.recency));
+    }
+}
+
+
+std::shared_ptr<AbstractSession> SimpleSessionStore::_insert(const std::string& sessionId,
+                                                             const Poco::Timestamp& now,
+                                                             SessionList& evicted)
+{
+    // Evict the least recently used sessions to make room.
+    while (_maximumSessions > 0
+        && _sessionMap.size() >= _maximumSessions
+        && !_recencyList.empty())
+    {
+        SessionMap::iterator iter = _sessionMap.find(_recencyList.back());
+        evicted.push_back(iter->second.session);
+        _erase(iter);
+        ++_numEvictedSessions;
+    }
+
+    std::shared_ptr<AbstractSession> session = std::make_shared<SimpleSession>(sessionId);
+
+    std::pair<SessionMap::iterator, bool> result = _sessionMap.insert(std::make_pair(sessionId, SessionRecord()));
+
+    if (!result.second)
+    {
+        throw Poco::ExistsException("Session " + sessionId + " already exists.");
+    }
+
+    SessionRecord& record = result.first->second;
+    record.session = session;
+    record.created = now;
+    record.expiry = _expiryIndex.end();
+    record.recency = _recencyList.insert(_recencyList.begin(), result.first->first);
+
+    _touch(record, now);
+
+    return session;
+}
+
+
+void SimpleSessionStore::_erase(SessionMap::iterator iter)
+{
+    if (iter->second.expiry != _expiryIndex.end())
+    {
+        _expiryIndex.erase(iter->second.expiry);
+    }
+
+    _recencyList.erase(iter->second.recency);
+    _sessionMap.erase(iter);
+}
+
+
+void SimpleSessionStore::_notify(SessionList& expired, SessionList& evicted)
+{
+    for (auto& session: expired)
+    {
+        SessionEventArgs args(*session);
+        ofNotifyEvent(events.onSessionExpired, args, this);
+    }
+
+    for (auto& session: evicted)
+    {
+        SessionEventArgs args(*session);
+        ofNotifyEvent(events.onSessionEvicted, args, this);
+    }
+}
+
+
+/// \brief A SimpleSessionStore that reports its removed sessions to a
+///        ShardedSessionStore.
+class ShardedSessionStore::Shard: public SimpleSessionStore
+{
+public:
+    Shard(const std::string& sessionKeyName, ShardedSessionStore& store):
+        SimpleSessionStore(sessionKeyName),
+        _store(store)
+    {
+        ofAddListener(events.onSessionExpired, this, &Shard::onSessionExpired);
+        ofAddListener(events.onSessionEvicted, this, &Shard::onSessionEvicted);
+    }
+
+    virtual ~Shard()
+    {
+        ofRemoveListener(events.onSessionExpired, this, &Shard::onSessionExpired);
+        ofRemoveListener(events.onSessionEvicted, this, &Shard::onSessionEvicted);
+    }
+
+    void onSessionExpired(SessionEventArgs& args)
+    {
+        ofNotifyEvent(_store.events.onSessionExpired, args, &_store);
+    }
+
+    void onSessionEvicted(SessionEventArgs& args)
+    {
+        ofNotifyEvent(_store.events.onSessionEvicted, args, &_store);
+    }
+
+    using SimpleSessionStore::hasSession;
+    using SimpleSessionStore::findSession;
+    using SimpleSessionStore::insertSession;
+    using SimpleSessionStore::destroySession;
+
+private:
+    ShardedSessionStore& _store;
+
+};
+
+
+const std::size_t ShardedSessionStore::DEFAULT_NUM_SHARDS = 16;
+
+
+ShardedSessionStore::ShardedSessionStore(std::size_t numShards):
+    _maximumSessions(SimpleSessionStore::DEFAULT_MAXIMUM_SESSIONS)
+{
+    _createShards(numShards);
+}
+
+
+ShardedSessionStore::ShardedSessionStore(const std::string& sessionKeyName,
+                                         std::size_t numShards):
+    BaseSessionStore(sessionKeyName),
+    _maximumSessions(SimpleSessionStore::DEFAULT_MAXIMUM_SESSIONS)
+{
+    _createShards(numShards);
+}
+
+
+ShardedSessionStore::~ShardedSessionStore()
+{
+}
+
+
+void ShardedSessionStore::setMaximumIdleTime(const Poco::Timespan& maximumIdleTime)
+{
+    for (auto& shard: _shards)
+    {
+        shard->setMaximumIdleTime(maximumIdleTime);
+    }
+}
+
+
+Poco::Timespan ShardedSessionStore::getMaximumIdleTime() const
+{
+    return _shards.front()->getMaximumIdleTime();
+}
+
+
+void ShardedSessionStore::setMaximumLifetime(const Poco::Timespan& maximumLifetime)
+{
+    for (auto& shard: _shards)
+    {
+        shard->setMaximumLifetime(maximumLifetime);
+    }
+}
+
+
+Poco::Timespan ShardedSessionStore::getMaximumLifetime() const
+{
+    return _shards.front()->getMaximumLifetime();
+}
+
+
+void ShardedSessionStore::setMaximumSessions(std::size_t maximumSessions)
+{
+    _maximumSessions = maximumSessions;
+
+    std::size_t maximumSessionsPerShard = (maximumSessions + _shards.size() - 1) / _shards.size();
+
+    for (auto& shard: _shards)
+    {
+        shard->setMaximumSessions(maximumSessionsPerShard);
+    }
+}
+
+
+std::size_t ShardedSessionStore::getMaximumSessions() const
+{
+    return _maximumSessions;
+}
+
+
+void ShardedSessionStore::expireSessions()
+{
+    for (auto& shard: _shards)
+    {
+        shard->expireSessions();
+    }
+}
+
+
+std::size_t ShardedSessionStore::getNumShards() const
+{
+    return _shards.size();
+}
+
+
+std::size_t ShardedSessionStore::getNumSessions() const
+{
+    std::size_t numSessions = 0;
+
+    for (const auto& shard: _shards)
+    {
+        numSessions += shard->getNumSessions();
+    }
+
+    return numSessions;
+}
+
+
+uint64_t ShardedSessionStore::getNumExpiredSessions() const
+{
+    uint64_t numSessions = 0;
+
+    for (const auto& shard: _shards)
+    {
+        numSessions += shard->getNumExpiredSessions();
+    }
+
+    return numSessions;
+}
+
+
+uint64_t ShardedSessionStore::getNumEvictedSessions() const
+{
+    uint64_t numSessions = 0;
+
+    for (const auto& shard: _shards)
+    {
+        numSessions += shard->getNumEvictedSessions();
+    }
+
+    return numSessions;
+}
+
+
+bool ShardedSessionStore::hasSession(const std::string& sessionId) const
+{
+    return _shard(sessionId).hasSession(sessionId);
+}
+
+
+std::shared_ptr<AbstractSession> ShardedSessionStore::findSession(const std::string& sessionId)
+{
+    return _shard(sessionId).findSession(sessionId);
+}
+
+
+std::shared_ptr<AbstractSession> ShardedSessionStore::createSharedSession()
+{
+    std::string sessionId = BaseSession::generateId();
+    return _shard(sessionId).insertSession(sessionId);
+}
+
+
+void ShardedSessionStore::destroySession(const std::string& sessionId)
+{
+    _shard(sessionId).destroySession(sessionId);
+}
+
+
+void ShardedSessionStore::_createShards(std::size_t numShards)
+{
+    numShards = std::max(numShards, std::size_t(1));
+
+    for (std::size_t i = 0; i < numShards; ++i)
+    {
+        _shards.push_back(std::unique_ptr<Shard>(new Shard(_sessionKeyName, *this)));
+    }
+
+    setMaximumSessions(_maximumSessions);
+}
+
+
+ShardedSessionStore::Shard& ShardedSessionStore::_shard(const std::string& sessionId) const
+{
+    return *_shards[std::hash<std::string>()(sessionId) % _shards.size()];
 }
 
 
@@ -47,6 +47,24 @@ void SimpleIPVideoServer::send(const ofPixels& pix)
 }
 
 
+void SimpleIPVideoServer::send(const std::string& streamName, const ofPixels& pix)
+{
+    _ipVideoRoute.send(streamName, pix);
+}
+
+
+void SimpleIPVideoServer::send(std::shared_ptr<const ofPixels> pix)
+{
+    _ipVideoRoute.send(pix);
+}
+
+
+void SimpleIPVideoServer::send(const std::string& streamName, std::shared_ptr<const ofPixels> pix)
+{
+    _ipVideoRoute.send(streamName, pix);
+}
+
+
 std::size_t SimpleIPVideoServer::numConnections() const
 {
     return _ipVideoRoute.numConnections();
@@ -46,6 +46,13 @@ void WebSocketConnection::handleRequest(ServerEventArgs& evt)
         // Respond to extensions.
         handleExtensions(evt);
 
+        // A new session's cookie must be set before the handshake response
+        // is sent, so the session is resolved now.
+        if (evt.hasSession())
+        {
+            evt.session();
+        }
+
         Poco::Net::WebSocket ws(evt.request(), evt.response());
 
         ws.setReceiveTimeout(route().settings().getReceiveTimeout());
@@ -95,7 +102,9 @@ void WebSocketConnection::handleRequest(ServerEventArgs& evt)
                                 frameFlag |= Poco::Net::WebSocket::FRAME_OP_PING;
                             }
 
-                            WebSocketFrame pingPongFrame(buffer.begin(), numBytesReceived, frameFlag);
+                            auto pingPongFrame = std::make_shared<WebSocketFrame>(buffer.begin(),
+                                                                                  numBytesReceived,
+                                                                                  frameFlag);
 
                             _mutex.lock();
                             _frameQueue.push(pingPongFrame);
@@ -185,21 +194,31 @@ void WebSocketConnection::handleRequest(ServerEventArgs& evt)
             while (sendQueueSize() > 0) // lock
             {
                 _mutex.lock();
-                WebSocketFrame frame = _frameQueue.front();
+                std::shared_ptr<const WebSocketFrame> queuedFrame = _frameQueue.front();
                 _frameQueue.pop();
                 _mutex.unlock();
 
-                if (frame.size() > 0)
+                if (queuedFrame->size() > 0)
                 {
                     if (ws.poll(route().settings().getPollTimeout(),
                                 Poco::Net::Socket::SELECT_WRITE))
                     {
-                        // Apply send filters to queued frame.
-                        for (auto& filter: _filters)
+                        // Queued frames may be shared with other connections,
+                        // so send filters modify a private copy.
+                        std::unique_ptr<WebSocketFrame> filteredFrame;
+
+                        if (!_filters.empty())
                         {
-                            filter->sendFilter(frame);
+                            filteredFrame = std::make_unique<WebSocketFrame>(*queuedFrame);
+
+                            for (auto& filter: _filters)
+                            {
+                                filter->sendFilter(*filteredFrame);
+                            }
                         }
 
+                        const WebSocketFrame& frame = filteredFrame != nullptr ? *filteredFrame : *queuedFrame;
+
                         const char* pData = frame.getCharPtr();
 
                         std::size_t numBytesSent = ws.sendFrame(pData,
@@ -321,6 +340,12 @@ void WebSocketConnection::handleRequest(ServerEventArgs& evt)
 
 
 bool WebSocketConnection::sendFrame(const WebSocketFrame& frame) const
+{
+    return sendFrame(std::make_shared<WebSocketFrame>(frame));
+}
+
+
+bool WebSocketConnection::sendFrame(std::shared_ptr<const WebSocketFrame> frame) const
 {
     std::unique_lock<std::mutex> lock(_mutex);
 
@@ -347,7 +372,7 @@ std::size_t WebSocketConnection::sendQueueSize() const
 void WebSocketConnection::clearSendQueue()
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    std::queue<WebSocketFrame> empty; // a way to clear queues.
+    std::queue<std::shared_ptr<const WebSocketFrame>> empty; // a way to clear queues.
     std::swap(_frameQueue, empty);
 }
 
@@ -198,15 +198,40 @@ void WebSocketRoute::stop()
 
 void WebSocketRoute::broadcast(const WebSocketFrame& frame)
 {
+    // All connections share a single copy of the frame.
+    std::shared_ptr<const WebSocketFrame> sharedFrame = std::make_shared<WebSocketFrame>(frame);
+
     std::unique_lock<std::mutex> lock(_mutex);
 
     for (auto& connection : _connections)
     {
-        connection->sendFrame(frame);
+        connection->sendFrame(sharedFrame);
     }
 }
 
 
+bool WebSocketRoute::sendFrame(const WebSocketConnection* connection,
+                               const WebSocketFrame& frame)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _connections.find(const_cast<WebSocketConnection*>(connection));
+
+    return iter != _connections.end() && (*iter)->sendFrame(frame);
+}
+
+
+bool WebSocketRoute::sendFrame(const WebSocketConnection* connection,
+                               std::shared_ptr<const WebSocketFrame> frame)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _connections.find(const_cast<WebSocketConnection*>(connection));
+
+    return iter != _connections.end() && (*iter)->sendFrame(frame);
+}
+
+
 void WebSocketRoute::registerConnection(WebSocketConnection* connection)
 {
     std::unique_lock<std::mutex> lock(_mutex);
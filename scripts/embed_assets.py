@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+#
+# SPDX-License-Identifier:	MIT
+#
+"""Pack a directory into C++ source for ofx::HTTP::EmbeddedAssetRoute.
+
+Usage:
+
+    python3 embed_assets.py <directory> <output> <function>
+
+For example
+
+    python3 ../../../addons/ofxHTTP/scripts/embed_assets.py \\
+        bin/data/DocumentRoot src/WebAssets webAssets
+
+writes src/WebAssets.h and src/WebAssets.cpp, which provide
+
+    const ofx::HTTP::EmbeddedAssetBundle& webAssets();
+
+Every regular file below the directory becomes an asset named by its path
+relative to the directory, e.g. "/css/style.css". Each asset holds its
+media type, a strong entity tag derived from its contents, its raw bytes
+and, if gzip makes it smaller, its gzipped bytes. The output is
+deterministic, so it only changes when the directory's contents change.
+
+To regenerate the bundle before each build of a project that uses the
+openFrameworks makefiles, add a rule like this to the project's Makefile:
+
+    src/WebAssets.cpp: $(shell find bin/data/DocumentRoot -type f)
+    	python3 $(OF_ROOT)/addons/ofxHTTP/scripts/embed_assets.py \\
+    	    bin/data/DocumentRoot src/WebAssets webAssets
+"""
+
+import gzip
+import hashlib
+import mimetypes
+import os
+import sys
+
+
+# Media types that are missing from some platforms' mime.types.
+MEDIA_TYPES = {
+    ".css": "text/css",
+    ".eot": "application/vnd.ms-fontobject",
+    ".html": "text/html",
+    ".ico": "image/x-icon",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".map": "application/json",
+    ".svg": "image/svg+xml",
+    ".ttf": "font/ttf",
+    ".wasm": "application/wasm",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+}
+
+# The number of bytes per line of generated source.
+BYTES_PER_LINE = 16
+
+
+def media_type(path):
+    extension = os.path.splitext(path)[1].lower()
+
+    if extension in MEDIA_TYPES:
+        return MEDIA_TYPES[extension]
+
+    guess = mimetypes.guess_type(path)[0]
+
+    return guess if guess is not None else "application/octet-stream"
+
+
+def string_literal(value):
+    escaped = value.replace("\\", "\\\\").replace("\"", "\\\"").replace("?", "\\?").replace("\n", "\\n")
+    return "\"" + escaped + "\""
+
+
+def byte_array(name, data):
+    lines = ["static constexpr unsigned char " + name + "[] = {"]
+
+    for offset in range(0, len(data), BYTES_PER_LINE):
+        chunk = data[offset:offset + BYTES_PER_LINE]
+        lines.append("    " + ", ".join("0x%02x" % byte for byte in chunk) + ",")
+
+    # An empty array is not allowed.
+    if not data:
+        lines.append("    0x00")
+
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def collect(directory):
+    assets = []
+
+    for root, directories, files in os.walk(directory):
+        directories.sort()
+
+        for name in files:
+            path = os.path.join(root, name)
+
+            if not os.path.isfile(path):
+                continue
+
+            relative = os.path.relpath(path, directory).replace(os.sep, "/")
+            assets.append(("/" + relative, path))
+
+    # EmbeddedAssetBundle::find() relies on strcmp() order.
+    assets.sort(key=lambda asset: asset[0].encode("utf-8"))
+    return assets
+
+
+def generate(directory, output, function):
+    header = ("//\n"
+              "// Generated by ofxHTTP/scripts/embed_assets.py. Do not edit.\n"
+              "//\n\n\n")
+
+    sources = [header,
+               "#include \"" + os.path.basename(output) + ".h\"\n\n\n",
+               "namespace {\n\n\n"]
+
+    entries = []
+
+    for index, (request_path, path) in enumerate(collect(directory)):
+        with open(path, "rb") as stream:
+            data = stream.read()
+
+        digest = hashlib.sha1(data).hexdigest()
+
+        # mtime=0 keeps the output reproducible.
+        compressed = gzip.compress(data, compresslevel=9, mtime=0)
+
+        name = "ASSET_%d" % index
+
+        sources.append("// " + request_path.replace("\n", " ") + "\n")
+        sources.append(byte_array(name, data) + "\n\n")
+
+        if len(compressed) < len(data):
+            sources.append(byte_array(name + "_GZIP", compressed) + "\n\n")
+            gzip_data = name + "_GZIP"
+            gzip_size = "sizeof(" + name + "_GZIP)"
+        else:
+            gzip_data = "nullptr"
+            gzip_size = "0"
+
+        entries.append("    {\n"
+                       "        " + string_literal(request_path) + ",\n"
+                       "        " + string_literal(media_type(path)) + ",\n"
+                       "        " + string_literal("\"" + digest + "\"") + ",\n"
+                       "        " + name + ",\n"
+                       "        " + str(len(data)) + ",\n"
+                       "        " + string_literal("\"" + digest + "-gzip\"") + ",\n"
+                       "        " + gzip_data + ",\n"
+                       "        " + gzip_size + "\n"
+                       "    }")
+
+    if entries:
+        sources.append("\nstatic constexpr ofx::HTTP::EmbeddedAsset ASSETS[] = {\n")
+        sources.append(",\n".join(entries))
+        sources.append("\n};\n\n\n")
+        sources.append("static constexpr ofx::HTTP::EmbeddedAssetBundle BUNDLE(ASSETS, sizeof(ASSETS) / sizeof(ASSETS[0]));\n\n\n")
+    else:
+        sources.append("static constexpr ofx::HTTP::EmbeddedAssetBundle BUNDLE(nullptr, 0);\n\n\n")
+
+    sources.append("} // namespace\n\n\n")
+    sources.append("const ofx::HTTP::EmbeddedAssetBundle& " + function + "()\n{\n    return BUNDLE;\n}\n")
+
+    declaration = (header +
+                   "#pragma once\n\n\n"
+                   "#include \"ofx/HTTP/EmbeddedAssetBundle.h\"\n\n\n"
+                   "/// \\returns the assets packed from " + os.path.basename(os.path.normpath(directory)) + ".\n"
+                   "const ofx::HTTP::EmbeddedAssetBundle& " + function + "();\n")
+
+    write_if_changed(output + ".h", declaration)
+    write_if_changed(output + ".cpp", "".join(sources))
+
+    return len(entries)
+
+
+def write_if_changed(path, contents):
+    # Unchanged files keep their timestamps, which avoids needless rebuilds.
+    if os.path.exists(path):
+        with open(path, "r", encoding="utf-8") as stream:
+            if stream.read() == contents:
+                return
+
+    with open(path, "w", encoding="utf-8", newline="\n") as stream:
+        stream.write(contents)
+
+
+def main(arguments):
+    if len(arguments) != 4:
+        sys.stderr.write(__doc__)
+        return 1
+
+    directory, output, function = arguments[1:]
+
+    if not os.path.isdir(directory):
+        sys.stderr.write("Not a directory: " + directory + "\n")
+        return 1
+
+    count = generate(directory, output, function)
+    print("Packed %d assets from %s into %s.cpp" % (count, directory, output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -21,11 +21,13 @@
 #include "ofx/HTTP/ClientSessionProvider.h"
 #include "ofx/HTTP/ClientState.h"
 #include "ofx/HTTP/Context.h"
+#include "ofx/HTTP/CookieSessionStore.h"
 #include "ofx/HTTP/DefaultProxyProcessor.h"
 #include "ofx/HTTP/DefaultRedirectProcessor.h"
 #include "ofx/HTTP/DefaultClientHeaders.h"
 #include "ofx/HTTP/DefaultCookieProcessor.h"
 #include "ofx/HTTP/DefaultEncodingResponseStreamFilter.h"
+#include "ofx/HTTP/EmbeddedAssetRoute.h"
 #include "ofx/HTTP/FormRequest.h"
 #include "ofx/HTTP/GetRequest.h"
 #include "ofx/HTTP/HeadRequest.h"
@@ -34,6 +36,13 @@
 #include "ofx/HTTP/GetRequestTask.h"
 //#include "ofx/HTTP/HTTPClientTask.h"
 #include "ofx/HTTP/HTTPUtils.h"
+#include "ofx/HTTP/IPVideoMultipartParser.h"
+#include "ofx/HTTP/IPVideoPixelPool.h"
+#include "ofx/HTTP/IPVideoRecorder.h"
+#include "ofx/HTTP/IPVideoReplayRoute.h"
+#include "ofx/HTTP/IPVideoStreamReader.h"
+#include "ofx/HTTP/IPVideoWebSocketBridge.h"
+#include "ofx/HTTP/IPVideoWorkerPool.h"
 #include "ofx/HTTP/JSONRequest.h"
 #include "ofx/HTTP/JSONWebToken.h"
 #include "ofx/HTTP/OAuth10Credentials.h"
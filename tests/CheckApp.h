@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2013 Christopher Baker <http://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <string>
+#include "ofMain.h"
+
+
+/// \brief A headless app that runs a set of checks and exits.
+///
+/// Shared by the example_*_tests apps. Each failed check is logged. The app
+/// exits with status 1 if any check failed and 0 otherwise.
+class CheckApp: public ofBaseApp
+{
+public:
+    /// \brief Destroy the CheckApp.
+    virtual ~CheckApp()
+    {
+    }
+
+    /// \brief Run the checks, log a summary and exit.
+    void setup() override
+    {
+        runChecks();
+
+        ofLogNotice("CheckApp::setup") << (numChecks - numFailures) << " of " << numChecks << " checks passed.";
+
+        ofExit(numFailures > 0 ? 1 : 0);
+    }
+
+    /// \brief Run every check.
+    virtual void runChecks() = 0;
+
+    /// \brief Record the result of a check.
+    /// \param passed True if the check passed.
+    /// \param description What was checked.
+    void check(bool passed, const std::string& description)
+    {
+        ++numChecks;
+
+        if (!passed)
+        {
+            ++numFailures;
+            ofLogError("CheckApp::check") << "Failed: " << description;
+        }
+    }
+
+    // We do not have an draw() method since this is a headless display.
+
+    /// \brief The number of failed checks.
+    std::size_t numFailures = 0;
+
+    /// \brief The number of checks.
+    std::size_t numChecks = 0;
+
+};